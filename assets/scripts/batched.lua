@@ -0,0 +1,36 @@
+-- Script functions called once per batch of points rather than once per
+-- point: each argument is an array, and so is each result.
+
+-- the rounded cube of scene1.lua, as a function of arrays
+function rounded_cube(xs, ys, zs)
+   local d = {}
+   for i = 1, #xs do
+      local x, y, z = xs[i] - 1.5, ys[i] - 1.0, zs[i]
+      d[i] = math.pow(x*x*x*x + y*y*y*y + z*z*z*z, 0.25) - 1.0
+   end
+   return d
+end
+
+function stripes(us, vs)
+   local r, g, b = {}, {}, {}
+   for i = 1, #us do
+      local s = 0.5 + 0.5 * math.sin(40 * us[i] + 10 * vs[i])
+      r[i], g[i], b[i] = 0.2 + 0.6 * s, 0.3, 0.8 - 0.6 * s
+   end
+   return r, g, b
+end
+
+function scene()
+   local shapes = {
+      shape(geom.implicit_batch("rounded_cube", 1.0, bounds.bbox({0.4, -0.1, -1.1}, {2.6, 2.1, 1.1})),
+            material.diffuse(texture.color({0.7, 0.7, 0.7}))),
+      shape(geom.sphere({-1.5, 1.0, 0.0}, 1.0), material.diffuse(texture.script_batch("stripes"))),
+      shape(geom.plane({0.0, 1.0, 0.0}, 0.0), material.diffuse(texture.grid({0.7}, {0.1}, 1.0, 0.05)))
+   }
+
+   local lights = { light.point({0.0, 4.0, 4.0}, {2.0}) }
+
+   local camera = camera.perspective({0.0, 2.0, 7.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, math.pi/3)
+
+   return {shapes = shapes; lights = lights; camera = camera}
+end
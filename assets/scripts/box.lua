@@ -11,7 +11,7 @@ function scene()
    }
 
    local lights = { --light.point({0, 2, 5}, {2.0}),
-		    light.environment(texture.hoseksky({0.0, 4.0, 1.0}, 2.0))
+		    light.environment(texture.bake(texture.hoseksky({0.0, 4.0, 1.0}, 2.0), 512, 256))
    }
 
    local pos = {6.0, 2.5, 1.25}
@@ -0,0 +1,31 @@
+-- A field of separate implicit shapes traced as one surface: each step only
+-- evaluates the shapes whose bounds lie near it.
+
+function scene()
+   local parts = {}
+   for i = 0, 7 do
+      for j = 0, 7 do
+         local at = {1.5 * i - 5.25, 0.4, 1.5 * j - 5.25}
+         local node
+         if (i + j) % 3 == 0 then
+            node = sdf.sphere(0.4)
+         elseif (i + j) % 3 == 1 then
+            node = sdf.rounded(sdf.box({0.3, 0.3, 0.3}), 0.1)
+         else
+            node = sdf.torus(0.3, 0.1)
+         end
+         parts[#parts + 1] = geom.sdf(sdf.translate(node, at))
+      end
+   end
+
+   local shapes = {
+      shape(geom.implicit_union(unpack(parts)), material.diffuse(texture.color({0.8, 0.5, 0.3}))),
+      shape(geom.plane({0.0, 1.0, 0.0}, 0.0), material.diffuse(texture.grid({0.7}, {0.1}, 1.0, 0.05)))
+   }
+
+   local lights = { light.point({0.0, 6.0, 6.0}, {3.0}) }
+
+   local camera = camera.perspective({0.0, 5.0, 10.0}, {0.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, math.pi/3)
+
+   return {shapes = shapes; lights = lights; camera = camera}
+end
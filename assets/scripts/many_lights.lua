@@ -0,0 +1,30 @@
+-- A street of small lamps over a row of spheres: hundreds of point lights,
+-- few of which matter at any one point. Uniform light selection wastes most
+-- of its samples here; compare the noise with and without the light tree.
+
+function scene()
+   local shapes = {
+      shape(geom.plane({0, 1, 0}, 0), material.diffuse(texture.grid({0.5}, {0.1}, 1.0, 0.05)))
+   }
+
+   for i = 0, 15 do
+      local x = -15 + 2 * i
+      shapes[#shapes + 1] = shape(geom.sphere({x, 0.6, 0}, 0.6), material.diffuse(texture.color({0.7, 0.5, 0.3})))
+   end
+
+   local lights = {}
+   for i = 0, 39 do
+      for j = 0, 9 do
+         local x = -20 + i
+         local z = -9 + 2 * j
+         -- mostly dim lamps, with a few bright ones
+         local power = 0.05 + 0.5 * math.pow(0.5 + 0.5 * math.sin(1.7 * i + 2.3 * j), 8)
+         lights[#lights + 1] = light.point({x, 1.5 + 0.5 * math.sin(i * j), z},
+            {power, 0.8 * power, 0.6 * power})
+      end
+   end
+
+   local camera = camera.perspective({0.0, 4.0, 12.0}, {0.0, 0.5, 0.0}, {0.0, 1.0, 0.0}, math.pi/3)
+
+   return {shapes = shapes; lights = lights; camera = camera}
+end
@@ -0,0 +1,25 @@
+-- The kind of surface scene1.lua builds from nested closures, as an sdf
+-- graph: it compiles to a flat program evaluated natively, with exact
+-- normals. The row is traced with over-relaxed steps.
+
+function scene()
+   local body = sdf.smooth_union(sdf.box({0.5, 0.4, 0.3}),
+                                 sdf.translate(sdf.sphere(0.3), {0.6, 0.0, 0.0}), 0.2)
+   local hole = sdf.rotate(sdf.cylinder(0.15, 1.0), {0.0, 0.0, 1.0}, -math.pi / 2)
+   local row = sdf.repetition(sdf.difference(body, hole), {2.5, 0.0, 0.0})
+
+   local shapes = {
+      shape(geom.tracing(geom.sdf(sdf.translate(row, {0.0, 0.5, 0.0}), bounds.bbox({-6.0, 0.0, -0.5}, {6.0, 1.0, 0.5})),
+                         "relaxed"),
+            material.diffuse(texture.color({0.8, 0.5, 0.3}))),
+      shape(geom.sdf(sdf.translate(sdf.torus(0.8, 0.2), {0.0, 0.2, 2.0})),
+            material.diffuse(texture.color({0.3, 0.5, 0.8}))),
+      shape(geom.plane({0.0, 1.0, 0.0}, 0.0), material.diffuse(texture.grid({0.7}, {0.1}, 1.0, 0.05)))
+   }
+
+   local lights = { light.point({0.0, 4.0, 4.0}, {2.0}) }
+
+   local camera = camera.perspective({0.0, 3.0, 7.0}, {0.0, 0.5, 0.0}, {0.0, 1.0, 0.0}, math.pi/3)
+
+   return {shapes = shapes; lights = lights; camera = camera}
+end
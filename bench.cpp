@@ -0,0 +1,755 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <functional>
+#include <tuple>
+#include <sys/resource.h>
+#include <glob.h>
+#include "film.h"
+#include "scheduler.h"
+#include "thread_state.h"
+#include "util.h"
+#include "util/timer.h"
+#include "model.h"
+#include "sampler.h"
+#include "geometry/kdmesh.h"
+#include "geometry/geometry_util.h"
+#include "geometry/heightfield.h"
+#include "geometry/implicit.h"
+#include "geometry/sdf.h"
+#include "intersection.h"
+#include "mat33.h"
+#include "cpp-optparse/OptionParser.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::map;
+using std::function;
+
+/*
+ * Total CPU time (user + system) used by this process so far, in seconds.
+ */
+double process_cpu_time()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+class SpinTask : public LocalTask
+{
+public:
+  SpinTask(uint iterations_) : iterations(iterations_) { }
+
+  void run(uint worker_id) override
+  {
+    volatile uint x = 0;
+    for (auto i = 0u; i < iterations; ++i)
+      x = x + i;
+  }
+
+private:
+  uint iterations;
+};
+
+/*
+ * Compare the schedulers on task-dispatch overhead (many tiny tasks), on a
+ * coarser task load, and on the CPU time they burn while sitting idle.
+ */
+void scheduler_bench(const optparse::Values& options)
+{
+  const uint num_threads = options.get("threads").as<int>() ?
+    options.get("threads").as<int>() : num_system_procs();
+  const uint num_tasks = options.get("tasks").as<int>();
+  const scalar idle_time = options.get("idle").as<double>();
+
+  Film f(1, 1);
+  register_thread_state_manager(f);
+
+  cout << "threads: " << num_threads << ", tasks per round: " << num_tasks << "\n";
+  cout << setw(8) << "type" << setw(20) << "empty (us/task)" << setw(20) << "1k-iter (us/task)"
+       << setw(20) << "idle cpu (s/s)" << "\n";
+
+  for (auto type : {"spin", "steal"})
+  {
+    auto scheduler = make_scheduler(num_threads, type);
+
+    auto dispatch = [&](uint iterations)
+    {
+      Timer tm;
+      for (auto i = 0u; i < num_tasks; ++i)
+        scheduler->add_task(make_shared<SpinTask>(iterations));
+      scheduler->complete_pending();
+      return tm.since() * 1e6 / num_tasks;
+    };
+
+    // warm up the threads before timing anything
+    dispatch(0);
+    auto empty_time = dispatch(0);
+    auto work_time = dispatch(1000);
+
+    auto cpu_start = process_cpu_time();
+    std::this_thread::sleep_for(std::chrono::duration<double>(idle_time));
+    auto idle_cpu = (process_cpu_time() - cpu_start) / idle_time;
+
+    cout << setw(8) << type << setw(20) << empty_time << setw(20) << work_time
+         << setw(20) << idle_cpu << endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Rays from points around the bounding box toward points inside it.
+ */
+vector<Ray> random_rays(const bounds::AABB& box, uint num_rays)
+{
+  UniformSampler sampler;
+  const auto center = box.center();
+  const auto radius = box.size().norm();
+
+  vector<Ray> rays;
+  rays.reserve(num_rays);
+  for (auto i = 0u; i < num_rays; ++i)
+  {
+    auto origin = center + uniform_sphere_sample(sampler.sample_2d()) * radius;
+    auto s = sampler.sample_2d();
+    auto target = box.min() + box.size().elem_mult(Vec3(s[0], s[1], sampler.sample_1d()));
+    rays.emplace_back(origin, (target - origin).normal());
+  }
+  return rays;
+}
+
+/*
+ * Compare the kd-tree and the BVH on every mesh matching --models: build time
+ * (with --threads build threads), memory used by the structure, and
+ * single-threaded closest-hit throughput.
+ */
+void accel_bench(const optparse::Values& options)
+{
+  const uint num_rays = options.get("rays").as<int>();
+  const uint num_threads = options.get("threads").as<int>() ?
+    options.get("threads").as<int>() : num_system_procs();
+
+  // Trees are built on all threads; rays are traced on this one.
+  Film f(1, 1);
+  register_thread_state_manager(f);
+  auto scheduler = make_scheduler(num_threads);
+  set_build_scheduler(scheduler.get());
+
+  glob_t files;
+  glob(options.get("models").as<string>().c_str(), 0, nullptr, &files);
+
+  cout << setw(24) << "model" << setw(10) << "accel" << setw(10) << "tris"
+       << setw(14) << "build (ms)" << setw(14) << "memory (KB)" << setw(12) << "height"
+       << setw(12) << "Mrays/s" << setw(10) << "hits" << "\n";
+
+  for (auto fi = 0u; fi < files.gl_pathc; ++fi)
+  {
+    const string filename = files.gl_pathv[fi];
+    RawModel model;
+    if (!model.load(filename).success)
+    {
+      cerr << "could not load " << filename << endl;
+      continue;
+    }
+
+    vector<Ray> rays;
+    for (auto type : {AccelType::KD_TREE, AccelType::KD_TREE_SWEEP, AccelType::BVH})
+    {
+      Timer build_tm;
+      KDMesh mesh(model, type);
+      const auto build_time = build_tm.since();
+
+      if (rays.empty())
+        rays = random_rays(mesh.get_bounding_box(), num_rays);
+
+      uint hits = 0;
+      Timer trace_tm;
+      for (const auto& ray : rays)
+      {
+        SubGeo geo;
+        if (mesh.intersect(ray, sfp_none, geo).is())
+          ++hits;
+      }
+      const auto trace_time = trace_tm.since();
+
+      cout << setw(24) << filename.substr(filename.rfind('/') + 1)
+           << setw(10) << accel_type_name(type)
+           << setw(10) << model.tris().size()
+           << setw(14) << build_time * 1e3
+           << setw(14) << mesh.tree->memory_usage() / 1024.0
+           << setw(12) << mesh.tree->height()
+           << setw(12) << num_rays / trace_time * 1e-6
+           << setw(10) << hits << endl;
+    }
+  }
+
+  globfree(&files);
+  set_build_scheduler(nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Set-associative cache with LRU replacement, counting misses over the
+ * addresses accessed.
+ */
+class CacheModel
+{
+public:
+  CacheModel(uint size, uint line_size_, uint ways_)
+    : line_size(line_size_), ways(ways_), num_sets(size / (line_size_ * ways_)),
+      lines(num_sets * ways, UINT64_MAX), misses(0)
+  {
+  }
+
+  void access(const void* p)
+  {
+    const uint64_t line = reinterpret_cast<uintptr_t>(p) / line_size;
+    const auto set = lines.begin() + (line % num_sets) * ways;
+    auto it = std::find(set, set + ways, line);
+    if (it == set + ways)
+    {
+      ++misses;
+      --it;
+    }
+
+    // move the line to the front, evicting the least recently used on a miss
+    std::rotate(set, it, it + 1);
+    *set = line;
+  }
+
+  uint64_t num_misses() const { return misses; }
+
+private:
+  uint line_size, ways, num_sets;
+  vector<uint64_t> lines;
+  uint64_t misses;
+};
+
+/*
+ * Compare kd-trees of each model matching --models with and without the
+ * clustered node layout: closest-hit throughput, the distinct cache lines of
+ * nodes read per ray, and node misses in a simulated 32KB, 8-way L1 cache
+ * over the whole ray stream.
+ */
+void kd_layout_bench(const optparse::Values& options)
+{
+  const uint num_rays = options.get("rays").as<int>();
+
+  glob_t files;
+  glob(options.get("models").as<string>().c_str(), 0, nullptr, &files);
+
+  cout << setw(24) << "model" << setw(10) << "layout" << setw(10) << "nodes"
+       << setw(14) << "memory (KB)" << setw(12) << "Mrays/s" << setw(12) << "nodes/ray"
+       << setw(12) << "lines/ray" << setw(14) << "misses/ray" << "\n";
+
+  for (auto fi = 0u; fi < files.gl_pathc; ++fi)
+  {
+    const string filename = files.gl_pathv[fi];
+    RawModel model;
+    if (!model.load(filename).success)
+    {
+      cerr << "could not load " << filename << endl;
+      continue;
+    }
+
+    Mesh mesh(model);
+    vector<const MeshTri*> tris;
+    for (const auto& tri : mesh.triangles())
+      tris.push_back(&tri);
+
+    vector<Ray> rays;
+    for (bool clustered : {false, true})
+    {
+      kd::TreeOptions opt;
+      opt.max_elements_per_leaf = 10;
+      opt.cache_layout = clustered;
+      kd::Tree<MeshTri> tree(tris, opt);
+
+      if (rays.empty())
+        rays = random_rays(tree.get_bounding_box(), num_rays);
+
+      Timer trace_tm;
+      for (const auto& ray : rays)
+      {
+        const MeshTri* tri = nullptr;
+        SubGeo geo;
+        tree.intersect(ray, sfp_none, tri, geo);
+      }
+      const auto trace_time = trace_tm.since();
+
+      CacheModel cache(32 * 1024, 64, 8);
+      uint64_t num_nodes = 0, num_lines = 0;
+      vector<uintptr_t> ray_lines;
+      for (const auto& ray : rays)
+      {
+        const MeshTri* tri = nullptr;
+        SubGeo geo;
+        ray_lines.clear();
+        tree.intersect(ray, sfp_none, tri, geo, [&](const kd::Node<MeshTri>* node)
+                       {
+                         cache.access(node);
+                         ray_lines.push_back(reinterpret_cast<uintptr_t>(node) / 64);
+                       });
+        num_nodes += ray_lines.size();
+        std::sort(ray_lines.begin(), ray_lines.end());
+        num_lines += std::distance(ray_lines.begin(), std::unique(ray_lines.begin(), ray_lines.end()));
+      }
+
+      cout << setw(24) << filename.substr(filename.rfind('/') + 1)
+           << setw(10) << (clustered ? "cluster" : "dfs")
+           << setw(10) << tree.count_leaves() * 2 - 1
+           << setw(14) << tree.memory_usage() / 1024.0
+           << setw(12) << num_rays / trace_time * 1e-6
+           << setw(12) << double(num_nodes) / num_rays
+           << setw(12) << double(num_lines) / num_rays
+           << setw(14) << double(cache.num_misses()) / num_rays << endl;
+    }
+  }
+
+  globfree(&files);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Report what this build's precision costs and buys, so the double and float
+ * builds can be compared side by side (make bench-precision): the size of the
+ * core types and of a 1080p film, then per model the kd-mesh build time,
+ * closest-hit throughput, and how many secondary rays spawned from the hits
+ * (with Ray::offset, in random outgoing directions) hit their own triangle
+ * again.
+ */
+void precision_bench(const optparse::Values& options)
+{
+  const uint num_rays = options.get("rays").as<int>();
+
+  cout << "precision: " << (sizeof(scalar) == sizeof(double) ? "double" : "float")
+       << ", Vec3 " << sizeof(Vec3) << " B, spectrum " << sizeof(spectrum)
+       << " B, Ray " << sizeof(Ray) << " B, 1080p film "
+       << sizeof(Film::AccPixel) * 1920 * 1080 / (1024 * 1024) << " MB\n";
+
+  glob_t files;
+  glob(options.get("models").as<string>().c_str(), 0, nullptr, &files);
+
+  cout << setw(24) << "model" << setw(14) << "build (ms)" << setw(12) << "Mrays/s"
+       << setw(10) << "hits" << setw(16) << "self-hits/1k" << "\n";
+
+  for (auto fi = 0u; fi < files.gl_pathc; ++fi)
+  {
+    const string filename = files.gl_pathv[fi];
+    RawModel model;
+    if (!model.load(filename).success)
+    {
+      cerr << "could not load " << filename << endl;
+      continue;
+    }
+
+    Timer build_tm;
+    KDMesh mesh(model);
+    const auto build_time = build_tm.since();
+
+    const auto rays = random_rays(mesh.get_bounding_box(), num_rays);
+
+    vector<scalar_fp> ts;
+    ts.reserve(rays.size());
+    vector<SubGeo> geos(rays.size());
+    Timer trace_tm;
+    for (auto i = 0u; i < rays.size(); ++i)
+      ts.push_back(mesh.intersect(rays[i], sfp_none, geos[i]));
+    const auto trace_time = trace_tm.since();
+
+    uint hits = 0, self_hits = 0;
+    UniformSampler sampler;
+    for (auto i = 0u; i < rays.size(); ++i)
+    {
+      if (!ts[i].is())
+        continue;
+      ++hits;
+
+      const auto p = rays[i].evaluate(ts[i].get());
+      const auto normal = mesh.normal(geos[i], p);
+      auto dir = uniform_sphere_sample(sampler.sample_2d());
+      if (dir.dot(normal) * rays[i].direction.dot(normal) > 0)
+        dir = -dir;
+
+      SubGeo geo;
+      if (mesh.intersect(Ray{p, dir}.offset(normal), sfp_none, geo).is() && geo == geos[i])
+        ++self_hits;
+    }
+
+    cout << setw(24) << filename.substr(filename.rfind('/') + 1)
+         << setw(14) << build_time * 1e3
+         << setw(12) << num_rays / trace_time * 1e-6
+         << setw(10) << hits
+         << setw(16) << (hits ? 1000.0 * self_hits / hits : 0) << endl;
+  }
+
+  globfree(&files);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * The vector kernels with plain three-scalar storage and arithmetic, as
+ * Vec3 and spectrum were implemented before the SIMD lanes.
+ */
+struct scalar3
+{
+  scalar x, y, z;
+};
+
+inline scalar3 operator +(const scalar3& a, const scalar3& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline scalar3 operator *(const scalar3& a, const scalar3& b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+inline scalar3 operator *(const scalar3& a, scalar s) { return {a.x * s, a.y * s, a.z * s}; }
+inline scalar dot(const scalar3& a, const scalar3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline scalar3 cross(const scalar3& a, const scalar3& b)
+{
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+inline scalar3 normal(const scalar3& a)
+{
+  const scalar len = sqrt(dot(a, a));
+  return {a.x / len, a.y / len, a.z / len};
+}
+
+/*
+ * Time each kernel over arrays of vectors, with the Vec3/spectrum types and
+ * with plain scalar3 storage, in ns per operation.
+ */
+void vector_bench(const optparse::Values& options)
+{
+  const uint num_ops = options.get("ops").as<int>();
+  const uint n = 4096;
+  const uint rounds = std::max(1u, num_ops / n);
+
+  UniformSampler sampler;
+  vector<Vec3> a, b, out(n);
+  vector<spectrum> e, r, out_s(n);
+  vector<scalar3> sa, sb, se, sr, sout(n);
+  vector<scalar> w;
+  for (auto i = 0u; i < n; ++i)
+  {
+    a.push_back(uniform_sphere_sample(sampler.sample_2d()) * (sampler.sample_1d() + 0.5));
+    b.push_back(uniform_sphere_sample(sampler.sample_2d()));
+    e.emplace_back(sampler.sample_1d(), sampler.sample_1d(), sampler.sample_1d());
+    r.emplace_back(sampler.sample_1d(), sampler.sample_1d(), sampler.sample_1d());
+    w.push_back(sampler.sample_1d());
+
+    sa.push_back({a[i].x, a[i].y, a[i].z});
+    sb.push_back({b[i].x, b[i].y, b[i].z});
+    se.push_back({e[i].x, e[i].y, e[i].z});
+    sr.push_back({r[i].x, r[i].y, r[i].z});
+  }
+
+  volatile scalar sink = 0;
+  auto time_ns = [&](function<scalar(uint)> kernel)
+  {
+    scalar total = 0;
+    Timer tm;
+    for (auto k = 0u; k < rounds; ++k)
+      total += kernel(k);
+    const auto elapsed = tm.since();
+    sink = sink + total;
+    return elapsed / (double(rounds) * n) * 1e9;
+  };
+
+  vector<std::tuple<string, function<scalar(uint)>, function<scalar(uint)>>> kernels{
+    std::make_tuple("a + b", [&](uint) {
+        for (auto i = 0u; i < n; ++i) out[i] = a[i] + b[i];
+        return out[n - 1].x;
+      }, [&](uint) {
+        for (auto i = 0u; i < n; ++i) sout[i] = sa[i] + sb[i];
+        return sout[n - 1].x;
+      }),
+    std::make_tuple("a * s", [&](uint) {
+        for (auto i = 0u; i < n; ++i) out[i] = a[i] * w[i];
+        return out[n - 1].x;
+      }, [&](uint) {
+        for (auto i = 0u; i < n; ++i) sout[i] = sa[i] * w[i];
+        return sout[n - 1].x;
+      }),
+    std::make_tuple("dot", [&](uint) {
+        scalar d = 0;
+        for (auto i = 0u; i < n; ++i) d += a[i].dot(b[i]);
+        return d;
+      }, [&](uint) {
+        scalar d = 0;
+        for (auto i = 0u; i < n; ++i) d += dot(sa[i], sb[i]);
+        return d;
+      }),
+    std::make_tuple("cross", [&](uint) {
+        for (auto i = 0u; i < n; ++i) out[i] = a[i].cross(b[i]);
+        return out[n - 1].x;
+      }, [&](uint) {
+        for (auto i = 0u; i < n; ++i) sout[i] = cross(sa[i], sb[i]);
+        return sout[n - 1].x;
+      }),
+    std::make_tuple("normal", [&](uint) {
+        for (auto i = 0u; i < n; ++i) out[i] = a[i].normal();
+        return out[n - 1].x;
+      }, [&](uint) {
+        for (auto i = 0u; i < n; ++i) sout[i] = normal(sa[i]);
+        return sout[n - 1].x;
+      }),
+    std::make_tuple("scaled_product", [&](uint) {
+        for (auto i = 0u; i < n; ++i) out_s[i] = scaled_product(e[i], r[i], w[i]);
+        return out_s[n - 1].x;
+      }, [&](uint) {
+        for (auto i = 0u; i < n; ++i) sout[i] = se[i] * sr[i] * w[i];
+        return sout[n - 1].x;
+      }),
+    std::make_tuple("add_scaled_product", [&](uint) {
+        spectrum total{0.0};
+        for (auto i = 0u; i < n; ++i) add_scaled_product(total, e[i], r[i], w[i]);
+        return total.x + total.y + total.z;
+      }, [&](uint) {
+        scalar3 total{0, 0, 0};
+        for (auto i = 0u; i < n; ++i) total = total + se[i] * sr[i] * w[i];
+        return total.x + total.y + total.z;
+      })
+  };
+
+  cout << "vector: " << simd::WIDTH << " lanes of " << sizeof(scalar) * 8 << "-bit scalars\n";
+  cout << setw(20) << "kernel" << setw(14) << "simd (ns)" << setw(14) << "scalar (ns)"
+       << setw(10) << "speedup" << "\n";
+  for (const auto& k : kernels)
+  {
+    const auto simd_ns = time_ns(std::get<1>(k));
+    const auto scalar_ns = time_ns(std::get<2>(k));
+    cout << setw(20) << std::get<0>(k) << setw(14) << simd_ns << setw(14) << scalar_ns
+         << setw(10) << scalar_ns / simd_ns << endl;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Cost of the shading frame built for each intersection: the rotation matrices
+ * Intersection used to build up front, against the Frame it now builds when
+ * shading. Each takes a direction into local space and back.
+ */
+void frame_bench(const optparse::Values& options)
+{
+  const uint num_ops = options.get("ops").as<int>();
+  const uint n = 4096;
+  const uint rounds = std::max(1u, num_ops / n);
+
+  UniformSampler sampler;
+  vector<Vec3> normals, dirs, out(n);
+  for (auto i = 0u; i < n; ++i)
+  {
+    normals.push_back(uniform_sphere_sample(sampler.sample_2d()));
+    dirs.push_back(uniform_sphere_sample(sampler.sample_2d()));
+  }
+
+  Timer mat_tm;
+  for (auto k = 0u; k < rounds; ++k)
+  {
+    for (auto i = 0u; i < n; ++i)
+    {
+      const auto to_z = Mat33::rotate_to_z(normals[i]);
+      const auto from_z = to_z.transpose();
+      out[i] = from_z * (to_z * dirs[i]);
+    }
+  }
+  const auto mat_time = mat_tm.since();
+  const scalar mat_check = out[n - 1].x;
+
+  Timer frame_tm;
+  for (auto k = 0u; k < rounds; ++k)
+  {
+    for (auto i = 0u; i < n; ++i)
+    {
+      const Frame f{normals[i]};
+      out[i] = f.to_world(f.to_local(dirs[i]));
+    }
+  }
+  const auto frame_time = frame_tm.since();
+
+  const double ops = double(rounds) * n;
+  cout << "Intersection " << sizeof(Intersection) << " B (the matrices were another "
+       << 2 * sizeof(Mat33) << " B)\n";
+  cout << setw(12) << "frame" << setw(12) << "ns/op" << "\n";
+  cout << setw(12) << "rotate_to_z" << setw(12) << mat_time / ops * 1e9 << "\n";
+  cout << setw(12) << "Frame" << setw(12) << frame_time / ops * 1e9 << endl;
+  if (fabs(mat_check - out[n - 1].x) > 1e-3)
+    cerr << "round trips differ\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Plain against over-relaxed sphere tracing of a few implicit surfaces:
+ * function evaluations per ray and single-threaded throughput, on --rays
+ * random rays each.
+ */
+void implicit_bench(const optparse::Values& options)
+{
+  const uint num_rays = options.get("rays").as<int>();
+  count_implicit_evaluations(true);
+
+  auto torus = [](const Vec3& v) {
+    const scalar a = sqrt(v.x * v.x + v.z * v.z) - 1.0;
+    return sqrt(a * a + v.y * v.y) - 0.25;
+  };
+  // the sphere of scene1.lua, in the 4-norm
+  auto quartic = [](const Vec3& v) {
+    return pow(v.x * v.x * v.x * v.x + v.y * v.y * v.y * v.y + v.z * v.z * v.z * v.z, 0.25) - 1.0;
+  };
+  auto row = sdf::repeat(sdf::difference(
+                           sdf::smooth_union(sdf::box(Vec3{0.5, 0.4, 0.3}),
+                                             sdf::translate(sdf::sphere(0.3), Vec3{0.6, 0.0, 0.0}), 0.2),
+                           sdf::rotate(sdf::cylinder(0.15, 1.0), Vec3::z_axis, -PI / 2)),
+                         Vec3{2.5, 0.0, 0.0});
+
+  auto unit_grad = [](const Vec3& v) { return v; };
+  map<string, function<shared_ptr<Geometry>()>> surfaces{
+    {"torus", [&] { return make_shared<ImplicitSurface>(torus, unit_grad, 1.0,
+                                                        bounds::AABB{Vec3{-1.25, -0.25, -1.25},
+                                                                     Vec3{1.25, 0.25, 1.25}}); }},
+    {"quartic", [&] { return make_shared<ImplicitSurface>(quartic, unit_grad, 1.0,
+                                                          bounds::AABB{Vec3{-1.1}, Vec3{1.1}}); }},
+    {"sdf-row", [&] { return sdf::make_surface(*row, bounds::AABB{Vec3{-6.0, -0.5, -0.5},
+                                                                  Vec3{6.0, 0.5, 0.5}}); }}
+  };
+
+  cout << setw(10) << "surface" << setw(10) << "tracing" << setw(14) << "evals/ray"
+       << setw(10) << "Mrays/s" << setw(10) << "hits" << "\n";
+
+  for (const auto& entry : surfaces)
+  {
+    for (auto tracing : {ImplicitSurface::Tracing::SPHERE, ImplicitSurface::Tracing::RELAXED})
+    {
+      auto geom = entry.second();
+      auto& surface = dynamic_cast<ImplicitSurface&>(*geom);
+      surface.set_tracing(tracing);
+
+      const auto rays = random_rays(surface.get_bounding_box(), num_rays);
+      uint hits = 0;
+      Timer tm;
+      for (const auto& ray : rays)
+        hits += surface.intersect(ray).is();
+      const auto time = tm.since();
+
+      cout << setw(10) << entry.first
+           << setw(10) << (tracing == ImplicitSurface::Tracing::SPHERE ? "sphere" : "relaxed")
+           << setw(14) << surface.evaluations_per_ray()
+           << setw(10) << num_rays / time * 1e-6 << setw(10) << hits << endl;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * The terrain of heightfield_scene.lua at a few resolutions, as a kd-tree
+ * mesh and as a Heightfield: build time, memory and single-threaded
+ * closest-hit throughput on --rays random rays.
+ */
+void heightfield_bench(const optparse::Values& options)
+{
+  const uint num_rays = options.get("rays").as<int>();
+
+  auto heights = [](scalar x, scalar z) {
+    return 2 - pow(x - 1, 2) - pow(z - 1, 2) + 0.3 * sin(4.1 * x) * cos(3.1 * z) +
+      0.2 * sin(11.1 * x - 5.6 * z + 0.4) * cos(9.9 * (x + z) - 2);
+  };
+
+  cout << setw(8) << "cells" << setw(14) << "geometry" << setw(14) << "build (ms)"
+       << setw(14) << "memory (KB)" << setw(10) << "Mrays/s" << setw(10) << "hits" << "\n";
+
+  for (uint n : {100, 400, 1600})
+  {
+    for (bool native : {false, true})
+    {
+      Timer build_tm;
+      unique_ptr<Geometry> geom;
+      size_t memory;
+      if (native)
+      {
+        auto field = make_unique<Heightfield>(heights, Vec2(0.0, 0.0), Vec2(2.0, 2.0), n, n);
+        memory = field->memory_usage();
+        geom = std::move(field);
+      }
+      else
+      {
+        geom = heightfield_mesh(heights, Vec2(0.0, 0.0), Vec2(2.0, 2.0), n, n);
+        const auto& mesh = dynamic_cast<KDMesh&>(*geom);
+        memory = (n + 1) * (n + 1) * sizeof(Vertex) +
+          mesh.triangles().size() * (sizeof(MeshTri) + sizeof(MeshTriAccel)) +
+          mesh.tree->memory_usage();
+      }
+      const auto build_time = build_tm.since();
+
+      const auto rays = random_rays(geom->get_bounding_box(), num_rays);
+      uint hits = 0;
+      SubGeo subgeo;
+      Timer tm;
+      for (const auto& ray : rays)
+        hits += geom->intersect(ray, sfp_none, subgeo).is();
+      const auto time = tm.since();
+
+      cout << setw(8) << n * n << setw(14) << (native ? "heightfield" : "kd-mesh")
+           << setw(14) << build_time * 1000 << setw(14) << memory / 1024.0
+           << setw(10) << num_rays / time * 1e-6 << setw(10) << hits << endl;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** args)
+{
+  map<string, function<void(const optparse::Values&)>> benchmarks{
+    {"scheduler", scheduler_bench},
+    {"accel", accel_bench},
+    {"kd-layout", kd_layout_bench},
+    {"precision", precision_bench},
+    {"vector", vector_bench},
+    {"frame", frame_bench},
+    {"implicit", implicit_bench},
+    {"heightfield", heightfield_bench}
+  };
+
+  vector<string> bench_names;
+  for (const auto& b: benchmarks)
+    bench_names.push_back(b.first);
+
+  optparse::OptionParser parser;
+  parser.usage("%prog BENCHMARK [options]\n\nbenchmarks: " + join(bench_names, ", "));
+
+  parser.add_option("-t", "--threads").action("store").type("int").set_default(0)
+    .help("number of threads (0 for all processors)");
+  parser.add_option("-n", "--tasks").action("store").type("int").set_default(100000)
+    .help("number of tasks per scheduler round");
+  parser.add_option("--idle").action("store").type("float").set_default(1.0)
+    .help("seconds to measure idle cpu usage over");
+  parser.add_option("--models").action("store").set_default("assets/models/*.obj")
+    .help("glob of the models to build acceleration structures for");
+  parser.add_option("--rays").action("store").type("int").set_default(500000)
+    .help("number of rays to trace per acceleration structure");
+  parser.add_option("--ops").action("store").type("int").set_default(20000000)
+    .help("number of operations to time per kernel");
+
+  auto& options = parser.parse_args(argc, args);
+  auto positional = parser.args();
+
+  if (positional.size() != 1 || benchmarks.find(positional[0]) == benchmarks.end())
+  {
+    parser.print_help();
+    return 1;
+  }
+
+  benchmarks.at(positional[0])(options);
+  return 0;
+}
@@ -12,6 +12,7 @@
 
 #include "scene.h"
 #include "kdscene.h"
+#include "geometry/implicit.h"
 
 #include "scenes/basic_scenes.h"
 #include "reinhard.h"
@@ -62,6 +63,11 @@ auto parse_args(int argc, char**args)
   parser.add_option("-w", "--width").action("store").type("int").set_default(400);
   parser.add_option("-h", "--height").action("store").type("int").set_default(300);
   parser.add_option("-t", "--threads").action("store").type("int").set_default(1);
+  parser.add_option("--scheduler").action("store").choices(std::vector<string>({"steal", "spin"}))
+    .set_default("steal").help("multi-threaded task scheduler");
+  parser.add_option("--tiles").action("store")
+    .choices(std::vector<string>({"grid", "hilbert", "adaptive"})).set_default("grid")
+    .help("image tiling: column-major grid, hilbert-ordered grid, or cost-adaptive tiles");
   parser.add_option("-s", "--samples").action("store").type("int").set_default(5);
   parser.add_option("-b", "--benchmark").action("store").type("int").set_default(1);
   parser.add_option("-o", "--output_file").action("store");
@@ -79,11 +85,15 @@ auto parse_args(int argc, char**args)
 
   parser.add_option("--kd").action("store_const").dest("scene_container").set_const("kd");
   parser.add_option("--basic").action("store_const").dest("scene_container").set_const("basic");
+  parser.add_option("--bvh").action("store_const").dest("scene_container").set_const("bvh");
+  parser.add_option("--kd-sweep").action("store_const").dest("scene_container").set_const("kd-sweep");
 
   parser.add_option("-f", "--scene").action("store").dest("scene").set_default("assets/scripts/scene1.lua");
 
   parser.add_option("--weights").action("store_true").set_default(false);
   parser.add_option("--pv").action("store_true").set_default(false);
+  parser.add_option("--implicit-stats").action("store_true").dest("implicit_stats").set_default(false)
+    .help("count evaluations per ray of implicit surfaces");
 
   parser.set_defaults("scene_container", "");
 
@@ -103,25 +113,33 @@ int main(int argc, char** args)
   uint per_pixel = options.get("samples").as<int>();
   assert(per_pixel > 0);
 
+  Film f(WIDTH, HEIGHT);
+
+  register_thread_state_manager(f);
+  auto num_threads = options.get("threads").as<int>();
+  if (num_threads == 0)
+    num_threads = num_system_procs();
+  cerr << "using " << num_threads << " threads.\n";
+
+  // The scheduler is created before the scene, so that acceleration
+  // structures can be built in parallel.
+  auto scheduler = make_scheduler(num_threads, options.get("scheduler"));
+  set_build_scheduler(scheduler.get());
+
   auto scene = make_scene(options.get("scene_container"));
+  count_implicit_evaluations(options.get("implicit_stats").as<bool>());
 
   string scene_filename = options.get("scene").as<string>();
 
   Camera* cam;
   {
     Timer tm;
-    cam = lua_scene(*scene, scene_filename);
+    LuaRunner runner(scene_filename);
+    cam = lua_scene(*scene, runner);
+    set_thread_lua_snapshot(runner.snapshot());
     cerr << "Loaded scene in " << format_duration(tm.since()) << "\n";
   }
 
-  Film f(WIDTH, HEIGHT);
-
-  register_thread_state_manager(f, scene_filename);
-  auto num_threads = options.get("threads").as<int>();
-  if (num_threads == 0)
-    num_threads = num_system_procs();
-  cerr << "using " << num_threads << " threads.\n";
-
   unique_ptr<RayIntegrator> igr;
   string igr_type = options["integrator"];
 
@@ -151,13 +169,17 @@ int main(int argc, char** args)
     scene->prepare();
     cerr << "Prepared scene in " << format_duration(tm.since()) << endl;
   }
+  set_build_scheduler(nullptr);
 
   scalar render_time = 0;
 
   auto benchmark_trials = options.get("benchmark").as<int>();
 
   {
-    auto scheduler = make_scheduler(num_threads);
+    const map<string, TileMode> tile_modes{{"grid", TileMode::GRID},
+                                           {"hilbert", TileMode::HILBERT},
+                                           {"adaptive", TileMode::ADAPTIVE}};
+    const TileMode tile_mode = tile_modes.at(options.get("tiles"));
 
     if (benchmark_trials > 1)
     {
@@ -170,7 +192,7 @@ int main(int argc, char** args)
       {
         Film f(WIDTH, HEIGHT);
         Timer tm;
-        grid_render(*igr, *cam, *scene, f, *scheduler, per_pixel);
+        grid_render(*igr, *cam, *scene, f, *scheduler, per_pixel, tile_mode);
         if (i >= toss)
           stats.update(tm.since());
       }
@@ -193,6 +215,7 @@ int main(int argc, char** args)
       else if (use_pmc)
       {
         PMCGridOptions pmc_opt;
+        pmc_opt.tile_mode = tile_mode;
         if (per_pixel <= 4)
         {
           pmc_opt.initial_spp = per_pixel;
@@ -207,13 +230,16 @@ int main(int argc, char** args)
         pmc_render(*igr, *cam, *scene, f, *scheduler, pmc_opt);
       }
       else
-        grid_render(*igr, *cam, *scene, f, *scheduler, per_pixel);
+        grid_render(*igr, *cam, *scene, f, *scheduler, per_pixel, tile_mode);
 
       render_time = tm.since();
       cerr << "Render Time: " << format_duration(render_time) << endl;
     }
   }
 
+  if (const auto evals = implicit_evaluations_per_ray())
+    cerr << "Implicit surfaces: " << evals << " evaluations per ray" << endl;
+
   sp_image image_to_show = f.image();
 
   /*
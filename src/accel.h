@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cassert>
+#include "kdtree.h"
+#include "bvh.h"
+
+using std::unique_ptr;
+using std::make_unique;
+
+/*
+ * Acceleration structures available for scenes and meshes.
+ */
+enum class AccelType
+{
+  KD_TREE,
+  KD_TREE_SWEEP,
+  BVH
+};
+
+/*
+ * "kd" (or "") for a kd-tree, "kd-sweep" for a kd-tree built with the exact
+ * sweep SAH, "bvh" for a bounding volume hierarchy.
+ */
+inline AccelType accel_type_from_string(const std::string& name)
+{
+  if (name == "bvh")
+    return AccelType::BVH;
+  if (name == "kd-sweep")
+    return AccelType::KD_TREE_SWEEP;
+
+  assert(name == "kd" || name == "");
+  return AccelType::KD_TREE;
+}
+
+inline const char* accel_type_name(AccelType type)
+{
+  switch (type)
+  {
+  case AccelType::KD_TREE_SWEEP:
+    return "kd-sweep";
+  case AccelType::BVH:
+    return "bvh";
+  default:
+    return "kd";
+  }
+}
+
+/*
+ * Either a kd::Tree or a bvh::Tree over a set of elements, chosen at
+ * construction.
+ */
+template <typename T>
+class Accelerator
+{
+public:
+  using element_type = T const*;
+
+  Accelerator(const vector<element_type>& objects, AccelType type,
+              const kd::TreeOptions& kd_opt = kd::TreeOptions(),
+              const bvh::TreeOptions& bvh_opt = bvh::TreeOptions())
+  {
+    if (type == AccelType::BVH)
+      bvh_tree = make_unique<bvh::Tree<T>>(objects, bvh_opt);
+    else if (type == AccelType::KD_TREE_SWEEP)
+    {
+      auto opt = kd_opt;
+      opt.build_mode = kd::BuildMode::SWEEP;
+      kd_tree = make_unique<kd::Tree<T>>(objects, opt);
+    }
+    else
+      kd_tree = make_unique<kd::Tree<T>>(objects, kd_opt);
+  }
+
+  scalar_fp intersect(const Ray& ray, const scalar_fp max_t, element_type& geom, SubGeo& subgeo) const
+  {
+    return bvh_tree ? bvh_tree->intersect(ray, max_t, geom, subgeo) :
+      kd_tree->intersect(ray, max_t, geom, subgeo);
+  }
+
+  bool occluded(const Ray& ray, const scalar_fp max_t) const
+  {
+    return bvh_tree ? bvh_tree->occluded(ray, max_t) : kd_tree->occluded(ray, max_t);
+  }
+
+  bounds::AABB get_bounding_box() const
+  {
+    return bvh_tree ? bvh_tree->get_bounding_box() : kd_tree->get_bounding_box();
+  }
+
+  size_t memory_usage() const
+  {
+    return bvh_tree ? bvh_tree->memory_usage() : kd_tree->memory_usage();
+  }
+
+  int height() const
+  {
+    return bvh_tree ? bvh_tree->height() : kd_tree->height();
+  }
+
+  int count_leaves() const
+  {
+    return bvh_tree ? bvh_tree->count_leaves() : kd_tree->count_leaves();
+  }
+
+  /*
+   * The kd-tree, if that is the structure used.
+   */
+  const kd::Tree<T>* kd() const { return kd_tree.get(); }
+
+private:
+  unique_ptr<kd::Tree<T>> kd_tree;
+  unique_ptr<bvh::Tree<T>> bvh_tree;
+};
@@ -0,0 +1,189 @@
+#include "area_light.h"
+#include "scene.h"
+#include "frame.h"
+#include "geometry/sphere.h"
+#include "geometry/mesh.h"
+
+using std::make_unique;
+using std::max;
+
+spectrum AreaLight::emission(const Scene& scene, const IntersectionView& isect,
+                             const EmissionSample& sample) const
+{
+  const auto ray = Ray{isect.position, sample.ray.position - isect.position}.offset(isect.normal);
+  const auto hit = scene.closest_hit(ray, scalar_fp{1.0 + NUDGE_EPSILON});
+  if (!hit.is() || hit.get().shape != shape || hit.get().t < 1.0 - NUDGE_EPSILON)
+    return spectrum::zero;
+
+  return Intersection{hit.get(), ray}.emission();
+}
+
+LightSample AreaLight::solid_angle_sample(const Intersection& isect, SubGeo subgeo, const Vec3& y,
+                                          const Vec3& n_y, scalar p) const
+{
+  // Move both ends off their surfaces, so the shadow test hits neither.
+  const auto from = Ray{isect.position, y - isect.position}.offset(isect.normal).position;
+  const auto to = Ray{y, from - y}.offset(n_y).position;
+  return LightSample{emission_at(subgeo, y), p, from, to};
+}
+
+LightSample AreaLight::area_sample(const Intersection& isect, SubGeo subgeo, const Vec3& y,
+                                   const Vec3& n_y, scalar p_area) const
+{
+  const Vec3 d = y - isect.position;
+  const scalar d2 = d.norm2();
+  const scalar cos_y = fabs(n_y.dot(d)) / sqrt(d2);
+  if (!(cos_y > 0))
+    return LightSample();
+
+  return solid_angle_sample(isect, subgeo, y, n_y, p_area * d2 / cos_y);
+}
+
+spectrum AreaLight::emission_at(SubGeo subgeo, const Vec3& y) const
+{
+  return Intersection{shape, subgeo, y}.emission();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SphereLight::SphereLight(const Shape* shape, const Sphere* s)
+  : AreaLight(shape), sphere(s), power(0)
+{
+  // The average emission over the poles of each axis, over the projected
+  // area seen from anywhere.
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    Vec3 offset = Vec3::zero;
+    offset[axis] = sphere->radius;
+    power += emission_at(0, sphere->position + offset).luminance() +
+      emission_at(0, sphere->position - offset).luminance();
+  }
+  power *= PI * sphere->radius2 / 6;
+}
+
+LightSample SphereLight::sample_emission(const Intersection& isect, Sampler& sampler) const
+{
+  const Vec3 to_center = sphere->position - isect.position;
+  const scalar d2 = to_center.norm2();
+
+  // Points on the sphere itself count as inside, where the cone degenerates.
+  if (d2 <= sphere->radius2 * (1 + SCALAR_EPSILON))
+  {
+    // Every point is visible from inside.
+    const auto n = uniform_sphere_sample(sampler.sample_2d());
+    return area_sample(isect, 0, sphere->position + n * sphere->radius, n,
+                       1 / (4 * PI * sphere->radius2));
+  }
+
+  const scalar d = sqrt(d2);
+  const scalar cos_max = sqrt(max<scalar>(0, 1 - sphere->radius2 / d2));
+  const Vec3 w = Frame{to_center / d}.to_world(uniform_cone_sample(sampler.sample_2d(), cos_max));
+
+  // the nearer point of the sphere along w
+  const scalar cos_theta = w.dot(to_center) / d;
+  const scalar t = d * cos_theta -
+    sqrt(max<scalar>(0, sphere->radius2 - d2 * (1 - cos_theta * cos_theta)));
+  const Vec3 y = isect.position + w * t;
+
+  return solid_angle_sample(isect, 0, y, (y - sphere->position).normal(), uniform_cone_pdf(cos_max));
+}
+
+EmissionSample SphereLight::sample_emission(const Scene& UNUSED(scene), Sampler& sampler) const
+{
+  const auto n = uniform_sphere_sample(sampler.sample_2d());
+  scalar p_dir;
+  const auto dir = Frame{n}.to_world(cosine_weighted_hemisphere_sample(sampler.sample_2d(), p_dir));
+
+  return EmissionSample{this, Ray{sphere->position + n * sphere->radius, dir},
+                        p_dir / (4 * PI * sphere->radius2)};
+}
+
+optional<LightBounds> SphereLight::bounds() const
+{
+  return LightBounds{sphere->get_bounding_box(), power, Vec3::z_axis, -1, 0, true};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MeshLight::MeshLight(const Shape* shape, const Mesh* m)
+  : AreaLight(shape), mesh(m), power(0)
+{
+  const auto& tris = mesh->triangles();
+  vector<double> weights;
+  for (auto i = 0u; i < tris.size(); ++i)
+  {
+    const auto& tri = tris[i];
+    const Vec3 e1 = tri.position(1) - tri.position(0), e2 = tri.position(2) - tri.position(0);
+    const Vec3 centroid = (tri.position(0) + tri.position(1) + tri.position(2)) * (1.0 / 3);
+
+    areas.push_back(0.5 * e1.cross(e2).norm());
+    weights.push_back(areas.back() * emission_at(i, centroid).luminance());
+    power += weights.back();
+  }
+
+  if (power > 0)
+    table = AliasTable(weights);
+}
+
+Vec3 MeshLight::sample_triangle(uint tri, const Sample2D& s, Vec3& normal) const
+{
+  const auto& t = mesh->triangles()[tri];
+  const Vec3 e1 = t.position(1) - t.position(0), e2 = t.position(2) - t.position(0);
+  normal = e1.cross(e2).normal();
+
+  const auto b = uniform_triangle_sample(s);
+  return t.position(0) + e1 * b.u + e2 * b.v;
+}
+
+LightSample MeshLight::sample_emission(const Intersection& isect, Sampler& sampler) const
+{
+  scalar p_tri;
+  const auto tri = table.sample(sampler.sample_1d(), p_tri);
+
+  Vec3 n;
+  const auto y = sample_triangle(tri, sampler.sample_2d(), n);
+  return area_sample(isect, tri, y, n, p_tri / areas[tri]);
+}
+
+EmissionSample MeshLight::sample_emission(const Scene& UNUSED(scene), Sampler& sampler) const
+{
+  scalar p_tri;
+  const auto tri = table.sample(sampler.sample_1d(), p_tri);
+
+  Vec3 n;
+  const auto y = sample_triangle(tri, sampler.sample_2d(), n);
+
+  // either side of the triangle
+  if (sampler.sample_1d() < 0.5)
+    n = -n;
+
+  scalar p_dir;
+  const auto dir = Frame{n}.to_world(cosine_weighted_hemisphere_sample(sampler.sample_2d(), p_dir));
+
+  return EmissionSample{this, Ray{y, dir}, p_dir * p_tri / (2 * areas[tri])};
+}
+
+optional<LightBounds> MeshLight::bounds() const
+{
+  return LightBounds{mesh->get_bounding_box(), power, Vec3::z_axis, -1, 0, true};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+unique_ptr<AreaLight> make_area_light(const Shape* shape)
+{
+  if (!dynamic_cast<const EmissiveMaterial*>(shape->material))
+    return nullptr;
+
+  if (auto sphere = dynamic_cast<const Sphere*>(shape->geometry))
+    return make_unique<SphereLight>(shape, sphere);
+
+  if (auto mesh = dynamic_cast<const Mesh*>(shape->geometry))
+  {
+    auto light = make_unique<MeshLight>(shape, mesh);
+    if (!light->empty())
+      return light;
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <memory>
+#include "light.h"
+#include "sampler.h"
+
+class Sphere;
+class Mesh;
+
+using std::unique_ptr;
+
+/*
+ * The emission of a shape with an emissive material, as a light that
+ * integrators can sample directly instead of waiting for paths to hit the
+ * shape. The emission is the material's, evaluated at the sampled point, and
+ * leaves both sides of the surface.
+ */
+class AreaLight : public Light
+{
+public:
+  AreaLight(const Shape* s) : shape(s) { }
+
+  /*
+   * The emission reaching isect from the point sampled on the shape, if the
+   * first thing on the way back to the light is that point.
+   */
+  spectrum emission(const Scene& scene, const IntersectionView& isect,
+                    const EmissionSample& sample) const override;
+
+  const Shape* shape;
+
+protected:
+  /*
+   * A sample of the point y, with normal n_y, on sub-shape subgeo, for the
+   * shading point isect, where p is the density of y over the solid angle at
+   * isect. area_sample takes the density over the shape's area instead.
+   */
+  LightSample solid_angle_sample(const Intersection& isect, SubGeo subgeo, const Vec3& y,
+                                 const Vec3& n_y, scalar p) const;
+  LightSample area_sample(const Intersection& isect, SubGeo subgeo, const Vec3& y,
+                          const Vec3& n_y, scalar p_area) const;
+
+  spectrum emission_at(SubGeo subgeo, const Vec3& y) const;
+};
+
+/*
+ * Samples the cone of directions in which the sphere is seen, rather than
+ * its area, so that no samples land on the far side.
+ */
+class SphereLight : public AreaLight
+{
+public:
+  SphereLight(const Shape* shape, const Sphere* sphere);
+
+  LightSample sample_emission(const Intersection& isect, Sampler&) const override;
+  EmissionSample sample_emission(const Scene& scene, Sampler&) const override;
+
+  optional<LightBounds> bounds() const override;
+
+  std::string to_string() const override { return "SphereLight"; }
+
+private:
+  const Sphere* sphere;
+  scalar power;
+};
+
+/*
+ * Chooses a triangle in proportion to its area and emission, with an alias
+ * table, then a point uniformly over the triangle.
+ */
+class MeshLight : public AreaLight
+{
+public:
+  MeshLight(const Shape* shape, const Mesh* mesh);
+
+  LightSample sample_emission(const Intersection& isect, Sampler&) const override;
+  EmissionSample sample_emission(const Scene& scene, Sampler&) const override;
+
+  optional<LightBounds> bounds() const override;
+
+  std::string to_string() const override { return "MeshLight"; }
+
+  bool empty() const { return table.size() == 0; }
+
+private:
+  // A point on triangle tri, with its geometric normal
+  Vec3 sample_triangle(uint tri, const Sample2D& s, Vec3& normal) const;
+
+  const Mesh* mesh;
+  AliasTable table;
+  vector<scalar> areas;
+  scalar power;
+};
+
+/*
+ * A light for the emissive shape, or null if its geometry can't be sampled
+ * (in which case it still emits when hit).
+ */
+unique_ptr<AreaLight> make_area_light(const Shape* shape);
@@ -93,7 +93,7 @@ void BidirectionalPathTracer::construct_path(
     if (mat_sample.prob == 0)
       break;
 
-    ray = Ray(isect.position, mat_sample.direction).nudge();
+    ray = Ray(isect.position, mat_sample.direction).offset(isect.normal);
   }
 }
 
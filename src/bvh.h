@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "bounds.h"
+#include "geometry.h"
+
+using std::vector;
+
+/**
+ * Bounding volume hierarchy, with the same intersection contract as kd::Tree.
+ *
+ * The tree is built top-down with a binned SAH (as in "On fast Construction of
+ * SAH-based Bounding Volume Hierarchies", Wald 2007): primitive centroids are
+ * binned along the longest axis of their bounds, and the best split between
+ * bins is chosen. Every primitive is referenced exactly once.
+ *
+ * Nodes are stored depth-first in a single array, so the left child of an
+ * inner node immediately follows it. Traversal uses a fixed-size stack.
+ */
+namespace bvh
+{
+  struct TreeOptions
+  {
+    uint32_t num_bins = 16;
+
+    scalar traversal_cost = 1.0;
+    scalar intersection_cost = 1.0;
+
+    uint32_t max_elements_per_leaf = 4;
+
+    // Larger leaves are made only when the SAH prefers them, up to this size.
+    uint32_t max_leaf_size = 16;
+  };
+
+  /*
+   * 32-byte flattened node. Bounds are stored in single precision, rounded
+   * outward.
+   */
+  struct Node
+  {
+    float bounds[2][3];
+
+    // leaf: offset of the first element index; inner: index of the right child
+    uint32_t offset;
+
+    // number of elements for a leaf, or 0 for an inner node
+    uint16_t num_objects;
+
+    // split axis of an inner node
+    uint16_t axis;
+
+    bool is_leaf() const { return num_objects > 0; }
+  };
+  static_assert(sizeof(Node) == 32, "bvh::Node is incorrect size");
+
+  template <typename T>
+  class Tree
+  {
+  public:
+    using element_type = T const*;
+    using obj_index = uint32_t;
+
+    // Traversal never needs more stack entries than the tree is deep.
+    static const int MAX_DEPTH = 64;
+
+    Tree(const vector<element_type>& objects, const TreeOptions& opt);
+
+    scalar_fp intersect(const Ray& ray, const scalar_fp max_t, element_type& geom, SubGeo& subgeo) const;
+
+    /*
+     * True if any element is hit before max_t, stopping at the first hit.
+     */
+    bool occluded(const Ray& ray, const scalar_fp max_t) const;
+
+    auto get_bounding_box() const { return bound; }
+
+    int height() const { return _height; }
+
+    int count_leaves() const;
+    int count_objects() const { return indices.size(); }
+
+    /*
+     * Bytes used by the nodes and element references.
+     */
+    size_t memory_usage() const;
+
+  private:
+    struct build_ref
+    {
+      bounds::AABB box;
+      Vec3 centroid;
+    };
+
+    uint build(vector<build_ref>& refs, uint begin, uint end, uint depth,
+               const TreeOptions& opt);
+
+    scalar_fp leaf_intersect(const Node& leaf, const Ray& ray, scalar_fp max_t,
+                             element_type& obj, SubGeo& geo) const;
+
+    vector<element_type> elements;
+    vector<obj_index> indices;
+    vector<Node> nodes;
+
+    bounds::AABB bound;
+    size_t _height;
+  };
+}
+
+#include "bvh.hpp"
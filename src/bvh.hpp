@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include "bvh.h"
+
+namespace bvh
+{
+  namespace
+  {
+    /*
+     * Round a bound to single precision, away from the box, so the stored node
+     * never shrinks.
+     */
+    inline float round_down(scalar v)
+    {
+      float f = v;
+      return f > v ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    inline float round_up(scalar v)
+    {
+      float f = v;
+      return f < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    /*
+     * Slab test of a ray against a node, clipped to [0, max_t]. On a hit, t_entry
+     * is the distance at which the ray enters the box.
+     */
+    inline bool node_hit(const Node& node, const Ray& ray, scalar max_t, scalar& t_entry)
+    {
+      scalar t0 = 0, t1 = max_t;
+      for (int a = 0; a < 3; ++a)
+      {
+        const scalar near = (node.bounds[ray.sign[a]][a] - ray.position[a]) * ray.inv_direction[a];
+        const scalar far = (node.bounds[1 - ray.sign[a]][a] - ray.position[a]) * ray.inv_direction[a];
+        t0 = std::max(t0, near);
+        t1 = std::min(t1, far);
+      }
+      t_entry = t0;
+      return t0 <= t1;
+    }
+
+    const bounds::AABB EMPTY_BOX(Vec3{SCALAR_MAX}, Vec3{-SCALAR_MAX});
+  }
+
+  template <typename T>
+  Tree<T>::Tree(const vector<element_type>& objects, const TreeOptions& opt)
+    : bound(Vec3::zero, Vec3::zero), _height(0)
+  {
+    assert(opt.num_bins >= 2);
+    if (objects.empty())
+      return;
+
+    elements = objects;
+
+    vector<build_ref> refs(objects.size());
+    for (auto i = 0u; i < objects.size(); ++i)
+    {
+      refs[i].box = objects[i]->get_bounding_box();
+      refs[i].centroid = refs[i].box.center();
+    }
+
+    indices.resize(objects.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    nodes.reserve(2 * objects.size());
+    build(refs, 0, objects.size(), 1, opt);
+    nodes.shrink_to_fit();
+
+    const auto& root = nodes[0];
+    bound = bounds::AABB(Vec3(root.bounds[0][0], root.bounds[0][1], root.bounds[0][2]),
+                         Vec3(root.bounds[1][0], root.bounds[1][1], root.bounds[1][2]));
+  }
+
+  template <typename T>
+  uint Tree<T>::build(vector<build_ref>& refs, uint begin, uint end, uint depth,
+                      const TreeOptions& opt)
+  {
+    const uint node_index = nodes.size();
+    nodes.emplace_back();
+    _height = std::max<size_t>(_height, depth);
+
+    auto box = EMPTY_BOX, centroid_box = EMPTY_BOX;
+    for (auto i = begin; i < end; ++i)
+    {
+      const auto& ref = refs[indices[i]];
+      box = box.union_with(ref.box);
+      centroid_box = centroid_box.union_with(bounds::AABB(ref.centroid, ref.centroid));
+    }
+
+    for (int a = 0; a < 3; ++a)
+    {
+      nodes[node_index].bounds[0][a] = round_down(box.min()[a]);
+      nodes[node_index].bounds[1][a] = round_up(box.max()[a]);
+    }
+
+    const uint num_objects = end - begin;
+    auto make_leaf = [&]()
+    {
+      assert(num_objects <= std::numeric_limits<uint16_t>::max());
+      nodes[node_index].offset = begin;
+      nodes[node_index].num_objects = num_objects;
+      nodes[node_index].axis = 0;
+      return node_index;
+    };
+
+    if (num_objects <= opt.max_elements_per_leaf || depth >= MAX_DEPTH)
+      return make_leaf();
+
+    const auto extent = centroid_box.size();
+    const int axis = std::distance(extent.v, std::max_element(extent.v, extent.v + 3));
+
+    uint mid;
+    if (extent[axis] <= 0)
+    {
+      // Every centroid coincides, so no split separates them; halve the
+      // range to keep leaves small.
+      mid = begin + num_objects / 2;
+    }
+    else
+    {
+      const uint num_bins = opt.num_bins;
+      const scalar cmin = centroid_box.min()[axis];
+      const scalar bin_scale = num_bins / extent[axis];
+      auto bin_of = [&](const build_ref& ref)
+      {
+        return std::min<uint>(num_bins - 1, (ref.centroid[axis] - cmin) * bin_scale);
+      };
+
+      vector<uint> bin_counts(num_bins, 0);
+      vector<bounds::AABB> bin_boxes(num_bins, EMPTY_BOX);
+      for (auto i = begin; i < end; ++i)
+      {
+        const auto& ref = refs[indices[i]];
+        auto b = bin_of(ref);
+        ++bin_counts[b];
+        bin_boxes[b] = bin_boxes[b].union_with(ref.box);
+      }
+
+      // Sweep from the right to get the cost of every right side, then from
+      // the left to evaluate each split between bins.
+      vector<scalar> right_area(num_bins, 0);
+      vector<uint> right_count(num_bins, 0);
+      auto right_box = EMPTY_BOX;
+      uint count = 0;
+      for (int b = num_bins - 1; b > 0; --b)
+      {
+        count += bin_counts[b];
+        if (bin_counts[b] > 0)
+          right_box = right_box.union_with(bin_boxes[b]);
+        right_count[b] = count;
+        right_area[b] = count > 0 ? right_box.surface_area() : 0;
+      }
+
+      const scalar inv_area = 1.0 / std::max<scalar>(box.surface_area(), EPSILON);
+      scalar best_cost = SCALAR_MAX;
+      uint best_split = 1;
+      auto left_box = EMPTY_BOX;
+      count = 0;
+      for (auto b = 1u; b < num_bins; ++b)
+      {
+        count += bin_counts[b - 1];
+        if (bin_counts[b - 1] > 0)
+          left_box = left_box.union_with(bin_boxes[b - 1]);
+        if (count == 0 || right_count[b] == 0)
+          continue;
+
+        const scalar cost = opt.traversal_cost + opt.intersection_cost * inv_area *
+          (count * left_box.surface_area() + right_count[b] * right_area[b]);
+        if (cost < best_cost)
+        {
+          best_cost = cost;
+          best_split = b;
+        }
+      }
+
+      if (best_cost >= opt.intersection_cost * num_objects && num_objects <= opt.max_leaf_size)
+        return make_leaf();
+
+      auto split = std::partition(indices.begin() + begin, indices.begin() + end,
+                                  [&](obj_index i) { return bin_of(refs[i]) < best_split; });
+      mid = std::distance(indices.begin(), split);
+      assert(begin < mid && mid < end);
+    }
+
+    build(refs, begin, mid, depth + 1, opt);
+    const uint right = build(refs, mid, end, depth + 1, opt);
+
+    nodes[node_index].offset = right;
+    nodes[node_index].num_objects = 0;
+    nodes[node_index].axis = axis;
+    return node_index;
+  }
+
+  template <typename T>
+  scalar_fp Tree<T>::intersect(const Ray& ray, const scalar_fp max_t, element_type& obj, SubGeo& geo) const
+  {
+    if (nodes.empty())
+      return sfp_none;
+
+    scalar_fp best_t = max_t;
+    bool hit = false;
+
+    auto limit = [&]() { return best_t.is() ? best_t.get() : SCALAR_MAX; };
+
+    struct stack_elem
+    {
+      uint32_t node;
+      scalar t_entry;
+    };
+    stack_elem node_stack[MAX_DEPTH];
+    int stack_size = 0;
+
+    scalar t_entry;
+    if (!node_hit(nodes[0], ray, limit(), t_entry))
+      return sfp_none;
+
+    uint32_t active = 0;
+    while (true)
+    {
+      const Node& node = nodes[active];
+      if (node.is_leaf())
+      {
+        auto t = leaf_intersect(node, ray, best_t, obj, geo);
+        if (t.is())
+        {
+          best_t = t;
+          hit = true;
+        }
+      }
+      else
+      {
+        const uint32_t left = active + 1, right = node.offset;
+        scalar t_left, t_right;
+        const bool hit_left = node_hit(nodes[left], ray, limit(), t_left);
+        const bool hit_right = node_hit(nodes[right], ray, limit(), t_right);
+
+        if (hit_left && hit_right)
+        {
+          // Visit the nearer child first, and defer the other.
+          if (t_right < t_left)
+          {
+            node_stack[stack_size++] = stack_elem{left, t_left};
+            active = right;
+          }
+          else
+          {
+            node_stack[stack_size++] = stack_elem{right, t_right};
+            active = left;
+          }
+          continue;
+        }
+        else if (hit_left || hit_right)
+        {
+          active = hit_left ? left : right;
+          continue;
+        }
+      }
+
+      // Pop the next deferred node, skipping any that start beyond the
+      // closest hit found so far.
+      while (stack_size > 0 && node_stack[stack_size - 1].t_entry > limit())
+        --stack_size;
+      if (stack_size == 0)
+        break;
+      active = node_stack[--stack_size].node;
+    }
+
+    return hit ? best_t : sfp_none;
+  }
+
+  template <typename T>
+  bool Tree<T>::occluded(const Ray& ray, const scalar_fp max_t) const
+  {
+    if (nodes.empty())
+      return false;
+
+    const scalar limit = max_t.is() ? max_t.get() : SCALAR_MAX;
+
+    uint32_t node_stack[MAX_DEPTH];
+    int stack_size = 0;
+    node_stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+      const Node& node = nodes[node_stack[--stack_size]];
+      scalar t_entry;
+      if (!node_hit(node, ray, limit, t_entry))
+        continue;
+
+      if (node.is_leaf())
+      {
+        const uint end = node.offset + node.num_objects;
+        for (uint i = node.offset; i < end; ++i)
+        {
+          if (elements[indices[i]]->occluded(ray, max_t))
+            return true;
+        }
+      }
+      else
+      {
+        // Any hit will do, so the children are visited in a fixed order.
+        node_stack[stack_size++] = node.offset;
+        node_stack[stack_size++] = &node - nodes.data() + 1;
+      }
+    }
+
+    return false;
+  }
+
+  template <typename T>
+  scalar_fp Tree<T>::leaf_intersect(const Node& leaf, const Ray& ray, scalar_fp max_t,
+                                    element_type& obj, SubGeo& geo) const
+  {
+    scalar_fp best_t = max_t;
+    element_type best_obj{nullptr};
+    SubGeo best_geo = 0, leaf_geo = 0;
+
+    const uint end = leaf.offset + leaf.num_objects;
+    for (uint i = leaf.offset; i < end; ++i)
+    {
+      const auto shape = elements[indices[i]];
+      auto t = shape->intersect(ray, best_t, leaf_geo);
+      if (t < best_t)
+      {
+        best_t = t;
+        best_obj = shape;
+        best_geo = leaf_geo;
+      }
+    }
+
+    if (best_obj != nullptr)
+    {
+      obj = best_obj;
+      geo = best_geo;
+      return best_t;
+    }
+
+    return none_tag;
+  }
+
+  template <typename T>
+  int Tree<T>::count_leaves() const
+  {
+    return std::count_if(nodes.begin(), nodes.end(), [](const Node& n) { return n.is_leaf(); });
+  }
+
+  template <typename T>
+  size_t Tree<T>::memory_usage() const
+  {
+    return nodes.size() * sizeof(Node) + indices.size() * sizeof(obj_index) +
+      elements.size() * sizeof(element_type);
+  }
+}
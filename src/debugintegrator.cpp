@@ -59,25 +59,16 @@ spectrum DebugIntegrator::trace_ray(const Scene& scene, const Ray& ray,
     return spectrum{static_cast<scalar>(timer.since())};
   }
 
-  auto isect_opt = scene.intersect(ray);
-
   if (opt.type == DI_ISECT)
-    return spectrum{scalar(isect_opt.is() ? 1.0 : 0.0)};
+    return spectrum{scalar(scene.closest_hit(ray, sfp_none).is() ? 1.0 : 0.0)};
 
-  if (opt.type == DI_DEPTH)
-  {
-    if (isect_opt.is())
-      return spectrum(1.0 / max<scalar>((isect_opt.get().position - ray.position).norm(), 1.0));
-    else
-      return spectrum::zero;
-  }
   if (opt.type == DI_OBJECT_ID)
   {
-    if (!isect_opt.is())
+    auto hit = scene.closest_hit(ray, sfp_none);
+    if (!hit.is())
       return spectrum::zero;
-    
-    auto isect = isect_opt.get();
-    auto shape = isect.get_shape_for_id();
+
+    auto shape = hit.get().shape;
     {
       std::lock_guard<std::mutex> lg(color_mutex);
       if (color_map.find(shape) == color_map.end())
@@ -87,6 +78,15 @@ spectrum DebugIntegrator::trace_ray(const Scene& scene, const Ray& ray,
     return color_map[shape];
   }
 
+  auto isect_opt = scene.intersect(ray);
+
+  if (opt.type == DI_DEPTH)
+  {
+    if (isect_opt.is())
+      return spectrum(1.0 / max<scalar>((isect_opt.get().position - ray.position).norm(), 1.0));
+    else
+      return spectrum::zero;
+  }
   if (opt.type == DI_NORMAL)
   {
     return isect_opt.is() ? dir_to_spectrum(isect_opt.get().normal) : spectrum::zero;
@@ -117,7 +117,7 @@ spectrum DebugIntegrator::trace_ray(const Scene& scene, const Ray& ray,
 
     if (ms.prob > 0)
     {
-      return spectrum(scene.intersect(Ray{isect.position, ms.direction}.nudge()).is() ? 0.0 : 1.0);
+      return spectrum(scene.occluded(Ray{isect.position, ms.direction}.offset(isect.normal), sfp_none) ? 0.0 : 1.0);
     }
     return spectrum::zero;
   }
@@ -33,35 +33,23 @@ spectrum DirectLightingIntegrator::trace_ray(const Scene& scene, const Ray& ray,
   auto view_vector = -ray.direction.normal();
   const auto isect_normal = isect.normal;
 
-  // For now, simple integrations
-  auto lights = scene.lights();
-  int num_lights = lights.size();
-
   spectrum total(0.0);
 
   total += isect.emission();
 
-  int i = 0;
-  int cum_samples = 0;
-  int local_light_samples;
-
-  local_light_samples = options.lighting_samples;
-
-  for (auto light: lights)
+  for (auto s = 0u; s < options.lighting_samples; ++s)
   {
-    int new_cum_samples = (local_light_samples * (i + 1)) / num_lights;
-    int num_samples =  new_cum_samples - cum_samples;
-    cum_samples = new_cum_samples;
+    scalar light_prob;
+    const auto light = scene.sample_light(isect, shading_sampler.sample_1d(), light_prob);
+    if (light_prob <= 0)
+      continue;
 
-    for (int s = 0; s < num_samples; ++s)
-    {
-      auto se = light->sample_emission(isect, shading_sampler);
-      auto NL = std::max<scalar>(se.direction().dot(isect_normal), 0.0);
+    auto se = light->sample_emission(isect, shading_sampler);
+    auto NL = std::max<scalar>(se.direction().dot(isect_normal), 0.0);
 
-      if (NL > 0 && !se.is_occluded(scene))
-        total += (NL / se.p()) * se.emission() * isect.reflectance(se.direction(), view_vector);
-    }
-    ++i;
+    if (NL > 0 && !se.is_occluded(scene))
+      add_scaled_product(total, se.emission(), isect.reflectance(se.direction(), view_vector),
+                         NL / (light_prob * se.p()));
   }
 
   return total / options.lighting_samples;
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cmath>
+#include "vec3.h"
+
+/*
+ * Forward-mode automatic differentiation over a point: a Dual carries a value
+ * and its gradient with respect to the point, and every operation carries
+ * both through by the chain rule. A function written once over a template
+ * point type gives its value for a Vec3, and its value and gradient in the
+ * same pass for a DualVec3.
+ */
+class Dual
+{
+public:
+  Dual() : v(0), d(Vec3::zero) { }
+  explicit Dual(scalar v) : v(v), d(Vec3::zero) { }
+  Dual(scalar v, const Vec3& d) : v(v), d(d) { }
+
+  Dual operator -() const { return Dual(-v, -d); }
+
+  Dual& operator +=(const Dual& b) { v += b.v; d = d + b.d; return *this; }
+  Dual& operator -=(const Dual& b) { v -= b.v; d = d - b.d; return *this; }
+  Dual& operator *=(const Dual& b) { d = d * b.v + b.d * v; v *= b.v; return *this; }
+  Dual& operator /=(const Dual& b) { d = (d * b.v - b.d * v) / (b.v * b.v); v /= b.v; return *this; }
+
+  scalar v;
+  Vec3 d;
+};
+
+inline Dual operator +(Dual a, const Dual& b) { return a += b; }
+inline Dual operator -(Dual a, const Dual& b) { return a -= b; }
+inline Dual operator *(Dual a, const Dual& b) { return a *= b; }
+inline Dual operator /(Dual a, const Dual& b) { return a /= b; }
+
+inline Dual operator +(const Dual& a, scalar b) { return Dual(a.v + b, a.d); }
+inline Dual operator +(scalar a, const Dual& b) { return Dual(a + b.v, b.d); }
+inline Dual operator -(const Dual& a, scalar b) { return Dual(a.v - b, a.d); }
+inline Dual operator -(scalar a, const Dual& b) { return Dual(a - b.v, -b.d); }
+inline Dual operator *(const Dual& a, scalar b) { return Dual(a.v * b, a.d * b); }
+inline Dual operator *(scalar a, const Dual& b) { return Dual(a * b.v, b.d * a); }
+inline Dual operator /(const Dual& a, scalar b) { return Dual(a.v / b, a.d / b); }
+inline Dual operator /(scalar a, const Dual& b) { return Dual(a / b.v, b.d * (-a / (b.v * b.v))); }
+
+inline bool operator <(const Dual& a, const Dual& b) { return a.v < b.v; }
+inline bool operator >(const Dual& a, const Dual& b) { return a.v > b.v; }
+inline bool operator <(const Dual& a, scalar b) { return a.v < b; }
+inline bool operator >(const Dual& a, scalar b) { return a.v > b; }
+
+inline Dual sqrt(const Dual& a)
+{
+  const scalar s = std::sqrt(a.v);
+  return Dual(s, s > 0 ? a.d / (2 * s) : Vec3::zero);
+}
+
+inline Dual fabs(const Dual& a) { return a.v < 0 ? -a : a; }
+inline Dual abs(const Dual& a) { return fabs(a); }
+
+inline Dual pow(const Dual& a, scalar e)
+{
+  const scalar p = std::pow(a.v, e - 1);
+  return Dual(p * a.v, a.d * (e * p));
+}
+
+inline Dual sin(const Dual& a) { return Dual(std::sin(a.v), a.d * std::cos(a.v)); }
+inline Dual cos(const Dual& a) { return Dual(std::cos(a.v), a.d * -std::sin(a.v)); }
+inline Dual exp(const Dual& a) { const scalar e = std::exp(a.v); return Dual(e, a.d * e); }
+inline Dual log(const Dual& a) { return Dual(std::log(a.v), a.d / a.v); }
+inline Dual floor(const Dual& a) { return Dual(std::floor(a.v)); }
+
+inline Dual atan2(const Dual& y, const Dual& x)
+{
+  const scalar r2 = x.v * x.v + y.v * y.v;
+  return Dual(std::atan2(y.v, x.v), (y.d * x.v - x.d * y.v) / r2);
+}
+
+inline Dual min(const Dual& a, const Dual& b) { return b.v < a.v ? b : a; }
+inline Dual max(const Dual& a, const Dual& b) { return a.v < b.v ? b : a; }
+inline Dual min(const Dual& a, scalar b) { return min(a, Dual(b)); }
+inline Dual max(const Dual& a, scalar b) { return max(a, Dual(b)); }
+inline Dual min(scalar a, const Dual& b) { return min(Dual(a), b); }
+inline Dual max(scalar a, const Dual& b) { return max(Dual(a), b); }
+
+inline Dual clamp(const Dual& x, scalar lo, scalar hi) { return min(max(x, lo), hi); }
+
+/*
+ * A point of duals. variable(p) is the point p itself, whose coordinates
+ * have the axes as their gradients.
+ */
+class DualVec3
+{
+public:
+  DualVec3() { }
+  DualVec3(const Dual& x, const Dual& y, const Dual& z) : x(x), y(y), z(z) { }
+  explicit DualVec3(const Vec3& p) : x(p.x), y(p.y), z(p.z) { }
+
+  static DualVec3 variable(const Vec3& p)
+  {
+    return DualVec3(Dual(p.x, Vec3::x_axis), Dual(p.y, Vec3::y_axis), Dual(p.z, Vec3::z_axis));
+  }
+
+  Vec3 value() const { return Vec3(x.v, y.v, z.v); }
+
+  DualVec3 operator -() const { return DualVec3(-x, -y, -z); }
+  DualVec3 operator +(const DualVec3& b) const { return DualVec3(x + b.x, y + b.y, z + b.z); }
+  DualVec3 operator -(const DualVec3& b) const { return DualVec3(x - b.x, y - b.y, z - b.z); }
+  DualVec3 operator *(const Dual& s) const { return DualVec3(x * s, y * s, z * s); }
+  DualVec3 operator /(const Dual& s) const { return DualVec3(x / s, y / s, z / s); }
+
+  Dual dot(const DualVec3& b) const { return x * b.x + y * b.y + z * b.z; }
+  Dual norm2() const { return dot(*this); }
+  Dual norm() const { return sqrt(norm2()); }
+
+  DualVec3 abs() const { return DualVec3(fabs(x), fabs(y), fabs(z)); }
+  Dual min() const { return ::min(x, ::min(y, z)); }
+  Dual max() const { return ::max(x, ::max(y, z)); }
+
+  Dual x, y, z;
+};
+
+inline DualVec3 min(const DualVec3& a, const DualVec3& b)
+{
+  return DualVec3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z));
+}
+
+inline DualVec3 max(const DualVec3& a, const DualVec3& b)
+{
+  return DualVec3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
+}
@@ -8,35 +8,86 @@ spectrum EnvironmentLight::emission(const Vec3& dir) const
 {
   return texture->at_coord(to_euler_uv(dir));
 }
-EnvironmentLight::EnvironmentLight(const Texture2D* tex) :
+EnvironmentLight::EnvironmentLight(const Texture2D* tex, uint width, uint height) :
+  EnvironmentLight(tex, *tex, width, height)
+{
+}
+
+EnvironmentLight::EnvironmentLight(const Texture2D* tex, const Texture2D& lookup,
+                                   uint width, uint height) :
   texture(tex)
 {
   assert(tex != nullptr);
+
+  // Average a 2x2 grid of lookups per cell, so that features smaller than a
+  // cell are still likely to be seen.
+  vector<scalar> weights(width * height);
+  scalar total = 0;
+  for (auto j = 0u; j < height; ++j)
+  {
+    const scalar sin_phi = sin(PI * (j + 0.5) / height);
+    for (auto i = 0u; i < width; ++i)
+    {
+      scalar lum = 0;
+      for (auto k = 0u; k < 4; ++k)
+      {
+        const Vec2 uv((i + 0.25 + 0.5 * (k % 2)) / width, (j + 0.25 + 0.5 * (k / 2)) / height);
+        lum += lookup.at_coord(uv).luminance();
+      }
+      weights[j * width + i] = lum / 4 * sin_phi;
+      total += weights[j * width + i];
+    }
+  }
+
+  // Keep a little density everywhere, for whatever the grid missed, and for
+  // textures that are black.
+  const scalar floor = total > 0 ? 0.001 * total / (width * height) : 1;
+  for (auto& w : weights)
+    w += floor;
+
+  distribution = Distribution2D(weights, width, height);
 }
 
-LightSample EnvironmentLight::sample_emission(const Intersection& isect, Sampler& sampler) const
+Vec3 EnvironmentLight::sample_direction(const Sample2D& s, scalar& p) const
 {
-  // cosine-weighted sample on the normal direction
-  scalar p;
-  auto local_d = cosine_weighted_hemisphere_sample(sampler.sample_2d(), p);
+  scalar p_uv;
+  const auto uv = distribution.sample(s, p_uv);
 
-  auto d = local_d.rotateMatch(Vec3::z_axis, isect.normal);
+  // (u, v) covers 2 pi by pi radians, with solid angle sin(phi) dtheta dphi
+  const scalar sin_phi = sin(uv.v * PI);
+  p = sin_phi > 0 ? p_uv / (2 * PI * PI * sin_phi) : 0;
+  return from_euler_uv(uv);
+}
+
+scalar EnvironmentLight::pdf(const Vec3& dir) const
+{
+  const auto uv = to_euler_uv(dir);
+  const scalar sin_phi = sin(uv.v * PI);
+  return sin_phi > 0 ? distribution.pdf(uv) / (2 * PI * PI * sin_phi) : 0;
+}
 
-  auto emit = emission(d);
+LightSample EnvironmentLight::sample_emission(const Intersection& isect, Sampler& sampler) const
+{
+  scalar p;
+  const auto d = sample_direction(sampler.sample_2d(), p);
+  if (p == 0)
+    return LightSample();
 
-  return LightSample(emit, p, Ray{isect.position, d}.nudge(0.0005));
+  return LightSample(emission(d), p, Ray{isect.position, d}.offset(isect.normal));
 }
 
 EmissionSample EnvironmentLight::sample_emission(const Scene& scene, Sampler& sampler) const
 {
-  auto d = uniform_sphere_sample(sampler.sample_2d());
+  scalar p;
+  const auto d = sample_direction(sampler.sample_2d(), p);
 
-  return EmissionSample(this, Ray{d*1000, -d}, 1 / (4.0 * PI));
+  return EmissionSample(this, Ray{d*1000, -d}, p);
 }
 
 spectrum EnvironmentLight::emission(const Scene& scene, const IntersectionView& isect,
                                     const EmissionSample& e_sample) const
 {
-  auto shadow_isect = scene.intersect(Ray{isect.position, e_sample.ray.direction}.nudge(SHADOW_EPSILON));
-  return shadow_isect.is() ? spectrum::zero : emission(-e_sample.ray.direction);
+  const bool occluded = scene.occluded(Ray{isect.position, e_sample.ray.direction}.offset(isect.normal),
+                                       sfp_none);
+  return occluded ? spectrum::zero : emission(-e_sample.ray.direction);
 }
@@ -5,15 +5,38 @@
 #include "vec3.h"
 #include "texture.h"
 #include "light.h"
+#include "sampler.h"
 
 using std::shared_ptr;
 
+/*
+ * Light from infinitely far away in every direction, looked up in a texture
+ * over the (u, v) of to_euler_uv.
+ *
+ * The texture is baked once into a grid of luminances, weighted by the solid
+ * angle of each cell, and directions are sampled from that grid, so a small
+ * bright sun gets the samples it needs.
+ */
 class EnvironmentLight : public Light
 {
 public:
-  EnvironmentLight(const Texture2D* tex);
+  EnvironmentLight(const Texture2D* tex, uint width = 256, uint height = 128);
+
+  /*
+   * The grid is baked from lookup, which must give the same values as tex,
+   * for textures that can't be evaluated where the light is made, such as
+   * script textures while the scene is loading.
+   */
+  EnvironmentLight(const Texture2D* tex, const Texture2D& lookup,
+                   uint width = 256, uint height = 128);
 
   spectrum emission(const Vec3& dir) const;
+
+  /*
+   * The density, over solid angle, of sampling the direction dir.
+   */
+  scalar pdf(const Vec3& dir) const;
+
   LightSample sample_emission(const Intersection&, Sampler&) const override;
   EmissionSample sample_emission(const Scene& scene, Sampler&) const override;
 
@@ -21,4 +44,10 @@ public:
                     const EmissionSample& sample) const override;
 
   const Texture2D* texture;
+
+private:
+  // a direction from the distribution, with its density over solid angle
+  Vec3 sample_direction(const Sample2D& s, scalar& p) const;
+
+  Distribution2D distribution;
 };
@@ -76,9 +76,25 @@ void Film::merge(const Film& f)
             plate.begin(), [](auto& x, const auto& y) { return x + y; });
 }
 
+void Film::merge(const Film& tile, const Rect& rect)
+{
+  assert(tile.width == rect.width);
+  assert(tile.height == rect.height);
+  assert(rect.x + rect.width <= width);
+  assert(rect.y + rect.height <= height);
+
+  for (auto y = 0u; y < rect.height; ++y)
+  {
+    auto row = plate.begin() + index(rect.x, rect.y + y);
+    auto tile_row = tile.plate.begin() + tile.index(0, y);
+    transform(tile_row, tile_row + rect.width, row, row,
+              [](const auto& tp, const auto& p) { return p + tp; });
+  }
+}
+
 scalar Film::average_intensity() const
 {
-  scalar r = 0, w = 0;
+  double r = 0, w = 0;
   for (const auto& p: plate)
   {
     w += p.weight;
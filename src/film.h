@@ -95,6 +95,9 @@ public:
   Film(istream& in);
 
   Film(const Film& f);
+  Film(Film&& f) = default;
+  Film& operator =(const Film& f) = default;
+  Film& operator =(Film&& f) = default;
 
   Array2D<uint> samples_by_variance(uint spp) const;
 
@@ -115,6 +118,12 @@ public:
   
   void merge(const Film& other);
 
+  /**
+   * Add a tile film, covering rect of this film, into this film. The tile
+   * must be exactly rect.width x rect.height.
+   */
+  void merge(const Film& tile, const Rect& rect);
+
   AccPixel at(int x, int y) const
   {
     return plate[index(x, y)];
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vec3.h"
+
+/*
+ * An orthonormal basis (s, t, n) around a unit normal n. Directions are moved
+ * into the local shading space, where n is the z-axis, and back.
+ *
+ * The tangents come from the branchless construction of Duff et al.,
+ * "Building an Orthonormal Basis, Revisited" (JCGT 2017), which is much
+ * cheaper than building a rotation matrix. The tangent directions differ
+ * from Mat33::rotate_to_z, which only matters to anisotropic materials.
+ */
+class Frame
+{
+public:
+  explicit Frame(const Vec3& normal) : n(normal)
+  {
+    const scalar sign = std::copysign(scalar(1.0), n.z);
+    const scalar a = -1 / (sign + n.z);
+    const scalar b = n.x * n.y * a;
+    s = Vec3{1 + sign * n.x * n.x * a, sign * b, -sign * n.x};
+    t = Vec3{b, sign + n.y * n.y * a, -n.y};
+  }
+
+  Vec3 to_local(const Vec3& v) const
+  {
+    return Vec3{v.dot(s), v.dot(t), v.dot(n)};
+  }
+
+  Vec3 to_world(const Vec3& v) const
+  {
+    return s * v.x + t * v.y + n * v.z;
+  }
+
+  Vec3 s, t, n;
+};
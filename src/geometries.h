@@ -9,3 +9,4 @@
 #include "geometry/implicit.h"
 #include "geometry/box.h"
 #include "geometry/geometry_util.h"
+#include "geometry/heightfield.h"
@@ -21,6 +21,16 @@ class Geometry : public Base
 public:
   virtual scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) const = 0;
 
+  /*
+   * True if the ray hits the geometry before max_t. Aggregates override this
+   * to stop at the first hit rather than the closest.
+   */
+  virtual bool occluded(const Ray& r, scalar_fp max_t) const
+  {
+    SubGeo geom;
+    return intersect(r, max_t, geom).is();
+  }
+
   virtual Vec3 normal(SubGeo sub_geo, const Vec3& point) const = 0;
 
   virtual bool is_differential() const { return false; }
@@ -0,0 +1,133 @@
+#include "geometry/distance_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+  // how many points to evaluate per call while building
+  const uint EVAL_BATCH = 256;
+
+  // Round toward zero, so that stored bounds never exceed the true ones.
+  float lower_float(scalar v)
+  {
+    float f = v;
+    return f > v ? std::nextafter(f, 0.0f) : f;
+  }
+}
+
+DistanceCache::DistanceCache(const EvalFunc& eval, scalar lipschitz, const bounds::AABB& box_,
+                             uint resolution, size_t max_bytes)
+  : box(box_), res(std::max(resolution, 1u))
+{
+  // The coarsest grid is a single brick along the longest side, which is
+  // kept whatever it takes.
+  while (!build(eval, lipschitz, res > BRICK ? max_bytes : std::numeric_limits<size_t>::max()))
+    res /= 2;
+}
+
+Vec3 DistanceCache::brick_center(uint bx, uint by, uint bz) const
+{
+  return box.min() + Vec3(bx + 0.5, by + 0.5, bz + 0.5) * (BRICK * h);
+}
+
+bool DistanceCache::build(const EvalFunc& eval, scalar lipschitz, size_t max_bytes)
+{
+  const Vec3 size = box.size();
+  h = size.max() / res;
+  for (int a = 0; a < 3; ++a)
+  {
+    const uint n_cells = std::max<scalar>(1, std::ceil(size[a] / h));
+    dims[a] = (n_cells + BRICK - 1) / BRICK;
+  }
+
+  const scalar inv_l = 1 / lipschitz;
+  const uint n_bricks = dims[0] * dims[1] * dims[2];
+
+  // the bounds at brick centers
+  vector<Vec3> points;
+  points.reserve(n_bricks);
+  for (auto bz = 0u; bz < dims[2]; ++bz)
+    for (auto by = 0u; by < dims[1]; ++by)
+      for (auto bx = 0u; bx < dims[0]; ++bx)
+        points.push_back(brick_center(bx, by, bz));
+
+  vector<scalar> values(points.size());
+  for (auto i = 0u; i < points.size(); i += EVAL_BATCH)
+    eval(&points[i], &values[i], std::min<uint>(EVAL_BATCH, points.size() - i));
+
+  // Bricks whose center is further from the surface than their corners
+  // can't contain it, and their center bound is all they need.
+  const scalar brick_radius = 0.5 * sqrt(3.0) * BRICK * h;
+  bricks.assign(n_bricks, Brick{0, -1});
+  uint n_near = 0;
+  for (auto i = 0u; i < n_bricks; ++i)
+  {
+    bricks[i].center_bound = lower_float(fabs(values[i]) * inv_l);
+    if (bricks[i].center_bound < brick_radius)
+      ++n_near;
+  }
+
+  const uint cells_per_brick = BRICK * BRICK * BRICK;
+  if (size_t(n_near) * cells_per_brick * sizeof(float) > max_bytes)
+    return false;
+
+  cells.clear();
+  cells.reserve(n_near * cells_per_brick);
+  points.resize(cells_per_brick);
+  values.resize(cells_per_brick);
+  for (auto bz = 0u; bz < dims[2]; ++bz)
+  {
+    for (auto by = 0u; by < dims[1]; ++by)
+    {
+      for (auto bx = 0u; bx < dims[0]; ++bx)
+      {
+        auto& brick = bricks[(bz * dims[1] + by) * dims[0] + bx];
+        if (brick.center_bound >= brick_radius)
+          continue;
+
+        const Vec3 corner = box.min() + Vec3{scalar(bx), scalar(by), scalar(bz)} * (BRICK * h);
+        for (auto z = 0u, k = 0u; z < BRICK; ++z)
+          for (auto y = 0u; y < BRICK; ++y)
+            for (auto x = 0u; x < BRICK; ++x, ++k)
+              points[k] = corner + Vec3(x + 0.5, y + 0.5, z + 0.5) * h;
+
+        for (auto i = 0u; i < cells_per_brick; i += EVAL_BATCH)
+          eval(&points[i], &values[i], std::min(EVAL_BATCH, cells_per_brick - i));
+
+        brick.cells = cells.size();
+        for (auto v : values)
+          cells.push_back(lower_float(fabs(v) * inv_l));
+      }
+    }
+  }
+
+  return true;
+}
+
+scalar DistanceCache::bound(const Vec3& p) const
+{
+  // The surface lies in the box, so it's at least as far as the box.
+  const Vec3 outside = max(max(box.min() - p, p - box.max()), Vec3::zero);
+  if (outside.x > 0 || outside.y > 0 || outside.z > 0)
+    return outside.norm();
+
+  uint c[3];
+  for (int a = 0; a < 3; ++a)
+    c[a] = std::min<scalar>((p[a] - box.min()[a]) / h, dims[a] * BRICK - 1);
+
+  const uint bx = c[0] / BRICK, by = c[1] / BRICK, bz = c[2] / BRICK;
+  const auto& brick = bricks[(bz * dims[1] + by) * dims[0] + bx];
+  if (brick.cells < 0)
+    return std::max<scalar>(0, brick.center_bound - (p - brick_center(bx, by, bz)).norm());
+
+  const uint x = c[0] % BRICK, y = c[1] % BRICK, z = c[2] % BRICK;
+  const Vec3 center = box.min() + Vec3(c[0] + 0.5, c[1] + 0.5, c[2] + 0.5) * h;
+  const float value = cells[brick.cells + (z * BRICK + y) * BRICK + x];
+  return std::max<scalar>(0, value - (p - center).norm());
+}
+
+size_t DistanceCache::memory() const
+{
+  return bricks.size() * sizeof(Brick) + cells.size() * sizeof(float);
+}
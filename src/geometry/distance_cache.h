@@ -0,0 +1,68 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "bounds.h"
+
+using std::vector;
+
+/*
+ * Lower bounds on the distance to an implicit surface, sampled once over its
+ * bounding box, so that sphere tracing can cross empty space without
+ * evaluating the function.
+ *
+ * The box is split into bricks of BRICK^3 cells. Each brick keeps the
+ * distance bound at its center; bricks near the surface also keep one at
+ * each cell center. A point's bound is the nearest sample's, less the
+ * distance to it. Cells are only kept while they fit within max_bytes,
+ * halving the resolution until they do.
+ */
+class DistanceCache
+{
+public:
+  using EvalFunc = std::function<void(const Vec3* points, scalar* values, uint n)>;
+
+  /*
+   * eval gives the function at n points at once, and lipschitz bounds its
+   * rate of change, so that the distance is at least |f| / lipschitz. The
+   * resolution is in cells along the longest side of the box.
+   */
+  DistanceCache(const EvalFunc& eval, scalar lipschitz, const bounds::AABB& box,
+                uint resolution, size_t max_bytes);
+
+  /*
+   * A lower bound on the distance from p to the surface, which is assumed to
+   * lie inside the box.
+   */
+  scalar bound(const Vec3& p) const;
+
+  // the side of a cell, below which bounds are too coarse to help
+  scalar cell_size() const { return h; }
+
+  uint resolution() const { return res; }
+  size_t memory() const;
+
+  static const uint BRICK = 8;
+
+private:
+  struct Brick
+  {
+    float center_bound;
+
+    // index of the brick's first cell, or -1 if it keeps none
+    int32_t cells;
+  };
+
+  // false if the cells would take more than max_bytes
+  bool build(const EvalFunc& eval, scalar lipschitz, size_t max_bytes);
+
+  Vec3 brick_center(uint bx, uint by, uint bz) const;
+
+  bounds::AABB box;
+  uint res;
+  scalar h;
+  uint dims[3];
+
+  vector<Brick> bricks;
+  vector<float> cells;
+};
@@ -2,15 +2,15 @@
 #include "mesh.h"
 #include "kdmesh.h"
 
-unique_ptr<Geometry> mesh_from_model(RawModel&& model)
+unique_ptr<Geometry> mesh_from_model(RawModel&& model, AccelType accel = AccelType::KD_TREE)
 {
   if (model.tris().size() < 12)
     return make_unique<Mesh>(model);
   else
-    return make_unique<KDMesh>(model);
+    return make_unique<KDMesh>(model, accel);
 }
 
-unique_ptr<Geometry> load_mesh(const std::string& s)
+unique_ptr<Geometry> load_mesh(const std::string& s, AccelType accel)
 {
   RawModel model;
   auto status =  model.load(s);
@@ -18,10 +18,10 @@ unique_ptr<Geometry> load_mesh(const std::string& s)
   if (!status.success)
     return nullptr;
 
-  return mesh_from_model(std::move(model));
+  return mesh_from_model(std::move(model), accel);
 }
 
-unique_ptr<Geometry> load_mesh(const std::string& s, const bounds::AABB& box)
+unique_ptr<Geometry> load_mesh(const std::string& s, const bounds::AABB& box, AccelType accel)
 {
   RawModel model;
   auto status =  model.load(s);
@@ -31,7 +31,7 @@ unique_ptr<Geometry> load_mesh(const std::string& s, const bounds::AABB& box)
 
   model.rescale(box);
 
-  return mesh_from_model(std::move(model));
+  return mesh_from_model(std::move(model), accel);
 }
 
 vector<Vec2> mesh_eval_points(Vec2 xz_min, Vec2 xz_max,
@@ -4,6 +4,7 @@
 #include <vector>
 #include "bounds.h"
 #include "geometry.h"
+#include "accel.h"
 #include "vec2.h"
 
 using std::unique_ptr;
@@ -15,13 +16,15 @@ using std::vector;
  * This function will automatically decide between a mesh and a kd-mesh,
  * returning whatever is appropriate for its size.
  */
-unique_ptr<Geometry> load_mesh(const std::string& filename);
+unique_ptr<Geometry> load_mesh(const std::string& filename,
+                               AccelType accel = AccelType::KD_TREE);
 
 
 /**
  * Same as above, but also rescales the mesh in advance.
  */
-unique_ptr<Geometry> load_mesh(const std::string& s, const bounds::AABB&);
+unique_ptr<Geometry> load_mesh(const std::string& s, const bounds::AABB&,
+                               AccelType accel = AccelType::KD_TREE);
 
 
 /**
@@ -47,7 +50,8 @@ unique_ptr<Geometry> parametric_mesh(const Vec3* points,
 /**
  * Generate a mesh from a heightmap. The heights are given as a 1d-array of
  * (xd + 1) * (yd + 1) values. The first values is at (x_min, y_min), and the
- * second value is at (x_min + dx, y_min).
+ * second value is at (x_min + dx, y_min). Heightfield traces the same
+ * triangles from the heights alone.
  */
 unique_ptr<Geometry> heightfield_mesh(const scalar* heights,
                                       Vec2 xz_min, Vec2 xz_max,
@@ -0,0 +1,271 @@
+#include "geometry/heightfield.h"
+#include <algorithm>
+#include "geometry/geometry_util.h"
+
+namespace
+{
+  // one level per bit of the grid's size, and the root
+  const uint MAX_LEVELS = 33;
+
+  // Nodes are tested against heights this fraction of the field's size
+  // beyond their own, so that rounding in the ray's heights never skips the
+  // cell holding a hit on its edge.
+  const scalar RANGE_MARGIN = 1e-4;
+
+  // how far, in cells, a hit may lie outside its triangle
+  const scalar CELL_EPSILON = 1e-6;
+}
+
+Heightfield::Heightfield(vector<scalar> heights_, Vec2 xz_min, Vec2 xz_max,
+                         uint xd, uint zd)
+  : heights(std::move(heights_)), xz_min(xz_min), xz_max(xz_max), xd(xd), zd(zd),
+    dx((xz_max[0] - xz_min[0]) / xd), dz((xz_max[1] - xz_min[1]) / zd)
+{
+  assert(heights.size() == size_t(xd + 1) * (zd + 1));
+  build();
+}
+
+Heightfield::Heightfield(std::function<scalar(scalar, scalar)> height_func,
+                         Vec2 xz_min, Vec2 xz_max, uint xd, uint zd)
+  : xz_min(xz_min), xz_max(xz_max), xd(xd), zd(zd),
+    dx((xz_max[0] - xz_min[0]) / xd), dz((xz_max[1] - xz_min[1]) / zd)
+{
+  auto eval_points = mesh_eval_points(xz_min, xz_max, xd, zd);
+  heights.resize(eval_points.size());
+
+  std::transform(eval_points.begin(), eval_points.end(), heights.begin(),
+                 [&](const Vec2& v) { return height_func(v[0], v[1]); });
+
+  build();
+}
+
+void Heightfield::build()
+{
+  levels.push_back(Level{xd, zd, 0});
+
+  while (levels.back().width > 1 || levels.back().depth > 1)
+  {
+    const auto below = levels.size() - 1;
+    const auto& prev = levels.back();
+    const Level level{(prev.width + 1) / 2, (prev.depth + 1) / 2, ranges.size()};
+
+    for (auto z = 0u; z < level.depth; ++z)
+    {
+      for (auto x = 0u; x < level.width; ++x)
+      {
+        Range r = range(below, 2 * x, 2 * z);
+        for (auto child = 1u; child < 4; ++child)
+        {
+          const auto cx = 2 * x + child % 2, cz = 2 * z + child / 2;
+          if (cx >= levels[below].width || cz >= levels[below].depth)
+            continue;
+
+          const auto cr = range(below, cx, cz);
+          r.lo = std::min(r.lo, cr.lo);
+          r.hi = std::max(r.hi, cr.hi);
+        }
+        ranges.push_back(r);
+      }
+    }
+
+    levels.push_back(level);
+  }
+  assert(levels.size() <= MAX_LEVELS);
+
+  const auto root = range(levels.size() - 1, 0, 0);
+  bbox = bounds::AABB(Vec3(xz_min[0], root.lo, xz_min[1]),
+                      Vec3(xz_max[0], root.hi, xz_max[1]));
+
+  // Rays are clipped to the box with the margin too, as a flat field's box
+  // has no height for them to pass through.
+  margin = RANGE_MARGIN * (root.hi - root.lo + dx + dz);
+  clip_box = bounds::AABB(bbox.min() - Vec3(0, margin, 0), bbox.max() + Vec3(0, margin, 0));
+}
+
+Heightfield::Range Heightfield::range(uint level, uint x, uint z) const
+{
+  if (level > 0)
+    return ranges[levels[level].offset + z * levels[level].width + x];
+
+  const scalar h[4] = {height(x, z), height(x + 1, z), height(x, z + 1), height(x + 1, z + 1)};
+  return Range{*std::min_element(h, h + 4), *std::max_element(h, h + 4)};
+}
+
+Vec3 Heightfield::corner(uint x, uint z) const
+{
+  return Vec3(xz_min[0] + x * dx, height(x, z), xz_min[1] + z * dz);
+}
+
+scalar_fp Heightfield::intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) const
+{
+  scalar t0, t1;
+  if (!clip_box.intersect(r, t0, t1))
+    return sfp_none;
+
+  if (max_t < t0 || t1 < 0)
+    return sfp_none;
+
+  t0 = std::max(t0, scalar(0));
+  if (max_t.is())
+    t1 = std::min(max_t.get(), t1);
+
+  const GridRay g{(r.position.x - xz_min[0]) / dx, (r.position.z - xz_min[1]) / dz,
+                  r.direction.x / dx, r.direction.z / dz};
+
+  struct Entry
+  {
+    uint level, x, z;
+    scalar t0, t1;
+  };
+  Entry stack[3 * MAX_LEVELS + 1];
+  int top = 0;
+  stack[top++] = Entry{uint(levels.size() - 1), 0, 0, t0, t1};
+
+  while (top > 0)
+  {
+    const auto e = stack[--top];
+
+    // Skip nodes whose heights the ray passes wholly above or below.
+    const scalar ya = r.position.y + r.direction.y * e.t0;
+    const scalar yb = r.position.y + r.direction.y * e.t1;
+    const auto rg = range(e.level, e.x, e.z);
+    if (std::min(ya, yb) > rg.hi + margin || std::max(ya, yb) < rg.lo - margin)
+      continue;
+
+    if (e.level == 0)
+    {
+      // Nodes come front to back, so the first hit is the nearest.
+      auto t = intersect_cell(r, g, max_t, e.x, e.z, geom);
+      if (t.is())
+        return t;
+      continue;
+    }
+
+    // Step across the four children, crossing the node's two middle lines
+    // in the order the ray does.
+    const uint half = 1u << (e.level - 1);
+    const scalar mx = (2 * e.x + 1) * half, mz = (2 * e.z + 1) * half;
+    const scalar tx = g.gx != 0 ? (mx - g.ox) / g.gx : SCALAR_MAX;
+    const scalar tz = g.gz != 0 ? (mz - g.oz) / g.gz : SCALAR_MAX;
+
+    // the side of each middle line the ray is on at t0
+    uint sx = g.gx > 0 ? tx <= e.t0 : (g.gx < 0 ? tx > e.t0 : g.ox >= mx);
+    uint sz = g.gz > 0 ? tz <= e.t0 : (g.gz < 0 ? tz > e.t0 : g.oz >= mz);
+
+    struct Crossing
+    {
+      scalar t;
+      bool x_axis;
+    };
+    Crossing crossings[2];
+    int num_crossings = 0;
+    if (e.t0 < tx && tx < e.t1)
+      crossings[num_crossings++] = Crossing{tx, true};
+    if (e.t0 < tz && tz < e.t1)
+      crossings[num_crossings++] = Crossing{tz, false};
+    if (num_crossings == 2 && crossings[1].t < crossings[0].t)
+      std::swap(crossings[0], crossings[1]);
+
+    Entry children[3];
+    int num_children = 0;
+    scalar t = e.t0;
+    for (int i = 0; i <= num_crossings; ++i)
+    {
+      const scalar t_next = i < num_crossings ? crossings[i].t : e.t1;
+      const uint cx = 2 * e.x + sx, cz = 2 * e.z + sz;
+      if (cx < levels[e.level - 1].width && cz < levels[e.level - 1].depth)
+        children[num_children++] = Entry{e.level - 1, cx, cz, t, t_next};
+
+      if (i < num_crossings)
+      {
+        if (crossings[i].x_axis)
+          sx ^= 1;
+        else
+          sz ^= 1;
+      }
+      t = t_next;
+    }
+
+    assert(top + num_children <= int(3 * MAX_LEVELS + 1));
+    while (num_children > 0)
+      stack[top++] = children[--num_children];
+  }
+
+  return sfp_none;
+}
+
+/*
+ * The cell's triangles are tested in its own coordinates, where it is the
+ * unit square, rather than with ray_triangle_intersection: that rejects
+ * triangles whose determinant is below an absolute threshold, which a fine
+ * enough grid's all are. Over the square, each triangle's height is linear
+ * in u and w, so the hit is where the ray's height meets it.
+ */
+scalar_fp Heightfield::intersect_cell(const Ray& r, const GridRay& g, scalar_fp max_t,
+                                      uint x, uint z, SubGeo& geom) const
+{
+  const scalar h00 = height(x, z), h10 = height(x + 1, z);
+  const scalar h01 = height(x, z + 1), h11 = height(x + 1, z + 1);
+  const scalar ou = g.ox - x, ow = g.oz - z;
+
+  // the near triangle, u + w <= 1, rises by a along u and b along w from
+  // h00; the far one falls by a and b from h11 going back along them
+  const scalar a[2] = {h10 - h00, h11 - h01};
+  const scalar b[2] = {h01 - h00, h11 - h10};
+  const scalar base[2] = {h00 + a[0] * ou + b[0] * ow,
+                          h11 + a[1] * (ou - 1) + b[1] * (ow - 1)};
+
+  scalar_fp best = max_t;
+  int hit = -1;
+  for (int i = 0; i < 2; ++i)
+  {
+    const scalar denom = r.direction.y - a[i] * g.gx - b[i] * g.gz;
+    if (denom == 0)
+      continue;
+
+    const scalar t = (base[i] - r.position.y) / denom;
+    if (t < EPSILON || best < t)
+      continue;
+
+    const scalar u = ou + g.gx * t, w = ow + g.gz * t;
+    if (u < -CELL_EPSILON || u > 1 + CELL_EPSILON || w < -CELL_EPSILON || w > 1 + CELL_EPSILON)
+      continue;
+    if (i == 0 ? u + w > 1 + CELL_EPSILON : u + w < 1 - CELL_EPSILON)
+      continue;
+
+    best = scalar_fp{t};
+    hit = i;
+  }
+
+  if (hit < 0)
+    return sfp_none;
+
+  geom = 2 * (SubGeo(z) * xd + x) + hit;
+  return best;
+}
+
+Vec3 Heightfield::normal(SubGeo geom, const Vec3& UNUSED(point)) const
+{
+  const uint x = (geom / 2) % xd, z = (geom / 2) / xd;
+  const auto p10 = corner(x + 1, z), p01 = corner(x, z + 1);
+
+  // the same winding as the triangles of heightfield_mesh, facing up
+  if (geom % 2)
+    return (p01 - p10).cross(corner(x + 1, z + 1) - p10).normal();
+
+  const auto p00 = corner(x, z);
+  return (p01 - p00).cross(p10 - p00).normal();
+}
+
+void Heightfield::texture_coord(SubGeo UNUSED(geom), const Vec3& pos, const Vec3& UNUSED(normal),
+                                scalar& u, scalar& v) const
+{
+  u = (pos.x - xz_min[0]) / (xz_max[0] - xz_min[0]);
+  v = (pos.z - xz_min[1]) / (xz_max[1] - xz_min[1]);
+}
+
+size_t Heightfield::memory_usage() const
+{
+  return heights.size() * sizeof(scalar) + ranges.size() * sizeof(Range) +
+    levels.size() * sizeof(Level);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "geometry.h"
+#include "vec2.h"
+
+using std::vector;
+
+/*
+ * A heightfield over a grid of xd by zd cells in the xz-plane, given by the
+ * heights at its (xd + 1) * (zd + 1) corners, in the order of
+ * mesh_eval_points. Each cell is split into the same two triangles as
+ * heightfield_mesh makes of it, but these are only built within the cells a
+ * ray reaches.
+ *
+ * Above the cells is a quadtree of the least and greatest heights under each
+ * node, one level per halving of the grid. A ray walks down it front to
+ * back, stepping across each node's four children in the order it crosses
+ * them (a two-level DDA), and skips any node whose heights lie wholly above
+ * or below the ray's heights across it. Besides the heights, this stores
+ * about two-thirds of a height pair per cell.
+ */
+class Heightfield : public Geometry
+{
+public:
+  Heightfield(vector<scalar> heights, Vec2 xz_min, Vec2 xz_max, uint xd, uint zd);
+
+  Heightfield(std::function<scalar(scalar, scalar)> height_func,
+              Vec2 xz_min, Vec2 xz_max, uint xd, uint zd);
+
+  // SubGeo is the cell's index times two, plus one for the far triangle.
+  scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) const override;
+
+  Vec3 normal(SubGeo geom, const Vec3& point) const override;
+
+  bool is_differential() const override { return true; }
+
+  // the position over the grid, as with heightfield_mesh
+  void texture_coord(SubGeo geom, const Vec3& pos, const Vec3& normal,
+                     scalar& u, scalar& v) const override;
+
+  bool is_bounded() const override { return true; }
+
+  bounds::AABB get_bounding_box() const override { return bbox; }
+
+  // bytes used by the heights and the quadtree
+  size_t memory_usage() const;
+
+  string to_string() const override { return "Heightfield"; }
+
+private:
+  struct Range
+  {
+    scalar lo, hi;
+  };
+
+  scalar height(uint x, uint z) const { return heights[z * (xd + 1) + x]; }
+
+  Vec3 corner(uint x, uint z) const;
+
+  // the range of the node at (x, z) of the given level, cells being level 0
+  Range range(uint level, uint x, uint z) const;
+
+  // a ray's position and direction over the grid, where cells are unit
+  // squares; t is the same as along the ray
+  struct GridRay
+  {
+    scalar ox, oz;
+    scalar gx, gz;
+  };
+
+  // the nearer of the cell's two triangles hit before max_t
+  scalar_fp intersect_cell(const Ray& r, const GridRay& g, scalar_fp max_t,
+                           uint x, uint z, SubGeo& geom) const;
+
+  void build();
+
+  vector<scalar> heights;
+  Vec2 xz_min, xz_max;
+  uint xd, zd;
+  scalar dx, dz;
+
+  // the ranges of levels 1 and up, each level's nodes row by row; level
+  // 0's come from the cells' corners
+  struct Level
+  {
+    uint width, depth;
+    size_t offset;
+  };
+  vector<Level> levels;
+  vector<Range> ranges;
+
+  bounds::AABB bbox, clip_box;
+  scalar margin;
+};
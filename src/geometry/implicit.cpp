@@ -1,29 +1,117 @@
 #include "implicit.h"
+#include "distance_cache.h"
 #include "math_util.h"
 #include "transformed.h"
 #include "util/manager.h"
 #include <memory>
+#include <mutex>
 
 static const scalar MIN_STEP = 0.0001;
 
+// over every surface, for implicit_evaluations_per_ray
+static std::atomic_ullong all_rays_traced(0), all_evaluations(0);
+
+// Counting is off by default: the shared counters are contended with many
+// threads tracing the same surface.
+static std::atomic_bool counting(false);
+
 using std::make_shared;
 
+struct ImplicitSurface::CacheState
+{
+  uint resolution;
+  size_t max_bytes;
+
+  std::once_flag built;
+  std::unique_ptr<DistanceCache> cache;
+};
+
 ImplicitSurface::ImplicitSurface(ImplicitEvalFunc f_, ImplicitGradFunc g_,
                                  scalar lipschitz_const, const bounds::AABB& bounds)
-  : f(f_), g(g_), L(lipschitz_const), bbox(bounds)
+  : f(f_), g(g_), L(lipschitz_const), batch_size(1),
+    tracing_(Tracing::SPHERE), relaxation(1), rays_traced(0), evaluations(0), bbox(bounds)
+{
+
+}
+
+ImplicitSurface::ImplicitSurface(ImplicitBatchFunc fb_, ImplicitGradFunc g_,
+                                 scalar lipschitz_const, const bounds::AABB& bounds,
+                                 uint batch_size_)
+  : fb(fb_), g(g_), L(lipschitz_const),
+    batch_size(std::max(1u, std::min(batch_size_, MAX_BATCH_SIZE))),
+    tracing_(Tracing::SPHERE), relaxation(1), rays_traced(0), evaluations(0), bbox(bounds)
+{
+
+}
+
+ImplicitSurface::~ImplicitSurface()
+{
+}
+
+void ImplicitSurface::cache_distances(uint resolution, size_t max_bytes)
+{
+  cache.reset(new CacheState{resolution, max_bytes, {}, nullptr});
+}
+
+const DistanceCache* ImplicitSurface::distance_cache() const
+{
+  if (!cache)
+    return nullptr;
+
+  std::call_once(cache->built, [this]
+  {
+    cache->cache.reset(new DistanceCache(
+      [this](const Vec3* points, scalar* values, uint n) { eval(points, values, n); },
+      L, bbox, cache->resolution, cache->max_bytes));
+  });
+  return cache->cache.get();
+}
+
+void ImplicitSurface::set_tracing(Tracing tracing, scalar relaxation_)
+{
+  tracing_ = tracing;
+
+  // From 2 on, no step could pass the overlap test.
+  relaxation = clamp(relaxation_, 1, 1.95);
+}
+
+scalar ImplicitSurface::evaluations_per_ray() const
 {
+  return rays_traced ? scalar(evaluations) / rays_traced : 0;
+}
 
+void count_implicit_evaluations(bool on)
+{
+  counting.store(on, std::memory_order_relaxed);
 }
 
+scalar implicit_evaluations_per_ray()
+{
+  return all_rays_traced ? scalar(all_evaluations) / all_rays_traced : 0;
+}
+
+void ImplicitSurface::eval(const Vec3* points, scalar* values, uint n) const
+{
+  if (fb)
+    fb(points, values, n);
+  else
+    for (auto i = 0u; i < n; ++i)
+      values[i] = f(points[i]);
+}
+
+
+scalar ImplicitSurface::value(const Vec3& p) const
+{
+  scalar v;
+  eval(&p, &v, 1);
+  return v;
+}
 
 Vec3 ImplicitSurface::normal(SubGeo subgeo, const Vec3& point) const
 {
   return g(point).normal();
 }
 
-/*
- * intersectino using a basic sphere-tracing algorithm
- */
 scalar_fp ImplicitSurface::intersect(const Ray& r, scalar_fp max_t) const
 {
   scalar t0, t1;
@@ -36,35 +124,165 @@ scalar_fp ImplicitSurface::intersect(const Ray& r, scalar_fp max_t) const
   if (max_t.is())
     t1 = std::min(max_t.get(), t1);
 
-  scalar t = MIN_STEP;
-
-  scalar rdn = r.direction.norm();
-  scalar dist = f(r.evaluate(t));
+  // The surface lies within the box, so there's nothing to find before it.
+  uint evals = 0;
+  const scalar start = std::max(t0, MIN_STEP);
+  const auto t = tracing_ == Tracing::RELAXED ?
+    trace_relaxed(r, start, t1, evals) : trace_sphere(r, start, t1, evals);
 
-  if (fabs(dist) < MIN_STEP)
-    return scalar_fp{t};
+  if (counting.load(std::memory_order_relaxed))
+  {
+    rays_traced.fetch_add(1, std::memory_order_relaxed);
+    evaluations.fetch_add(evals, std::memory_order_relaxed);
+    all_rays_traced.fetch_add(1, std::memory_order_relaxed);
+    all_evaluations.fetch_add(evals, std::memory_order_relaxed);
+  }
 
+  return t;
+}
 
+/*
+ * intersection using a basic sphere-tracing algorithm, taking batches of
+ * steps for batched functions
+ */
+scalar_fp ImplicitSurface::trace_sphere(const Ray& r, scalar t, scalar t1, uint& evals) const
+{
+  const scalar rdn = r.direction.norm();
   const auto rdnl = rdn * L;
+  const auto dc = distance_cache();
+
+  Vec3 points[MAX_BATCH_SIZE];
+  scalar dists[MAX_BATCH_SIZE];
+
+  bool have_dist = false;
+  scalar dist = 0;
   do
   {
-    scalar t_diff = std::max(dist, MIN_STEP) / rdnl;
-    scalar new_t = t + t_diff;
-    scalar new_dist = f(r.evaluate(new_t));
-    if (fabs(new_dist) < MIN_STEP)
+    if (dc)
+    {
+      // Cross the space the cache shows to be empty without evaluating the
+      // function.
+      const scalar b = dc->bound(r.evaluate(t));
+      if (b > dc->cell_size())
+      {
+        t += b / rdn;
+        have_dist = false;
+        continue;
+      }
+    }
+
+    if (!have_dist)
     {
-      // If we find a near-enough surface point, use the secant approximation to
-      // find the zero-point.
-      return scalar_fp{t + (dist - 0) / (dist - new_dist) * t_diff};
+      const Vec3 p = r.evaluate(t);
+      eval(&p, &dist, 1);
+      ++evals;
+      if (fabs(dist) < MIN_STEP)
+        return scalar_fp{t};
+
+      have_dist = true;
     }
 
-    t = new_t;
-    dist = new_dist;
+    const scalar t_diff = std::max(dist, MIN_STEP) / rdnl;
+
+    uint n = 1;
+    while (n < batch_size && t + n * t_diff < t1)
+      ++n;
+    for (auto i = 0u; i < n; ++i)
+      points[i] = r.evaluate(t + (i + 1) * t_diff);
+    eval(points, dists, n);
+    evals += n;
+
+    for (auto i = 0u; i < n; ++i)
+    {
+      const scalar new_dist = dists[i];
+      if (fabs(new_dist) < MIN_STEP)
+      {
+        // If we find a near-enough surface point, use the secant approximation to
+        // find the zero-point.
+        return scalar_fp{t + (dist - 0) / (dist - new_dist) * t_diff};
+      }
+
+      // Past the first step, which is safe, the function could reach zero
+      // between two points unless their distances add up to more than the
+      // gap. If so, carry on from the last point with a step of its own.
+      if (i > 0 && fabs(dist) + fabs(new_dist) <= rdnl * t_diff)
+        break;
+
+      t += t_diff;
+      dist = new_dist;
+    }
   } while (t < t1);
 
   return sfp_none;
 }
 
+/*
+ * Over-relaxed sphere tracing, after Keinert et al., "Enhanced Sphere
+ * Tracing". Each step goes relaxation times the safe distance. The surface
+ * can't lie between two points while the spheres of safe distance about
+ * them overlap; once they don't, trace on from the earlier point with plain
+ * steps, relaxing again once the distance grows.
+ */
+scalar_fp ImplicitSurface::trace_relaxed(const Ray& r, scalar t, scalar t1, uint& evals) const
+{
+  const scalar rdn = r.direction.norm();
+  const auto rdnl = rdn * L;
+  const auto dc = distance_cache();
+
+  scalar omega = relaxation;
+
+  // the last point's t, distance and safe distance along the ray
+  scalar prev_t = t, prev_dist = 0, prev_radius = 0;
+
+  while (t < t1)
+  {
+    if (dc)
+    {
+      const scalar b = dc->bound(r.evaluate(t));
+      if (b > dc->cell_size())
+      {
+        t += b / rdn;
+        prev_t = t;
+        prev_dist = prev_radius = 0;
+        continue;
+      }
+    }
+
+    const Vec3 p = r.evaluate(t);
+    scalar dist;
+    eval(&p, &dist, 1);
+    ++evals;
+
+    const scalar radius = fabs(dist) / rdnl;
+    if (omega > 1 && (radius + prev_radius <= t - prev_t || dist * prev_dist < 0))
+    {
+      // Overshot: the gap may hide the surface, or holds it for certain if
+      // the function changed sign.
+      omega = 1;
+      t = prev_t + std::max(prev_radius, MIN_STEP / rdnl);
+      continue;
+    }
+
+    if (fabs(dist) < MIN_STEP)
+      return scalar_fp{t};
+
+    // Moving away from the surface, relax again.
+    if (radius > prev_radius)
+      omega = relaxation;
+
+    // A step out of the box is only safe unrelaxed, as there's no point
+    // beyond it to check.
+    const scalar step = t + omega * radius < t1 ? omega * radius : radius;
+
+    prev_t = t;
+    prev_dist = dist;
+    prev_radius = radius;
+    t += std::max(step, MIN_STEP / rdnl);
+  }
+
+  return sfp_none;
+}
+
 class GradFromEval
 {
 public:
@@ -91,6 +309,26 @@ ImplicitGradFunc gradient_from_sdf(ImplicitEvalFunc f)
   return [=](const Vec3& v) { return grad->grad(v); };
 }
 
+ImplicitGradFunc gradient_from_dual(ImplicitDualFunc f)
+{
+  return [=](const Vec3& v) { return f(DualVec3::variable(v)).d; };
+}
+
+ImplicitGradFunc gradient_from_batch(ImplicitBatchFunc fb)
+{
+  // the same differences as GradFromEval, in one batch
+  return [=](const Vec3& v)
+  {
+    const scalar EPS = 0.0001;
+    const Vec3 points[4] = {v, v + Vec3::x_axis * EPS, v + Vec3::y_axis * EPS,
+                            v + Vec3::z_axis * EPS};
+    scalar values[4];
+    fb(points, values, 4);
+
+    return Vec3(values[1] - values[0], values[2] - values[0], values[3] - values[0]) / EPS;
+  };
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 shared_ptr<Geometry> make_torus(Vec3 normal, scalar outer_radius, scalar inner_radius)
@@ -121,10 +359,12 @@ shared_ptr<Geometry> make_capsule(Vec3 direction, scalar length, scalar radius)
   Vec3 a = direction.normal() * (length / 2);
   Vec3 b = -a;
 
-  auto sdf = [=](const Vec3& v)
+  auto sdf = [=](const auto& v)
   {
-    Vec3 va  = v - a, ba = b - a;
-    scalar s = clamp( va.dot(ba) / ba.norm2(), 0, 1);
+    using P = std::decay_t<decltype(v)>;
+    auto va = v - P(a);
+    const P ba(b - a);
+    auto s = clamp( va.dot(ba) / ba.norm2(), 0, 1);
 
     return ( va - ba * s ).norm() - radius;
   };
@@ -132,17 +372,18 @@ shared_ptr<Geometry> make_capsule(Vec3 direction, scalar length, scalar radius)
   Vec3 r{radius};
   Vec3 lb = -direction.abs() - r;
 
-  return make_shared<ImplicitSurface>(sdf, gradient_from_sdf(sdf), 1.0, bounds::AABB{lb, -lb});
+  return make_implicit(sdf, 1.0, bounds::AABB{lb, -lb});
 }
 
 shared_ptr<Geometry> make_rounded_box(Vec3 size, scalar radius)
 {
   Vec3 hw = size.abs() * 0.5;
-  auto sdf = [=] (const Vec3& v)
+  auto sdf = [=] (const auto& v)
   {
-    return max(v.abs() - hw, Vec3::zero).norm() - radius;
+    using P = std::decay_t<decltype(v)>;
+    return max(v.abs() - P(hw), P(Vec3::zero)).norm() - radius;
   };
 
   auto ub = hw + Vec3{radius};
-  return make_shared<ImplicitSurface>(sdf, gradient_from_sdf(sdf), 1.0, bounds::AABB{-ub, ub});
+  return make_implicit(sdf, 1.0, bounds::AABB{-ub, ub});
 }
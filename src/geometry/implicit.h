@@ -1,14 +1,34 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include "geometry.h"
 #include "bounds.h"
+#include "dual.h"
 #include "vec3.h"
 
 using ImplicitEvalFunc = std::function<scalar(const Vec3&)>;
 using ImplicitGradFunc = std::function<Vec3(const Vec3&)>;
 
+/*
+ * Evaluates the function at n points at once, for functions that cost more
+ * to call than to evaluate, such as script functions.
+ */
+using ImplicitBatchFunc = std::function<void(const Vec3* points, scalar* values, uint n)>;
+
+using ImplicitDualFunc = std::function<Dual(const DualVec3&)>;
+
 ImplicitGradFunc gradient_from_sdf(ImplicitEvalFunc);
+ImplicitGradFunc gradient_from_batch(ImplicitBatchFunc);
+
+/*
+ * The exact gradient, from one evaluation over dual numbers rather than four
+ * of the function.
+ */
+ImplicitGradFunc gradient_from_dual(ImplicitDualFunc);
+
+class DistanceCache;
 
 class ImplicitSurface : public SimpleGeometry, public Bounded
 {
@@ -18,6 +38,56 @@ public:
                   scalar lipschitz_const,
                   const bounds::AABB& box);
 
+  /*
+   * Sphere tracing takes up to batch_size steps per call of the function:
+   * the first is the usual step, and the rest continue with the same length,
+   * kept only while the function shows the surface can't lie between them.
+   */
+  ImplicitSurface(ImplicitBatchFunc, ImplicitGradFunc,
+                  scalar lipschitz_const,
+                  const bounds::AABB& box,
+                  uint batch_size);
+
+  ~ImplicitSurface();
+
+  static const uint MAX_BATCH_SIZE = 16;
+
+  /*
+   * Sphere trace through a DistanceCache of the surface, evaluating the
+   * function only within a cell or so of the surface. The cache is built by
+   * the first intersection, since script functions can only be evaluated on
+   * the render threads.
+   */
+  void cache_distances(uint resolution, size_t max_bytes);
+
+  // The cache, building it if needed, or null if there's none.
+  const DistanceCache* distance_cache() const;
+
+  enum class Tracing
+  {
+    // steps of |f| / L, or batches of them for batched functions
+    SPHERE,
+
+    /*
+     * Steps of relaxation * |f| / L, falling back to a plain step whenever
+     * the spheres about two points fail to overlap, and to plain steps until
+     * the ray moves away from the surface. Batched functions are evaluated a
+     * point at a time.
+     */
+    RELAXED
+  };
+
+  void set_tracing(Tracing tracing, scalar relaxation = 1.6);
+  Tracing tracing() const { return tracing_; }
+
+  // Function evaluations per ray intersected, over every ray traced while
+  // count_implicit_evaluations is on
+  scalar evaluations_per_ray() const;
+
+  // The function at p, and the bound on its rate of change
+  scalar value(const Vec3& p) const;
+  scalar lipschitz() const { return L; }
+
   Vec3 normal(SubGeo geo, const Vec3& point) const override;
 
   scalar_fp intersect(const Ray& r, scalar_fp max_t = sfp_none) const override;
@@ -28,13 +98,52 @@ public:
   }
 
 private:
+  void eval(const Vec3* points, scalar* values, uint n) const;
+
+  // from t to t1, counting the function's evaluations in evals
+  scalar_fp trace_sphere(const Ray& r, scalar t, scalar t1, uint& evals) const;
+  scalar_fp trace_relaxed(const Ray& r, scalar t, scalar t1, uint& evals) const;
+
   ImplicitEvalFunc f;
+  ImplicitBatchFunc fb;
   ImplicitGradFunc g;
   scalar L;
+  uint batch_size;
+
+  Tracing tracing_;
+  scalar relaxation;
+
+  mutable std::atomic_ullong rays_traced, evaluations;
 
   bounds::AABB bbox;
+
+  struct CacheState;
+  std::unique_ptr<CacheState> cache;
 };
 
+/*
+ * An implicit surface for f, a function of either a Vec3 or a DualVec3 such as
+ * a generic lambda, with normals from its dual evaluation.
+ */
+template <typename F>
+shared_ptr<ImplicitSurface> make_implicit(F f, scalar lipschitz_const, const bounds::AABB& box)
+{
+  return std::make_shared<ImplicitSurface>(ImplicitEvalFunc(f), gradient_from_dual(f),
+                                           lipschitz_const, box);
+}
+
+/*
+ * Turn counting of rays and evaluations, for every implicit surface, on or
+ * off. It's off by default.
+ */
+void count_implicit_evaluations(bool on);
+
+/*
+ * Evaluations per ray over every implicit surface, for reporting after a
+ * render.
+ */
+scalar implicit_evaluations_per_ray();
+
 shared_ptr<Geometry> make_torus(Vec3 normal, scalar outer_radius, scalar inner_radius);
 shared_ptr<Geometry> make_capsule(Vec3 direction, scalar length, scalar radius);
 shared_ptr<Geometry> make_rounded_box(Vec3 size, scalar radius);
@@ -0,0 +1,164 @@
+#include "geometry/implicit_union.h"
+#include <algorithm>
+
+namespace
+{
+  // Parts are evaluated within this fraction of their box's diagonal, so that
+  // box distances never come near enough to zero to pass for a hit.
+  const scalar MARGIN = 0.01;
+  const scalar MIN_MARGIN = 0.001;
+
+  const uint MAX_LEAF_SIZE = 2;
+  const uint MAX_DEPTH = 64;
+
+  scalar box_distance(const bounds::AABB& box, const Vec3& p)
+  {
+    return max(max(box.min() - p, p - box.max()), Vec3::zero).norm();
+  }
+}
+
+ImplicitUnion::ImplicitUnion(vector<const ImplicitSurface*> parts_)
+  : parts(std::move(parts_))
+{
+  assert(!parts.empty());
+
+  for (auto part : parts)
+  {
+    boxes.push_back(part->get_bounding_box());
+    margins.push_back(std::max(MARGIN * boxes.back().size().norm(), MIN_MARGIN));
+  }
+
+  nodes.reserve(2 * parts.size());
+  build(0, parts.size());
+}
+
+uint ImplicitUnion::build(uint begin, uint end)
+{
+  const uint index = nodes.size();
+  nodes.push_back(Node{boxes[begin], begin, end - begin});
+  for (auto i = begin + 1; i < end; ++i)
+    nodes[index].box = nodes[index].box.union_with(boxes[i]);
+
+  if (end - begin <= MAX_LEAF_SIZE)
+    return index;
+
+  // Split at the median center along the longest axis of the centers.
+  bounds::AABB centers(boxes[begin].center(), boxes[begin].center());
+  for (auto i = begin + 1; i < end; ++i)
+    centers = centers.union_with(bounds::AABB(boxes[i].center(), boxes[i].center()));
+
+  const Vec3 size = centers.size();
+  const int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+  // Sort parts, boxes and margins together, by their order along the axis.
+  vector<uint> order(end - begin);
+  for (auto i = 0u; i < order.size(); ++i)
+    order[i] = begin + i;
+
+  const uint mid = (begin + end) / 2;
+  std::nth_element(order.begin(), order.begin() + (mid - begin), order.end(),
+                   [&](uint a, uint b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+
+  vector<const ImplicitSurface*> sorted_parts;
+  vector<bounds::AABB> sorted_boxes;
+  vector<scalar> sorted_margins;
+  for (auto i : order)
+  {
+    sorted_parts.push_back(parts[i]);
+    sorted_boxes.push_back(boxes[i]);
+    sorted_margins.push_back(margins[i]);
+  }
+  std::copy(sorted_parts.begin(), sorted_parts.end(), parts.begin() + begin);
+  std::copy(sorted_boxes.begin(), sorted_boxes.end(), boxes.begin() + begin);
+  std::copy(sorted_margins.begin(), sorted_margins.end(), margins.begin() + begin);
+
+  build(begin, mid);
+  const uint right = build(mid, end);
+
+  nodes[index].offset = right;
+  nodes[index].count = 0;
+  return index;
+}
+
+scalar ImplicitUnion::eval(const Vec3& p, int& part) const
+{
+  scalar best = SCALAR_MAX;
+  part = -1;
+
+  struct Entry
+  {
+    uint node;
+    scalar dist;
+  };
+  Entry stack[MAX_DEPTH];
+  int top = 0;
+  stack[top++] = Entry{0, box_distance(nodes[0].box, p)};
+
+  while (top > 0)
+  {
+    const auto entry = stack[--top];
+    if (entry.dist >= best)
+      continue;
+
+    const auto& node = nodes[entry.node];
+    if (node.count > 0)
+    {
+      for (auto i = node.offset; i < node.offset + node.count; ++i)
+      {
+        const scalar d = box_distance(boxes[i], p);
+        if (d >= best)
+          continue;
+
+        if (d > margins[i])
+        {
+          best = d;
+          part = -1;
+          continue;
+        }
+
+        const scalar v = parts[i]->value(p) / parts[i]->lipschitz();
+        if (v < best)
+        {
+          best = v;
+          part = i;
+        }
+      }
+    }
+    else
+    {
+      // Visit the nearer child first, so that it prunes the other.
+      Entry nearer{entry.node + 1, box_distance(nodes[entry.node + 1].box, p)};
+      Entry farther{node.offset, box_distance(nodes[node.offset].box, p)};
+      if (farther.dist < nearer.dist)
+        std::swap(nearer, farther);
+
+      assert(top + 2 <= int(MAX_DEPTH));
+      stack[top++] = farther;
+      stack[top++] = nearer;
+    }
+  }
+
+  return best;
+}
+
+Vec3 ImplicitUnion::gradient(const Vec3& p) const
+{
+  int part;
+  eval(p, part);
+
+  // Hits lie within the margin of some part's box, so this is only for
+  // points far from every part.
+  if (part < 0)
+    return p - get_bounding_box().center();
+
+  return parts[part]->normal(0, p);
+}
+
+shared_ptr<ImplicitSurface> make_implicit_union(vector<const ImplicitSurface*> parts)
+{
+  auto u = std::make_shared<ImplicitUnion>(std::move(parts));
+  return std::make_shared<ImplicitSurface>(
+    [u](const Vec3& p) { int part; return u->eval(p, part); },
+    [u](const Vec3& p) { return u->gradient(p); },
+    1.0, u->get_bounding_box());
+}
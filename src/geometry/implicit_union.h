@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "geometry/implicit.h"
+
+using std::shared_ptr;
+using std::vector;
+
+/*
+ * The union of many implicit surfaces, each within its own bounds, kept in a
+ * small bounding volume hierarchy so that a point only evaluates the parts
+ * whose bounds lie near it.
+ *
+ * Each part contributes its function over its Lipschitz constant within a
+ * margin of its box, and the distance to its box beyond that; the union is
+ * the least of these. Every term is a lower bound on the distance to the
+ * part's surface, so the least is one for the union, and parts whose boxes
+ * lie further than it are skipped.
+ */
+class ImplicitUnion
+{
+public:
+  // The parts outlive the union, as with Transformed.
+  ImplicitUnion(vector<const ImplicitSurface*> parts);
+
+  /*
+   * The union's value at p, with a Lipschitz constant of one, and the part
+   * that gave it, or -1 if no part was near enough to evaluate.
+   */
+  scalar eval(const Vec3& p, int& part) const;
+
+  // The normal of the part nearest p
+  Vec3 gradient(const Vec3& p) const;
+
+  bounds::AABB get_bounding_box() const { return nodes.front().box; }
+
+  uint num_parts() const { return parts.size(); }
+
+private:
+  struct Node
+  {
+    bounds::AABB box;
+
+    // leaf: the first of count parts; inner: the right child, after the
+    // left at index + 1
+    uint offset;
+    uint count;
+  };
+
+  // builds the subtree over parts [begin, end), returning its index
+  uint build(uint begin, uint end);
+
+  vector<const ImplicitSurface*> parts;
+  vector<bounds::AABB> boxes;
+  vector<scalar> margins;
+  vector<Node> nodes;
+};
+
+/*
+ * One implicit surface for the union of the parts, traced as any other.
+ */
+shared_ptr<ImplicitSurface> make_implicit_union(vector<const ImplicitSurface*> parts);
@@ -1,6 +1,7 @@
+#include <cassert>
 #include "kdmesh.h"
 
-KDMesh::KDMesh(const RawModel& model) : Mesh(model)
+KDMesh::KDMesh(const RawModel& model, AccelType accel) : Mesh(model)
 {
   auto tri_addresses = vector<const MeshTri*>{tris.size()};
   for (auto i = 0u; i < tris.size(); ++i)
@@ -8,20 +9,96 @@ KDMesh::KDMesh(const RawModel& model) : Mesh(model)
 
   kd::TreeOptions opt;
   opt.max_elements_per_leaf = 10;
-  kd_tree = std::make_unique<tri_tree>(tri_addresses, opt);
+#if FEATURE_SIMD_LEAVES
+  opt.leaf_block_size = TriangleBlock::WIDTH;
+#endif
+  tree = std::make_unique<tri_tree>(tri_addresses, accel, opt);
+
+#if FEATURE_SIMD_LEAVES
+  if (tree->kd())
+    pack_leaf_blocks();
+#endif
+}
+
+void KDMesh::pack_leaf_blocks()
+{
+  const auto& indices = tree->kd()->leaf_indices();
+  assert(indices.size() % TriangleBlock::WIDTH == 0);
+
+  blocks.resize(indices.size() / TriangleBlock::WIDTH);
+  for (auto i = 0u; i < indices.size(); ++i)
+  {
+    if (indices[i] == kd::Tree<MeshTri>::EMPTY_INDEX)
+      continue;
+
+    const auto& tri = tris[indices[i]];
+    blocks[i / TriangleBlock::WIDTH].set(i % TriangleBlock::WIDTH, indices[i],
+                                          tri.position(0), tri.position(1), tri.position(2));
+  }
+}
+
+scalar_fp KDMesh::intersect_blocks(const kd::Node<MeshTri>& leaf, const Ray& r, scalar_fp max_t,
+                                   SubGeo& geo) const
+{
+  const auto first = leaf.offset() / TriangleBlock::WIDTH;
+  const auto last = (leaf.offset() + leaf.num_objects() + TriangleBlock::WIDTH - 1) / TriangleBlock::WIDTH;
+
+  scalar_fp best_t = max_t;
+  bool hit = false;
+  for (auto b = first; b < last; ++b)
+  {
+    int lane;
+    auto t = blocks[b].intersect(r, best_t, lane);
+    if (t.is())
+    {
+      best_t = t;
+      geo = blocks[b].id[lane];
+      hit = true;
+    }
+  }
+  return hit ? best_t : sfp_none;
 }
 
 bounds::AABB KDMesh::get_bounding_box() const
 {
-  return kd_tree->get_bounding_box();
+  return tree->get_bounding_box();
 }
 
 scalar_fp KDMesh::intersect(const Ray& r, scalar_fp max_t, SubGeo& geo) const
 {
+  if (!blocks.empty())
+  {
+    return tree->kd()->intersect_leaves(r, max_t, [&](const kd::Node<MeshTri>& leaf, scalar_fp leaf_max_t)
+                                        {
+                                          return intersect_blocks(leaf, r, leaf_max_t, geo);
+                                        });
+  }
+
   MeshTri const* tri = nullptr;
   SubGeo dummy;
-  scalar_fp t = kd_tree->intersect(r, max_t, tri, dummy);
+  scalar_fp t = tree->intersect(r, max_t, tri, dummy);
   if (t.is())
     geo = tri - &tris[0];
   return t;
 }
+
+bool KDMesh::occluded(const Ray& r, scalar_fp max_t) const
+{
+  if (!blocks.empty())
+  {
+    return tree->kd()->occluded_leaves(r, max_t, [&](const kd::Node<MeshTri>& leaf)
+                                       {
+                                         const auto first = leaf.offset() / TriangleBlock::WIDTH;
+                                         const auto last = (leaf.offset() + leaf.num_objects() +
+                                                            TriangleBlock::WIDTH - 1) / TriangleBlock::WIDTH;
+                                         for (auto b = first; b < last; ++b)
+                                         {
+                                           if (blocks[b].occluded(r, max_t))
+                                             return true;
+                                         }
+                                         return false;
+                                       });
+  }
+
+  return tree->occluded(r, max_t);
+}
@@ -1,16 +1,19 @@
 #include "mesh.h"
-#include "kdtree.h"
+#include "accel.h"
+#include "triangle_block.h"
 
 using std::unique_ptr;
-using tri_tree = kd::Tree<MeshTri>;
+using tri_tree = Accelerator<MeshTri>;
 
 class KDMesh : public Mesh
 {
 public:
-  KDMesh(const RawModel& model);
+  KDMesh(const RawModel& model, AccelType accel = AccelType::KD_TREE);
 
   scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) const override;
 
+  bool occluded(const Ray& r, scalar_fp max_t) const override;
+
   bounds::AABB get_bounding_box() const override;
 
   virtual string to_string() const override { return "KDMesh"; }
@@ -21,5 +24,18 @@ public:
   KDMesh& operator=(const KDMesh&) = delete;
 
   friend class MeshTri;
-  unique_ptr<tri_tree> kd_tree;
+  unique_ptr<tri_tree> tree;
+
+private:
+  /*
+   * Copy the triangles of each kd-tree leaf, in leaf index order, into SoA
+   * blocks, so that a leaf is tested a block at a time.
+   */
+  void pack_leaf_blocks();
+
+  scalar_fp intersect_blocks(const kd::Node<MeshTri>& leaf, const Ray& r, scalar_fp max_t,
+                             SubGeo& geo) const;
+
+  // empty unless the leaves are packed
+  vector<TriangleBlock> blocks;
 };
@@ -111,6 +111,13 @@ scalar_fp Mesh::intersect(const Ray& r, scalar_fp max_t, SubGeo& subgeo) const
   return best_t;
 }
 
+bool Mesh::occluded(const Ray& r, scalar_fp max_t) const
+{
+  SubGeo geo;
+  return std::any_of(tris.begin(), tris.end(),
+                     [&](const MeshTri& tri) { return tri.intersect(r, max_t, geo).is(); });
+}
+
 Vec3 Mesh::normal(SubGeo subgeo, const Vec3& point) const
 {
   return tris[subgeo].normal(point);
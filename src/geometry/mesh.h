@@ -57,6 +57,8 @@ public:
   }
   virtual scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) const override;
 
+  bool occluded(const Ray& r, scalar_fp max_t) const override;
+
   Vec3 normal(SubGeo, const Vec3& point) const override;
 
   bool is_differential() const override
@@ -93,6 +95,11 @@ public:
     return verts[i].uv;
   }
 
+  const vector<MeshTri>& triangles() const
+  {
+    return tris;
+  }
+
   virtual ~Mesh() { }
 
 protected:
@@ -113,6 +120,12 @@ public:
 
   scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo&) const ;
 
+  bool occluded(const Ray& r, scalar_fp max_t) const
+  {
+    SubGeo geo;
+    return intersect(r, max_t, geo).is();
+  }
+
   Vec3 normal(const Vec3& point) const ;
 
   virtual void texture_coord(const Vec3& pos, const Vec3& normal,
@@ -125,6 +138,8 @@ public:
 
   virtual bounds::AABB get_bounding_box() const;
 
+  const Vec3& position(int i) const { return _p(i); }
+
   virtual ~MeshTri() {}
 
 private:
@@ -0,0 +1,744 @@
+#include "geometry/sdf.h"
+#include "geometry/implicit.h"
+#include "math_util.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+using std::make_shared;
+using std::min;
+using std::max;
+
+namespace sdf
+{
+  namespace
+  {
+    using simd::packed;
+    using simd::load;
+    using simd::store;
+    using simd::broadcast;
+    using simd::select_less;
+
+    // Batches run in whole registers of L lanes; lanes past the batch's
+    // points are computed and thrown away.
+    const uint L = simd::WIDTH;
+    const uint W = (Program::MAX_BATCH + L - 1) / L * L;
+
+    /*
+     * The point at which the current node is evaluated, with the rotation and
+     * scale taking its distances and gradients back to world space.
+     */
+    struct Frame
+    {
+      scalar x[W], y[W], z[W];
+
+      Mat33 to_world;
+      bool rotated;
+      scalar scale;
+    };
+
+    struct Slot
+    {
+      scalar d[W], gx[W], gy[W], gz[W];
+    };
+
+    inline scalar safe_inv(scalar v)
+    {
+      return v > 0 ? 1 / v : 0;
+    }
+
+    inline packed sign(packed v)
+    {
+      return select_less(v, broadcast(0), broadcast(-1), broadcast(1));
+    }
+
+    // The division is thrown away in the lanes where v isn't positive.
+    inline packed safe_inv(packed v)
+    {
+      return select_less(broadcast(0), v, broadcast(1) / v, broadcast(0));
+    }
+
+    inline packed clamp(packed v, scalar lo, scalar hi)
+    {
+      return simd::min(broadcast(hi), simd::max(v, broadcast(lo)));
+    }
+
+    // Take the local distance and gradient of a primitive to world space.
+    template <bool GRAD>
+    void finish_primitive(const Frame& f, Slot& s, uint lanes)
+    {
+      const packed scale = broadcast(f.scale);
+      for (auto i = 0u; i < lanes; i += L)
+        store(s.d + i, load(s.d + i) * scale);
+
+      if (GRAD && f.rotated)
+      {
+        const scalar* m = f.to_world.v;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed gx = load(s.gx + i), gy = load(s.gy + i), gz = load(s.gz + i);
+          store(s.gx + i, broadcast(m[0]) * gx + broadcast(m[1]) * gy + broadcast(m[2]) * gz);
+          store(s.gy + i, broadcast(m[3]) * gx + broadcast(m[4]) * gy + broadcast(m[5]) * gz);
+          store(s.gz + i, broadcast(m[6]) * gx + broadcast(m[7]) * gy + broadcast(m[8]) * gz);
+        }
+      }
+    }
+
+    NodePtr make_node(Op op, vector<scalar> params, vector<shared_ptr<const Node>> children = {})
+    {
+      return make_shared<Node>(op, std::move(params), std::move(children));
+    }
+
+    bounds::AABB grow(const bounds::AABB& b, scalar r)
+    {
+      return bounds::AABB{b.min() - Vec3{r}, b.max() + Vec3{r}};
+    }
+  }
+
+  std::string Node::to_string() const
+  {
+    static const char* names[] = {"sphere", "box", "torus", "cylinder", "capsule", "plane",
+                                  "union", "intersection", "difference", "smooth_union",
+                                  "round", "shell",
+                                  "translate", "rotate", "scale", "repeat",
+                                  "pop_frame"};
+    return std::string("sdf::") + names[static_cast<int>(op)];
+  }
+
+  NodePtr sphere(scalar radius)
+  {
+    return make_node(Op::SPHERE, {radius});
+  }
+
+  NodePtr box(const Vec3& h)
+  {
+    return make_node(Op::BOX, {h.x, h.y, h.z});
+  }
+
+  NodePtr torus(scalar major, scalar minor)
+  {
+    return make_node(Op::TORUS, {major, minor});
+  }
+
+  NodePtr cylinder(scalar radius, scalar half_height)
+  {
+    return make_node(Op::CYLINDER, {radius, half_height});
+  }
+
+  NodePtr capsule(const Vec3& a, const Vec3& b, scalar radius)
+  {
+    return make_node(Op::CAPSULE, {a.x, a.y, a.z, b.x, b.y, b.z, radius});
+  }
+
+  NodePtr plane(const Vec3& normal, scalar offset)
+  {
+    const Vec3 n = normal.normal();
+    return make_node(Op::PLANE, {n.x, n.y, n.z, offset / normal.norm()});
+  }
+
+  NodePtr csg_union(vector<shared_ptr<const Node>> nodes)
+  {
+    return make_node(Op::UNION, {}, std::move(nodes));
+  }
+
+  NodePtr intersection(vector<shared_ptr<const Node>> nodes)
+  {
+    return make_node(Op::INTERSECTION, {}, std::move(nodes));
+  }
+
+  NodePtr difference(shared_ptr<const Node> a, shared_ptr<const Node> b)
+  {
+    return make_node(Op::DIFFERENCE, {}, {a, b});
+  }
+
+  NodePtr smooth_union(shared_ptr<const Node> a, shared_ptr<const Node> b, scalar k)
+  {
+    return make_node(Op::SMOOTH_UNION, {k}, {a, b});
+  }
+
+  NodePtr rounded(shared_ptr<const Node> node, scalar radius)
+  {
+    return make_node(Op::ROUND, {radius}, {node});
+  }
+
+  NodePtr shell(shared_ptr<const Node> node, scalar thickness)
+  {
+    return make_node(Op::SHELL, {thickness}, {node});
+  }
+
+  NodePtr translate(shared_ptr<const Node> node, const Vec3& offset)
+  {
+    return make_node(Op::TRANSLATE, {offset.x, offset.y, offset.z}, {node});
+  }
+
+  NodePtr rotate(shared_ptr<const Node> node, const Vec3& axis, scalar angle)
+  {
+    const auto r = Mat33::from_axis_angle(axis.normal(), angle);
+    return make_node(Op::ROTATE, vector<scalar>(r.v, r.v + 9), {node});
+  }
+
+  NodePtr scale(shared_ptr<const Node> node, scalar factor)
+  {
+    return make_node(Op::SCALE, {factor}, {node});
+  }
+
+  NodePtr repeat(shared_ptr<const Node> node, const Vec3& period)
+  {
+    return make_node(Op::REPEAT, {period.x, period.y, period.z}, {node});
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  optional<bounds::AABB> node_bounds(const Node& node)
+  {
+    const auto& p = node.params;
+    switch (node.op)
+    {
+    case Op::SPHERE:
+      return bounds::AABB{Vec3{-p[0]}, Vec3{p[0]}};
+
+    case Op::BOX:
+      return bounds::AABB{-Vec3{p[0], p[1], p[2]}, Vec3{p[0], p[1], p[2]}};
+
+    case Op::TORUS:
+    {
+      const Vec3 h{p[0] + p[1], p[1], p[0] + p[1]};
+      return bounds::AABB{-h, h};
+    }
+
+    case Op::CYLINDER:
+      return bounds::AABB{-Vec3{p[0], p[1], p[0]}, Vec3{p[0], p[1], p[0]}};
+
+    case Op::CAPSULE:
+    {
+      const Vec3 a{p[0], p[1], p[2]}, b{p[3], p[4], p[5]};
+      return grow(bounds::AABB{::min(a, b), ::max(a, b)}, p[6]);
+    }
+
+    case Op::PLANE:
+      return none_tag;
+
+    case Op::UNION:
+    {
+      auto result = node_bounds(*node.children[0]);
+      for (auto i = 1u; i < node.children.size() && result.is(); ++i)
+      {
+        const auto b = node_bounds(*node.children[i]);
+        if (!b.is())
+          return none_tag;
+        result = result.get().union_with(b.get());
+      }
+      return result;
+    }
+
+    case Op::INTERSECTION:
+    {
+      optional<bounds::AABB> result = none_tag;
+      for (const auto& child : node.children)
+      {
+        const auto b = node_bounds(*child);
+        if (!b.is())
+          continue;
+        if (!result.is())
+          result = b;
+        else
+          result = bounds::AABB{::max(result.get().min(), b.get().min()),
+                                ::min(result.get().max(), b.get().max())};
+      }
+      return result;
+    }
+
+    case Op::DIFFERENCE:
+      return node_bounds(*node.children[0]);
+
+    case Op::SMOOTH_UNION:
+    {
+      const auto a = node_bounds(*node.children[0]), b = node_bounds(*node.children[1]);
+      if (!a.is() || !b.is())
+        return none_tag;
+      // the blend adds at most k / 4 to either
+      return grow(a.get().union_with(b.get()), p[0] / 4);
+    }
+
+    case Op::ROUND:
+    case Op::SHELL:
+    {
+      const auto b = node_bounds(*node.children[0]);
+      if (!b.is())
+        return none_tag;
+      return grow(b.get(), p[0]);
+    }
+
+    case Op::TRANSLATE:
+    {
+      const auto b = node_bounds(*node.children[0]);
+      if (!b.is())
+        return none_tag;
+      const Vec3 offset{p[0], p[1], p[2]};
+      return bounds::AABB{b.get().min() + offset, b.get().max() + offset};
+    }
+
+    case Op::ROTATE:
+    {
+      const auto b = node_bounds(*node.children[0]);
+      if (!b.is())
+        return none_tag;
+
+      // the box around the rotated corners
+      const Mat33 r(p.begin(), p.end());
+      Vec3 lo{SCALAR_MAX}, hi{-SCALAR_MAX};
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        const Vec3 c{b.get().bounds[corner & 1].x, b.get().bounds[(corner >> 1) & 1].y,
+            b.get().bounds[corner >> 2].z};
+        lo = ::min(lo, r * c);
+        hi = ::max(hi, r * c);
+      }
+      return bounds::AABB{lo, hi};
+    }
+
+    case Op::SCALE:
+    {
+      const auto b = node_bounds(*node.children[0]);
+      if (!b.is())
+        return none_tag;
+      return bounds::AABB{b.get().min() * p[0], b.get().max() * p[0]};
+    }
+
+    case Op::REPEAT:
+      if (p[0] > 0 || p[1] > 0 || p[2] > 0)
+        return none_tag;
+      return node_bounds(*node.children[0]);
+
+    case Op::POP_FRAME:
+      break;
+    }
+
+    return none_tag;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  Program::Program(const Node& root) : max_depth(0), max_frames(1)
+  {
+    compile(root, 0, 1);
+  }
+
+  void Program::compile(const Node& node, uint depth, uint frames)
+  {
+    auto emit = [&](Op op, const vector<scalar>& params)
+    {
+      code.push_back(Instruction{op, uint(constants.size())});
+      constants.insert(constants.end(), params.begin(), params.end());
+    };
+
+    switch (node.op)
+    {
+    case Op::SPHERE:
+    case Op::BOX:
+    case Op::TORUS:
+    case Op::CYLINDER:
+    case Op::CAPSULE:
+    case Op::PLANE:
+      emit(node.op, node.params);
+      max_depth = max(max_depth, depth + 1);
+      break;
+
+    case Op::UNION:
+    case Op::INTERSECTION:
+    case Op::DIFFERENCE:
+    case Op::SMOOTH_UNION:
+      // a chain of binary operations, needing one more slot than the deepest
+      // operand
+      compile(*node.children[0], depth, frames);
+      for (auto i = 1u; i < node.children.size(); ++i)
+      {
+        compile(*node.children[i], depth + 1, frames);
+        emit(node.op, node.params);
+      }
+      break;
+
+    case Op::ROUND:
+    case Op::SHELL:
+      compile(*node.children[0], depth, frames);
+      emit(node.op, node.params);
+      break;
+
+    case Op::TRANSLATE:
+    case Op::ROTATE:
+    case Op::SCALE:
+    case Op::REPEAT:
+      emit(node.op, node.params);
+      max_frames = max(max_frames, frames + 1);
+      compile(*node.children[0], depth, frames + 1);
+      emit(Op::POP_FRAME, {});
+      break;
+
+    case Op::POP_FRAME:
+      break;
+    }
+  }
+
+  void Program::eval(const Vec3* points, scalar* values, Vec3* grads, uint n) const
+  {
+    for (auto i = 0u; i < n; i += W)
+    {
+      const auto m = min(W, n - i);
+      if (grads)
+        run<true>(points + i, values + i, grads + i, m);
+      else
+        run<false>(points + i, values + i, nullptr, m);
+    }
+  }
+
+  scalar Program::eval(const Vec3& point) const
+  {
+    scalar value;
+    run<false>(&point, &value, nullptr, 1);
+    return value;
+  }
+
+  Vec3 Program::gradient(const Vec3& point) const
+  {
+    scalar value;
+    Vec3 grad;
+    run<true>(&point, &value, &grad, 1);
+    return grad;
+  }
+
+  template <bool GRAD>
+  void Program::run(const Vec3* points, scalar* values, Vec3* grads, uint n) const
+  {
+    thread_local vector<Frame> frame_stack;
+    thread_local vector<Slot> slot_stack;
+    if (frame_stack.size() < max_frames)
+      frame_stack.resize(max_frames);
+    if (slot_stack.size() < max_depth + 1)
+      slot_stack.resize(max_depth + 1);
+
+    // The lanes past n start at the origin, so that they stay finite.
+    const uint lanes = (n + L - 1) / L * L;
+    Frame* f = frame_stack.data();
+    for (auto i = 0u; i < lanes; ++i)
+    {
+      const Vec3& p = i < n ? points[i] : Vec3::zero;
+      f->x[i] = p.x;
+      f->y[i] = p.y;
+      f->z[i] = p.z;
+    }
+    f->to_world = Mat33::identity;
+    f->rotated = false;
+    f->scale = 1;
+
+    // the top of the distance stack, starting below the first slot it uses
+    Slot* s = slot_stack.data();
+
+    const packed zero = broadcast(0), one = broadcast(1);
+
+    for (const auto& ins : code)
+    {
+      const scalar* c = constants.data() + ins.param;
+
+      switch (ins.op)
+      {
+      case Op::SPHERE:
+        ++s;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed x = load(f->x + i), y = load(f->y + i), z = load(f->z + i);
+          const packed len = simd::sqrt(x * x + y * y + z * z);
+          store(s->d + i, len - broadcast(c[0]));
+          if (GRAD)
+          {
+            const packed inv = safe_inv(len);
+            store(s->gx + i, x * inv);
+            store(s->gy + i, select_less(zero, len, y * inv, one));
+            store(s->gz + i, z * inv);
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+
+      case Op::BOX:
+        ++s;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed x = load(f->x + i), y = load(f->y + i), z = load(f->z + i);
+          const packed qx = simd::abs(x) - broadcast(c[0]), qy = simd::abs(y) - broadcast(c[1]),
+            qz = simd::abs(z) - broadcast(c[2]);
+          const packed ox = simd::max(qx, zero), oy = simd::max(qy, zero), oz = simd::max(qz, zero);
+          const packed outside = simd::sqrt(ox * ox + oy * oy + oz * oz);
+          const packed q_max = simd::max(qx, simd::max(qy, qz));
+          store(s->d + i, outside + simd::min(q_max, zero));
+          if (GRAD)
+          {
+            // outside, towards the nearest point; inside, the nearest face
+            const packed sx = sign(x), sy = sign(y), sz = sign(z);
+            const packed inv = safe_inv(outside);
+            const packed face_x = select_less(qx, q_max, zero, sx);
+            const packed face_y = select_less(qx, q_max, select_less(qy, q_max, zero, sy), zero);
+            const packed face_z = select_less(qx, q_max, select_less(qy, q_max, sz, zero), zero);
+            store(s->gx + i, select_less(zero, outside, sx * ox * inv, face_x));
+            store(s->gy + i, select_less(zero, outside, sy * oy * inv, face_y));
+            store(s->gz + i, select_less(zero, outside, sz * oz * inv, face_z));
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+
+      case Op::TORUS:
+        ++s;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed x = load(f->x + i), y = load(f->y + i), z = load(f->z + i);
+          const packed xz = simd::sqrt(x * x + z * z);
+          const packed qx = xz - broadcast(c[0]);
+          const packed len = simd::sqrt(qx * qx + y * y);
+          store(s->d + i, len - broadcast(c[1]));
+          if (GRAD)
+          {
+            const packed inv = safe_inv(len), radial = qx * safe_inv(xz) * inv;
+            store(s->gx + i, x * radial);
+            store(s->gy + i, select_less(zero, len, y * inv, one));
+            store(s->gz + i, z * radial);
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+
+      case Op::CYLINDER:
+        ++s;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed x = load(f->x + i), y = load(f->y + i), z = load(f->z + i);
+          const packed xz = simd::sqrt(x * x + z * z);
+          const packed dr = xz - broadcast(c[0]), dy = simd::abs(y) - broadcast(c[1]);
+          const packed orr = simd::max(dr, zero), oy = simd::max(dy, zero);
+          const packed outside = simd::sqrt(orr * orr + oy * oy);
+          store(s->d + i, outside + simd::min(simd::max(dr, dy), zero));
+          if (GRAD)
+          {
+            const packed gr = select_less(zero, outside, orr / outside, select_less(dy, dr, one, zero));
+            const packed gy = select_less(zero, outside, oy / outside, select_less(dy, dr, zero, one));
+            const packed inv_xz = safe_inv(xz);
+            store(s->gx + i, x * inv_xz * gr);
+            store(s->gy + i, sign(y) * gy);
+            store(s->gz + i, z * inv_xz * gr);
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+
+      case Op::CAPSULE:
+      {
+        ++s;
+        const Vec3 a{c[0], c[1], c[2]}, ba = Vec3{c[3], c[4], c[5]} - a;
+        const packed ax = broadcast(a.x), ay = broadcast(a.y), az = broadcast(a.z);
+        const packed bax = broadcast(ba.x), bay = broadcast(ba.y), baz = broadcast(ba.z);
+        const scalar inv_ba2 = safe_inv(ba.norm2());
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed pax = load(f->x + i) - ax, pay = load(f->y + i) - ay, paz = load(f->z + i) - az;
+          const packed h = clamp((pax * bax + pay * bay + paz * baz) * broadcast(inv_ba2), 0, 1);
+          const packed vx = pax - bax * h, vy = pay - bay * h, vz = paz - baz * h;
+          const packed len = simd::sqrt(vx * vx + vy * vy + vz * vz);
+          store(s->d + i, len - broadcast(c[6]));
+          if (GRAD)
+          {
+            const packed inv = safe_inv(len);
+            store(s->gx + i, vx * inv);
+            store(s->gy + i, select_less(zero, len, vy * inv, one));
+            store(s->gz + i, vz * inv);
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+      }
+
+      case Op::PLANE:
+      {
+        ++s;
+        const packed nx = broadcast(c[0]), ny = broadcast(c[1]), nz = broadcast(c[2]);
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          store(s->d + i, load(f->x + i) * nx + load(f->y + i) * ny + load(f->z + i) * nz -
+                broadcast(c[3]));
+          if (GRAD)
+          {
+            store(s->gx + i, nx);
+            store(s->gy + i, ny);
+            store(s->gz + i, nz);
+          }
+        }
+        finish_primitive<GRAD>(*f, *s, lanes);
+        break;
+      }
+
+      case Op::UNION:
+      case Op::INTERSECTION:
+      case Op::DIFFERENCE:
+      {
+        Slot* a = s - 1;
+        const packed b_sign = broadcast(ins.op == Op::DIFFERENCE ? -1 : 1);
+        const bool take_min = ins.op == Op::UNION;
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          // b is taken where lo < hi: b < a for the union, b > a otherwise
+          const packed ad = load(a->d + i), b = b_sign * load(s->d + i);
+          const packed lo = take_min ? b : ad, hi = take_min ? ad : b;
+          store(a->d + i, select_less(lo, hi, b, ad));
+          if (GRAD)
+          {
+            store(a->gx + i, select_less(lo, hi, b_sign * load(s->gx + i), load(a->gx + i)));
+            store(a->gy + i, select_less(lo, hi, b_sign * load(s->gy + i), load(a->gy + i)));
+            store(a->gz + i, select_less(lo, hi, b_sign * load(s->gz + i), load(a->gz + i)));
+          }
+        }
+        --s;
+        break;
+      }
+
+      case Op::SMOOTH_UNION:
+      {
+        Slot* a = s - 1;
+        const scalar k = c[0] * f->scale;
+        const packed pk = broadcast(k), inv_k = broadcast(safe_inv(k)), half = broadcast(0.5);
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          // The terms of the blend's derivative in h cancel, leaving a mix of
+          // the gradients.
+          const packed da = load(a->d + i), db = load(s->d + i);
+          const packed h = k > 0 ? clamp(half + half * (db - da) * inv_k, 0, 1) :
+            select_less(da, db, one, zero);
+          store(a->d + i, db + (da - db) * h - pk * h * (one - h));
+          if (GRAD)
+          {
+            const packed sx = load(s->gx + i), sy = load(s->gy + i), sz = load(s->gz + i);
+            store(a->gx + i, sx + (load(a->gx + i) - sx) * h);
+            store(a->gy + i, sy + (load(a->gy + i) - sy) * h);
+            store(a->gz + i, sz + (load(a->gz + i) - sz) * h);
+          }
+        }
+        --s;
+        break;
+      }
+
+      case Op::ROUND:
+      {
+        const packed r = broadcast(c[0] * f->scale);
+        for (auto i = 0u; i < lanes; i += L)
+          store(s->d + i, load(s->d + i) - r);
+        break;
+      }
+
+      case Op::SHELL:
+      {
+        const packed t = broadcast(c[0] * f->scale);
+        for (auto i = 0u; i < lanes; i += L)
+        {
+          const packed d = load(s->d + i), sg = sign(d);
+          store(s->d + i, simd::abs(d) - t);
+          if (GRAD)
+          {
+            store(s->gx + i, load(s->gx + i) * sg);
+            store(s->gy + i, load(s->gy + i) * sg);
+            store(s->gz + i, load(s->gz + i) * sg);
+          }
+        }
+        break;
+      }
+
+      case Op::TRANSLATE:
+      case Op::ROTATE:
+      case Op::SCALE:
+      case Op::REPEAT:
+      {
+        Frame* next = f + 1;
+        next->to_world = f->to_world;
+        next->rotated = f->rotated;
+        next->scale = f->scale;
+
+        if (ins.op == Op::TRANSLATE)
+        {
+          const packed tx = broadcast(c[0]), ty = broadcast(c[1]), tz = broadcast(c[2]);
+          for (auto i = 0u; i < lanes; i += L)
+          {
+            store(next->x + i, load(f->x + i) - tx);
+            store(next->y + i, load(f->y + i) - ty);
+            store(next->z + i, load(f->z + i) - tz);
+          }
+        }
+        else if (ins.op == Op::ROTATE)
+        {
+          // the child sees points rotated back, and its gradients rotated
+          // forward
+          const Mat33 r(c, c + 9);
+          packed m[9];
+          for (int k = 0; k < 9; ++k)
+            m[k] = broadcast(r.v[k]);
+          for (auto i = 0u; i < lanes; i += L)
+          {
+            const packed x = load(f->x + i), y = load(f->y + i), z = load(f->z + i);
+            store(next->x + i, m[0] * x + m[3] * y + m[6] * z);
+            store(next->y + i, m[1] * x + m[4] * y + m[7] * z);
+            store(next->z + i, m[2] * x + m[5] * y + m[8] * z);
+          }
+          next->to_world = f->to_world * r;
+          next->rotated = true;
+        }
+        else if (ins.op == Op::SCALE)
+        {
+          const packed inv = broadcast(1 / c[0]);
+          for (auto i = 0u; i < lanes; i += L)
+          {
+            store(next->x + i, load(f->x + i) * inv);
+            store(next->y + i, load(f->y + i) * inv);
+            store(next->z + i, load(f->z + i) * inv);
+          }
+          next->scale *= c[0];
+        }
+        else
+        {
+          // simd has no floor short of SSE4.1, so this stays a plain loop
+          scalar* from[3] = {f->x, f->y, f->z};
+          scalar* to[3] = {next->x, next->y, next->z};
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            const scalar period = c[axis], inv = safe_inv(period);
+            for (auto i = 0u; i < lanes; ++i)
+              to[axis][i] = from[axis][i] - period * std::floor(from[axis][i] * inv + 0.5);
+          }
+        }
+
+        f = next;
+        break;
+      }
+
+      case Op::POP_FRAME:
+        --f;
+        break;
+      }
+    }
+
+    for (auto i = 0u; i < n; ++i)
+    {
+      values[i] = s->d[i];
+      if (GRAD)
+        grads[i] = Vec3{s->gx[i], s->gy[i], s->gz[i]};
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  shared_ptr<Geometry> make_surface(const Node& node, const bounds::AABB& bbox)
+  {
+    auto program = make_shared<const Program>(node);
+
+    // Every operation keeps distances exact or underestimated, so the
+    // Lipschitz constant stays 1.
+    return make_shared<ImplicitSurface>(
+      [=](const Vec3* points, scalar* values, uint n) { program->eval(points, values, nullptr, n); },
+      [=](const Vec3& p) { return program->gradient(p); },
+      1.0, bbox, 4);
+  }
+}
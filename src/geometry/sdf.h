@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "base.h"
+#include "bounds.h"
+#include "mat33.h"
+#include "util/optional.h"
+
+class Geometry;
+
+using std::shared_ptr;
+using std::vector;
+
+/*
+ * Signed distance functions built as graphs of primitives, CSG operations and
+ * transforms of space, instead of nested closures. A graph compiles to a
+ * Program: a flat list of instructions run by a small interpreter over
+ * batches of points, which also gives exact gradients for the normals.
+ */
+namespace sdf
+{
+  enum class Op : uint8_t
+  {
+    // primitives, evaluated at the point of the current frame
+    SPHERE,
+    BOX,
+    TORUS,
+    CYLINDER,
+    CAPSULE,
+    PLANE,
+
+    // replace the top two distances with their combination
+    UNION,
+    INTERSECTION,
+    DIFFERENCE,
+    SMOOTH_UNION,
+
+    // modify the top distance
+    ROUND,
+    SHELL,
+
+    // push a frame whose point is the current one, transformed
+    TRANSLATE,
+    ROTATE,
+    SCALE,
+    REPEAT,
+
+    POP_FRAME
+  };
+
+  class Node : public Base, public std::enable_shared_from_this<Node>
+  {
+  public:
+    Node(Op op, vector<scalar> params, vector<shared_ptr<const Node>> children = {})
+      : op(op), params(std::move(params)), children(std::move(children)) { }
+
+    std::string to_string() const override;
+
+    const Op op;
+    const vector<scalar> params;
+    const vector<shared_ptr<const Node>> children;
+  };
+
+  using NodePtr = shared_ptr<Node>;
+
+  // A sphere about the origin
+  NodePtr sphere(scalar radius);
+  NodePtr box(const Vec3& half_size);
+  // The torus about the y axis, with radius major of its ring
+  NodePtr torus(scalar major, scalar minor);
+  // The capped cylinder along the y axis, from -half_height to half_height
+  NodePtr cylinder(scalar radius, scalar half_height);
+  NodePtr capsule(const Vec3& a, const Vec3& b, scalar radius);
+  // The half-space of points p with p.dot(normal) < offset
+  NodePtr plane(const Vec3& normal, scalar offset);
+
+  NodePtr csg_union(vector<shared_ptr<const Node>> nodes);
+  NodePtr intersection(vector<shared_ptr<const Node>> nodes);
+  // The points in a but not b
+  NodePtr difference(shared_ptr<const Node> a, shared_ptr<const Node> b);
+  // A union that blends the surfaces within distance k of both
+  NodePtr smooth_union(shared_ptr<const Node> a, shared_ptr<const Node> b, scalar k);
+
+  // The node grown by radius, rounding its edges
+  NodePtr rounded(shared_ptr<const Node> node, scalar radius);
+  // A shell of the given thickness either side of the node's surface
+  NodePtr shell(shared_ptr<const Node> node, scalar thickness);
+
+  NodePtr translate(shared_ptr<const Node> node, const Vec3& offset);
+  NodePtr rotate(shared_ptr<const Node> node, const Vec3& axis, scalar angle);
+  NodePtr scale(shared_ptr<const Node> node, scalar factor);
+  // Copies of the node every period along each axis; a period of zero leaves
+  // that axis alone. The node should fit within one period, centered on the
+  // origin.
+  NodePtr repeat(shared_ptr<const Node> node, const Vec3& period);
+
+  /*
+   * The bounds of the node's interior, or none if it's unbounded.
+   */
+  optional<bounds::AABB> node_bounds(const Node& node);
+
+  class Program
+  {
+  public:
+    Program(const Node& root);
+
+    /*
+     * The distance at n points, and its gradient if grads is non-null. The
+     * interpreter runs each instruction over up to MAX_BATCH points at a
+     * time, in registers of simd::packed lanes.
+     */
+    void eval(const Vec3* points, scalar* values, Vec3* grads, uint n) const;
+
+    scalar eval(const Vec3& point) const;
+    Vec3 gradient(const Vec3& point) const;
+
+    size_t size() const { return code.size(); }
+
+    static const uint MAX_BATCH = 16;
+
+  private:
+    struct Instruction
+    {
+      Op op;
+      uint param;
+    };
+
+    void compile(const Node& node, uint depth, uint frames);
+
+    template <bool GRAD>
+    void run(const Vec3* points, scalar* values, Vec3* grads, uint n) const;
+
+    vector<Instruction> code;
+    vector<scalar> constants;
+    uint max_depth, max_frames;
+  };
+
+  /*
+   * An implicit surface for the zero set of node, within bbox.
+   */
+  shared_ptr<Geometry> make_surface(const Node& node, const bounds::AABB& bbox);
+}
@@ -18,6 +18,12 @@ scalar_fp Transformed::intersect(const Ray& r, scalar_fp max_t, SubGeo& geom) co
 {
   return geometry->intersect(tform.inv_transform_ray(r), max_t, geom);
 }
+
+bool Transformed::occluded(const Ray& r, scalar_fp max_t) const
+{
+  return geometry->occluded(tform.inv_transform_ray(r), max_t);
+}
+
 Vec3 Transformed::normal(SubGeo sub_geo, const Vec3& point) const
 {
   return tform.transform_normal( geometry->normal( sub_geo, tform.inv_transform_point(point)));
@@ -18,6 +18,8 @@ public:
 
   virtual scalar_fp intersect(const Ray& r, scalar_fp max_t, SubGeo& geo) const override;
 
+  bool occluded(const Ray& r, scalar_fp max_t) const override;
+
   virtual Vec3 normal(SubGeo sub_geo, const Vec3& point) const override;
 
   virtual bool is_differential() const override;
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include "triangle_block.h"
+
+#if FEATURE_SIMD_LEAVES && (defined(__AVX__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  /*
+   * TriangleBlock::WIDTH lanes of scalars, and the result of comparing them.
+   */
+#if FEATURE_SIMD_LEAVES && defined(USE_DOUBLES) && defined(__AVX__)
+
+  struct lanes
+  {
+    __m256d v;
+
+    static lanes load(const scalar* p) { return {_mm256_loadu_pd(p)}; }
+    static lanes broadcast(scalar x) { return {_mm256_set1_pd(x)}; }
+    void store(scalar* p) const { _mm256_storeu_pd(p, v); }
+  };
+
+  using lane_mask = lanes;
+
+  inline lanes operator +(lanes a, lanes b) { return {_mm256_add_pd(a.v, b.v)}; }
+  inline lanes operator -(lanes a, lanes b) { return {_mm256_sub_pd(a.v, b.v)}; }
+  inline lanes operator *(lanes a, lanes b) { return {_mm256_mul_pd(a.v, b.v)}; }
+  inline lanes operator /(lanes a, lanes b) { return {_mm256_div_pd(a.v, b.v)}; }
+
+  inline lane_mask operator <(lanes a, lanes b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+  inline lane_mask operator >(lanes a, lanes b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)}; }
+  inline lane_mask operator <=(lanes a, lanes b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)}; }
+  inline lane_mask operator >=(lanes a, lanes b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)}; }
+  inline lane_mask operator &(lane_mask a, lane_mask b) { return {_mm256_and_pd(a.v, b.v)}; }
+
+  inline int bits(lane_mask m) { return _mm256_movemask_pd(m.v); }
+
+#elif FEATURE_SIMD_LEAVES && defined(USE_DOUBLES) && defined(__SSE2__)
+
+  struct lanes
+  {
+    __m128d lo, hi;
+
+    static lanes load(const scalar* p) { return {_mm_loadu_pd(p), _mm_loadu_pd(p + 2)}; }
+    static lanes broadcast(scalar x) { return {_mm_set1_pd(x), _mm_set1_pd(x)}; }
+    void store(scalar* p) const { _mm_storeu_pd(p, lo); _mm_storeu_pd(p + 2, hi); }
+  };
+
+  using lane_mask = lanes;
+
+#define SSE_LANES_OP(op, intrinsic)                                       \
+  inline lanes operator op(lanes a, lanes b) { return {intrinsic(a.lo, b.lo), intrinsic(a.hi, b.hi)}; }
+
+  SSE_LANES_OP(+, _mm_add_pd)
+  SSE_LANES_OP(-, _mm_sub_pd)
+  SSE_LANES_OP(*, _mm_mul_pd)
+  SSE_LANES_OP(/, _mm_div_pd)
+  SSE_LANES_OP(<, _mm_cmplt_pd)
+  SSE_LANES_OP(>, _mm_cmpgt_pd)
+  SSE_LANES_OP(<=, _mm_cmple_pd)
+  SSE_LANES_OP(>=, _mm_cmpge_pd)
+  SSE_LANES_OP(&, _mm_and_pd)
+
+#undef SSE_LANES_OP
+
+  inline int bits(lane_mask m) { return _mm_movemask_pd(m.lo) | (_mm_movemask_pd(m.hi) << 2); }
+
+#elif FEATURE_SIMD_LEAVES && !defined(USE_DOUBLES) && defined(__AVX__)
+
+  struct lanes
+  {
+    __m256 v;
+
+    static lanes load(const scalar* p) { return {_mm256_loadu_ps(p)}; }
+    static lanes broadcast(scalar x) { return {_mm256_set1_ps(x)}; }
+    void store(scalar* p) const { _mm256_storeu_ps(p, v); }
+  };
+
+  using lane_mask = lanes;
+
+  inline lanes operator +(lanes a, lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+  inline lanes operator -(lanes a, lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+  inline lanes operator *(lanes a, lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  inline lanes operator /(lanes a, lanes b) { return {_mm256_div_ps(a.v, b.v)}; }
+
+  inline lane_mask operator <(lanes a, lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+  inline lane_mask operator >(lanes a, lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+  inline lane_mask operator <=(lanes a, lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+  inline lane_mask operator >=(lanes a, lanes b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+  inline lane_mask operator &(lane_mask a, lane_mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+
+  inline int bits(lane_mask m) { return _mm256_movemask_ps(m.v); }
+
+#elif FEATURE_SIMD_LEAVES && !defined(USE_DOUBLES) && defined(__SSE2__)
+
+  struct lanes
+  {
+    __m128 v;
+
+    static lanes load(const scalar* p) { return {_mm_loadu_ps(p)}; }
+    static lanes broadcast(scalar x) { return {_mm_set1_ps(x)}; }
+    void store(scalar* p) const { _mm_storeu_ps(p, v); }
+  };
+
+  using lane_mask = lanes;
+
+  inline lanes operator +(lanes a, lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+  inline lanes operator -(lanes a, lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+  inline lanes operator *(lanes a, lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+  inline lanes operator /(lanes a, lanes b) { return {_mm_div_ps(a.v, b.v)}; }
+
+  inline lane_mask operator <(lanes a, lanes b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+  inline lane_mask operator >(lanes a, lanes b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+  inline lane_mask operator <=(lanes a, lanes b) { return {_mm_cmple_ps(a.v, b.v)}; }
+  inline lane_mask operator >=(lanes a, lanes b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+  inline lane_mask operator &(lane_mask a, lane_mask b) { return {_mm_and_ps(a.v, b.v)}; }
+
+  inline int bits(lane_mask m) { return _mm_movemask_ps(m.v); }
+
+#else
+
+  struct lanes
+  {
+    scalar v[TriangleBlock::WIDTH];
+
+    static lanes load(const scalar* p)
+    {
+      lanes l;
+      std::copy(p, p + TriangleBlock::WIDTH, l.v);
+      return l;
+    }
+    static lanes broadcast(scalar x)
+    {
+      lanes l;
+      std::fill(l.v, l.v + TriangleBlock::WIDTH, x);
+      return l;
+    }
+    void store(scalar* p) const { std::copy(v, v + TriangleBlock::WIDTH, p); }
+  };
+
+  struct lane_mask
+  {
+    bool v[TriangleBlock::WIDTH];
+  };
+
+#define SCALAR_LANES_OP(op, result)                                     \
+  inline result operator op(lanes a, lanes b)                           \
+  {                                                                     \
+    result r;                                                           \
+    for (int i = 0; i < TriangleBlock::WIDTH; ++i)                      \
+      r.v[i] = a.v[i] op b.v[i];                                        \
+    return r;                                                           \
+  }
+
+  SCALAR_LANES_OP(+, lanes)
+  SCALAR_LANES_OP(-, lanes)
+  SCALAR_LANES_OP(*, lanes)
+  SCALAR_LANES_OP(/, lanes)
+  SCALAR_LANES_OP(<, lane_mask)
+  SCALAR_LANES_OP(>, lane_mask)
+  SCALAR_LANES_OP(<=, lane_mask)
+  SCALAR_LANES_OP(>=, lane_mask)
+
+#undef SCALAR_LANES_OP
+
+  inline lane_mask operator &(lane_mask a, lane_mask b)
+  {
+    lane_mask r;
+    for (int i = 0; i < TriangleBlock::WIDTH; ++i)
+      r.v[i] = a.v[i] && b.v[i];
+    return r;
+  }
+
+  inline int bits(lane_mask m)
+  {
+    int b = 0;
+    for (int i = 0; i < TriangleBlock::WIDTH; ++i)
+      b |= m.v[i] << i;
+    return b;
+  }
+
+#endif
+
+  /*
+   * Test the ray against every lane, storing the distance to each lane's
+   * plane in t. Returns a bit per lane hit in (EPSILON, max_t).
+   *
+   * Degenerate and empty lanes (det == 0) produce infinite or NaN
+   * barycentrics, which fail the comparisons.
+   */
+  inline int hit_lanes(const TriangleBlock& b, const Ray& ray, scalar max_t, scalar* t)
+  {
+    const auto dx = lanes::broadcast(ray.direction.x), dy = lanes::broadcast(ray.direction.y),
+      dz = lanes::broadcast(ray.direction.z);
+
+    const auto e1x = lanes::load(b.e1[0]), e1y = lanes::load(b.e1[1]), e1z = lanes::load(b.e1[2]);
+    const auto e2x = lanes::load(b.e2[0]), e2y = lanes::load(b.e2[1]), e2z = lanes::load(b.e2[2]);
+
+    // p = d x e2
+    const auto px = dy * e2z - dz * e2y, py = dz * e2x - dx * e2z, pz = dx * e2y - dy * e2x;
+
+    const auto zero = lanes::broadcast(0), one = lanes::broadcast(1);
+    const auto inv_det = one / (e1x * px + e1y * py + e1z * pz);
+
+    const auto sx = lanes::broadcast(ray.position.x) - lanes::load(b.v0[0]);
+    const auto sy = lanes::broadcast(ray.position.y) - lanes::load(b.v0[1]);
+    const auto sz = lanes::broadcast(ray.position.z) - lanes::load(b.v0[2]);
+
+    const auto u = (sx * px + sy * py + sz * pz) * inv_det;
+
+    // q = s x e1
+    const auto qx = sy * e1z - sz * e1y, qy = sz * e1x - sx * e1z, qz = sx * e1y - sy * e1x;
+
+    const auto v = (dx * qx + dy * qy + dz * qz) * inv_det;
+    const auto lane_t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+    lane_t.store(t);
+
+    return bits((u >= zero) & (v >= zero) & (u + v <= one) &
+                (lane_t > lanes::broadcast(EPSILON)) & (lane_t < lanes::broadcast(max_t)));
+  }
+}
+
+const int TriangleBlock::WIDTH;
+const uint32_t TriangleBlock::EMPTY;
+
+TriangleBlock::TriangleBlock()
+{
+  for (int k = 0; k < 3; ++k)
+  {
+    std::fill(v0[k], v0[k] + WIDTH, 0);
+    std::fill(e1[k], e1[k] + WIDTH, 0);
+    std::fill(e2[k], e2[k] + WIDTH, 0);
+  }
+  std::fill(id, id + WIDTH, EMPTY);
+}
+
+void TriangleBlock::set(int lane, uint32_t tri_id, const Vec3& p0, const Vec3& p1, const Vec3& p2)
+{
+  for (int k = 0; k < 3; ++k)
+  {
+    v0[k][lane] = p0[k];
+    e1[k][lane] = p1[k] - p0[k];
+    e2[k][lane] = p2[k] - p0[k];
+  }
+  id[lane] = tri_id;
+}
+
+scalar_fp TriangleBlock::intersect(const Ray& ray, scalar_fp max_t, int& lane) const
+{
+  scalar t[WIDTH];
+  int hits = hit_lanes(*this, ray, max_t.is() ? max_t.get() : SCALAR_MAX, t);
+  if (!hits)
+    return sfp_none;
+
+  lane = -1;
+  for (int i = 0; i < WIDTH; ++i)
+  {
+    if ((hits & (1 << i)) && (lane < 0 || t[i] < t[lane]))
+      lane = i;
+  }
+  return scalar_fp{t[lane]};
+}
+
+bool TriangleBlock::occluded(const Ray& ray, scalar_fp max_t) const
+{
+  scalar t[WIDTH];
+  return hit_lanes(*this, ray, max_t.is() ? max_t.get() : SCALAR_MAX, t) != 0;
+}
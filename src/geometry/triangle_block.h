@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include "geometry/isect_util.h"
+#include "vec3.h"
+
+/**
+ * A block of triangles stored structure-of-arrays, for testing a ray against
+ * all of them in one pass (Möller-Trumbore, one SIMD lane per triangle).
+ *
+ * With USE_DOUBLES, the block is four lanes wide: one AVX register when
+ * compiled with AVX, or two SSE2 registers otherwise. In single precision it
+ * is one register wide: eight lanes with AVX, four with SSE2. Without SSE2
+ * (or with FEATURE_SIMD_LEAVES off), four lanes are tested in a plain loop.
+ *
+ * Unused lanes have zero edges, and are never hit.
+ */
+struct TriangleBlock
+{
+#if FEATURE_SIMD_LEAVES && !defined(USE_DOUBLES) && defined(__AVX__)
+  static const int WIDTH = 8;
+#else
+  static const int WIDTH = 4;
+#endif
+  static const uint32_t EMPTY = UINT32_MAX;
+
+  TriangleBlock();
+
+  /*
+   * Fill a lane with the triangle (p0, p1, p2), identified by id.
+   */
+  void set(int lane, uint32_t id, const Vec3& p0, const Vec3& p1, const Vec3& p2);
+
+  /*
+   * Closest hit nearer than max_t; on a hit, lane is set to the lane hit.
+   */
+  scalar_fp intersect(const Ray& ray, scalar_fp max_t, int& lane) const;
+
+  bool occluded(const Ray& ray, scalar_fp max_t) const;
+
+  scalar v0[3][WIDTH];
+  scalar e1[3][WIDTH];
+  scalar e2[3][WIDTH];
+
+  uint32_t id[WIDTH];
+};
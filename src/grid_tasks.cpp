@@ -1,6 +1,10 @@
 #include "grid_tasks.h"
+#include <algorithm>
+#include <stack>
 
 using std::min;
+using std::max;
+using std::swap;
 
 vector<Film::Rect> subtasks_from_grid(uint width, uint height, const grid_subtask_options& opt)
 {
@@ -31,12 +35,16 @@ vector<Film::Rect> subtasks_from_grid(uint width, uint height, const grid_subtas
     }
   }
 
+  if (opt.order == TileOrder::HILBERT)
+    hilbert_order_tiles(subtasks, width, height);
+
   return subtasks;
 }
 
-vector<Film::Rect> subtasks_from_grid(uint width, uint height, uint num_threads)
+vector<Film::Rect> subtasks_from_grid(uint width, uint height, uint num_threads, TileOrder order)
 {
   grid_subtask_options opt;
+  opt.order = order;
 
   if (num_threads == 1)
     opt.grid_subdivision = 1;
@@ -45,3 +53,153 @@ vector<Film::Rect> subtasks_from_grid(uint width, uint height, uint num_threads)
 
   return subtasks_from_grid(width, height, opt);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t hilbert_index(uint n, uint x, uint y)
+{
+  uint64_t d = 0;
+  for (uint s = n / 2; s > 0; s /= 2)
+  {
+    uint rx = (x & s) > 0;
+    uint ry = (y & s) > 0;
+    d += uint64_t(s) * s * ((3 * rx) ^ ry);
+
+    // rotate the quadrant so the sub-curve has the canonical orientation
+    if (ry == 0)
+    {
+      if (rx == 1)
+      {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      swap(x, y);
+    }
+  }
+  return d;
+}
+
+void hilbert_order_tiles(vector<Film::Rect>& tiles, uint width, uint height)
+{
+  uint n = 1;
+  while (n < max(width, height))
+    n *= 2;
+
+  vector<std::pair<uint64_t, Film::Rect>> keyed(tiles.size());
+  std::transform(tiles.begin(), tiles.end(), keyed.begin(),
+                 [=](const auto& r)
+                 {
+                   return std::make_pair(hilbert_index(n, r.x + r.width / 2, r.y + r.height / 2), r);
+                 });
+
+  std::stable_sort(keyed.begin(), keyed.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  std::transform(keyed.begin(), keyed.end(), tiles.begin(),
+                 [](const auto& k) { return k.second; });
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  /*
+   * Summed-area table, for constant-time cost queries over rectangles.
+   */
+  class SummedArea
+  {
+  public:
+    SummedArea(const Array2D<scalar>& a) : sums(a.width() + 1, a.height() + 1)
+    {
+      for (auto y = 0u; y < a.height(); ++y)
+        for (auto x = 0u; x < a.width(); ++x)
+          sums(x+1, y+1) = a(x, y) + sums(x, y+1) + sums(x+1, y) - sums(x, y);
+    }
+
+    double total(uint x, uint y, uint w, uint h) const
+    {
+      return sums(x+w, y+h) - sums(x, y+h) - sums(x+w, y) + sums(x, y);
+    }
+
+    double total(const Film::Rect& r) const
+    {
+      return total(r.x, r.y, r.width, r.height);
+    }
+
+  private:
+    Array2D<double> sums;
+  };
+
+  /*
+   * Split r on its longer axis at the cost median, keeping at least min_size
+   * pixels on each side.
+   */
+  std::pair<Film::Rect, Film::Rect> split_at_median(const SummedArea& sat, const Film::Rect& r,
+                                                    uint min_size)
+  {
+    const bool split_x = r.width >= r.height;
+    const uint length = split_x ? r.width : r.height;
+    const double half = sat.total(r) * 0.5;
+
+    // binary search for the smallest split whose first half has at least half
+    // the cost.
+    uint lo = min_size, hi = length - min_size;
+    while (lo < hi)
+    {
+      uint mid = (lo + hi) / 2;
+      double c = split_x ? sat.total(r.x, r.y, mid, r.height) : sat.total(r.x, r.y, r.width, mid);
+      if (c < half)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (split_x)
+      return std::make_pair(Film::Rect(r.x, r.y, lo, r.height),
+                            Film::Rect(r.x + lo, r.y, r.width - lo, r.height));
+    else
+      return std::make_pair(Film::Rect(r.x, r.y, r.width, lo),
+                            Film::Rect(r.x, r.y + lo, r.width, r.height - lo));
+  }
+}
+
+vector<Film::Rect> subtasks_from_cost(const Array2D<scalar>& cost, uint threads,
+                                      const cost_subtask_options& opt)
+{
+  const uint width = cost.width(), height = cost.height();
+
+  if (threads == 1)
+    return subtasks_from_grid(width, height, threads);
+
+  SummedArea sat(cost);
+  const double total = sat.total(0, 0, width, height);
+  if (!(total > 0))
+    return subtasks_from_grid(width, height, threads, TileOrder::HILBERT);
+
+  const double budget = total / (threads * opt.tiles_per_thread);
+
+  vector<Film::Rect> tiles;
+  std::stack<Film::Rect> to_split;
+  to_split.emplace(0, 0, width, height);
+
+  while (!to_split.empty())
+  {
+    auto r = to_split.top();
+    to_split.pop();
+
+    const auto min_size = max<uint>(opt.min_tile_size, 1);
+    const bool can_split = max(r.width, r.height) >= 2 * min_size;
+    if (!can_split || sat.total(r) <= budget)
+    {
+      tiles.push_back(r);
+      continue;
+    }
+
+    auto halves = split_at_median(sat, r, min_size);
+    to_split.push(halves.first);
+    to_split.push(halves.second);
+  }
+
+  hilbert_order_tiles(tiles, width, height);
+  return tiles;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "film.h"
+#include "util/array.h"
 #include <vector>
 
 using std::vector;
@@ -13,17 +14,73 @@ enum class SubtaskGranularity
 };
 */
 
+/*
+ * Order in which the tiles of a grid are submitted.
+ */
+enum class TileOrder
+{
+  COLUMN_MAJOR,
+  HILBERT
+};
+
+/*
+ * How a render pass is split into tiles.
+ *
+ * GRID: fixed square grid, column-major order
+ * HILBERT: fixed square grid, ordered along a Hilbert curve
+ * ADAPTIVE: tiles split by the cost measured in previous passes, so that each
+ *           tile costs about the same, ordered along a Hilbert curve
+ */
+enum class TileMode
+{
+  GRID,
+  HILBERT,
+  ADAPTIVE
+};
+
 struct grid_subtask_options
 {
   uint grid_subdivision;
+  TileOrder order = TileOrder::COLUMN_MAJOR;
   //SubtaskGranularity granularity;
 };
 
+struct cost_subtask_options
+{
+  // Target number of tiles per thread. More tiles balance better, at the cost
+  // of more scheduling overhead.
+  uint tiles_per_thread = 8;
+
+  // Tiles are never split below this size in either dimension.
+  uint min_tile_size = 4;
+};
+
 /*
  * Create a set of substasks for parallel computation of a grid, that can be
  * used later for scheduling.
  */
 
 
-vector<Film::Rect> subtasks_from_grid(uint width, uint height, uint threads);
+vector<Film::Rect> subtasks_from_grid(uint width, uint height, uint threads,
+                                      TileOrder order = TileOrder::COLUMN_MAJOR);
 vector<Film::Rect> subtasks_from_grid(uint width, uint height, const grid_subtask_options& opt);
+
+/*
+ * Create subtasks from a per-pixel cost estimate, by recursively splitting the
+ * image (at the cost median of the longer axis) until every tile costs at most
+ * total / (threads * tiles_per_thread). Tiles are returned in Hilbert order.
+ */
+vector<Film::Rect> subtasks_from_cost(const Array2D<scalar>& cost, uint threads,
+                                      const cost_subtask_options& opt = cost_subtask_options());
+
+/*
+ * Sort tiles along a Hilbert curve through their centers, so that consecutive
+ * tiles are spatially coherent.
+ */
+void hilbert_order_tiles(vector<Film::Rect>& tiles, uint width, uint height);
+
+/*
+ * Index of (x, y) along the Hilbert curve filling an n x n grid, where n is a
+ * power of two.
+ */
+uint64_t hilbert_index(uint n, uint x, uint y);
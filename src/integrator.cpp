@@ -1,5 +1,6 @@
 #include "integrator.h"
 #include "util.h"
+#include "util/timer.h"
 #include <thread>
 #include <map>
 #include <chrono>
@@ -41,15 +42,22 @@ void RayIntegrator::render_rect(const Camera& cam, const Scene& scene,
 class RenderInfo
 {
 public:
-  RenderInfo(const Camera& cam_, const Scene& scene_, const Film::Rect& rect_)
-    : camera(cam_), scene(scene_), rect(rect_)
+  RenderInfo(const Camera& cam_, const Scene& scene_, Film& film_,
+             Array2D<scalar>* sample_cost_ = nullptr)
+    : camera(cam_), scene(scene_), film(film_), rect(film_.rect()),
+      sample_cost(sample_cost_)
   {
   }
   RenderInfo(const RenderInfo&) = delete;
 
   const Camera& camera;
   const Scene& scene;
+  Film& film;
   const Film::Rect rect;
+
+  // If non-null, each task records its measured time per sample here, for
+  // every pixel in its rect.
+  Array2D<scalar>* sample_cost;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -67,21 +75,40 @@ public:
   {
     UniformSampler sampler;
     sampler.seed(time_worker_seed(worker_id));
-    auto& film = get_thread_film();
+    Timer tm;
+    uint64_t total_samples = 0;
+
+    // Samples accumulate into a buffer covering only this task's rect.
+    Film tile(rect.width, rect.height);
 
     for (auto y = rect.y; y < rect.y + rect.height; ++y)
     {
       for (auto x = rect.x; x < rect.x + rect.width; ++x)
       {
         auto num_samples = samples(x, y);
+        total_samples += num_samples;
         for (auto d = 0u; d < num_samples; ++d)
         {
           auto ps = rinfo.camera.sample_pixel(rinfo.rect.width, rinfo.rect.height, x, y, sampler);
           auto s = igr.trace_ray(rinfo.scene, ps.ray, sampler);
-          film.add_sample(ps, s, 1.0);
+          ps.x -= rect.x;
+          ps.y -= rect.y;
+          tile.add_sample(ps, s, 1.0);
         }
       }
     }
+
+    // Render tasks never share pixels, so the tile (and its cost) can be
+    // committed to the shared film without locking.
+    rinfo.film.merge(tile, rect);
+
+    if (rinfo.sample_cost && total_samples > 0)
+    {
+      const scalar cost = tm.since() / total_samples;
+      for (auto y = rect.y; y < rect.y + rect.height; ++y)
+        for (auto x = rect.x; x < rect.x + rect.width; ++x)
+          (*rinfo.sample_cost)(x, y) = cost;
+    }
   }
 
 private:
@@ -94,14 +121,13 @@ private:
 template <typename Counter>
 void grid_render_by_counter(const RayIntegrator& renderer, const Camera& cam,
                             const Scene& scene, Film& film, Scheduler& scheduler,
-                            const Counter& counter)
+                            const Counter& counter, const vector<Film::Rect>& subrects,
+                            Array2D<scalar>* sample_cost = nullptr)
 {
   using std::for_each;
   using std::transform;
 
-  RenderInfo ri{cam, scene, film.rect()};
-
-  auto subrects = subtasks_from_grid(film.width, film.height, scheduler.concurrency());
+  RenderInfo ri{cam, scene, film, sample_cost};
 
   using RT = RayRenderTask<Counter>;
   vector<shared_ptr<RT>> render_tasks;
@@ -115,33 +141,83 @@ void grid_render_by_counter(const RayIntegrator& renderer, const Camera& cam,
            [&](auto& task) { scheduler.add_task(task); });
 
   scheduler.complete_pending();
+}
 
-  merge_thread_films(film);
+/*
+ * Expected cost of rendering each pixel, given the measured cost per sample
+ * and the number of samples each pixel will take.
+ */
+template <typename Counter>
+Array2D<scalar> expected_cost(const Array2D<scalar>& sample_cost, const Counter& counter)
+{
+  Array2D<scalar> cost(sample_cost.width(), sample_cost.height());
+  for (auto y = 0u; y < cost.height(); ++y)
+    for (auto x = 0u; x < cost.width(); ++x)
+      cost(x, y) = sample_cost(x, y) * counter(x, y);
+
+  return cost;
+}
+
+vector<Film::Rect> grid_subrects(const Film& film, const Scheduler& scheduler, TileMode mode)
+{
+  return subtasks_from_grid(film.width, film.height, scheduler.concurrency(),
+                            mode == TileMode::GRID ? TileOrder::COLUMN_MAJOR : TileOrder::HILBERT);
 }
 
 void grid_render(const RayIntegrator& renderer, const Camera& cam,
                  const Scene& scene, Film& film, Scheduler& scheduler,
-                 uint total_spp)
+                 uint total_spp, TileMode mode)
 {
-  grid_render_by_counter(renderer, cam, scene, film, scheduler, Identity<uint>(total_spp));
+  if (mode != TileMode::ADAPTIVE || total_spp < 2)
+  {
+    grid_render_by_counter(renderer, cam, scene, film, scheduler, Identity<uint>(total_spp),
+                           grid_subrects(film, scheduler, mode));
+    return;
+  }
+
+  // A one-sample probe pass measures the per-tile cost. Its samples are kept,
+  // and the remaining samples are split into tiles of roughly equal cost.
+  Array2D<scalar> sample_cost(film.width, film.height);
+  grid_render_by_counter(renderer, cam, scene, film, scheduler, Identity<uint>(1),
+                         grid_subrects(film, scheduler, mode), &sample_cost);
+
+  Identity<uint> remaining(total_spp - 1);
+  grid_render_by_counter(renderer, cam, scene, film, scheduler, remaining,
+                         subtasks_from_cost(expected_cost(sample_cost, remaining),
+                                            scheduler.concurrency()));
 }
 
 void pmc_render_iteration(const RayIntegrator& igr, const Camera& cam, const Scene& scene,
-                          Film& film, Scheduler& scheduler, const Array2D<uint>& samples)
+                          Film& film, Scheduler& scheduler, const Array2D<uint>& samples,
+                          Array2D<scalar>* sample_cost)
 {
-  grid_render_by_counter(igr, cam, scene, film, scheduler, samples);
+  auto subrects = sample_cost ?
+    subtasks_from_cost(expected_cost(*sample_cost, samples), scheduler.concurrency()) :
+    subtasks_from_grid(film.width, film.height, scheduler.concurrency());
+
+  grid_render_by_counter(igr, cam, scene, film, scheduler, samples, subrects, sample_cost);
 }
 
 void pmc_render(const RayIntegrator& igr, const Camera& cam, const Scene& scene,
                 Film& film,  Scheduler& scheduler, const PMCGridOptions& opt)
 {
-  grid_render(igr, cam, scene, film, scheduler, opt.initial_spp);
+  // With adaptive tiles, every pass measures its cost per sample, which is
+  // used to split the next pass.
+  Array2D<scalar> sample_cost;
+  Array2D<scalar>* cost_ptr = nullptr;
+  if (opt.tile_mode == TileMode::ADAPTIVE)
+  {
+    sample_cost.resize(film.width, film.height);
+    cost_ptr = &sample_cost;
+  }
+
+  grid_render_by_counter(igr, cam, scene, film, scheduler, Identity<uint>(opt.initial_spp),
+                         grid_subrects(film, scheduler, opt.tile_mode), cost_ptr);
 
   for (auto i = 0u; i < opt.num_iterations; ++i)
   {
     auto samples = film.samples_by_variance(opt.follow_spp);
-    film.clear();
-    pmc_render_iteration(igr, cam, scene, film, scheduler, samples);
+    pmc_render_iteration(igr, cam, scene, film, scheduler, samples, cost_ptr);
   }
 }
 
@@ -223,7 +299,5 @@ void pssmlt_render(const RayIntegrator& igr, const Camera& cam, const Scene& sce
 
   scheduler.complete_pending();
 
-  film.clear();
   merge_thread_films(film);
-
 }
@@ -44,13 +44,15 @@ public:
 
 
 void grid_render(const RayIntegrator& renderer, const Camera& cam, const Scene& scene,
-                 Film& film, Scheduler& scheduler, uint total_spp);
+                 Film& film, Scheduler& scheduler, uint total_spp,
+                 TileMode mode = TileMode::GRID);
 
 struct PMCGridOptions
 {
   uint initial_spp;
   uint follow_spp;
   uint num_iterations;
+  TileMode tile_mode = TileMode::GRID;
 };
 
 void pmc_render(const RayIntegrator&, const Camera& cam, const Scene& scene,
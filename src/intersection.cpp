@@ -3,15 +3,13 @@
 #include "geometry.h"
 
 IntersectionView::IntersectionView(const Shape* s, const SubGeo subgeo_, const Vec3& pos) :
-  position(pos), subgeo(subgeo_), shape(s)
+  position(pos), subgeo(subgeo_), shape(s), has_texture_value(false)
 {
   assert(s != nullptr);
 
   normal = s->geometry->normal(subgeo, position);
   if (s->geometry->is_differential())
     s->geometry->texture_coord(subgeo, position, normal, tc.u, tc.v);
-  to_z = Mat33::rotate_to_z(normal);
-  from_z = to_z.transpose();
 }
 
 IntersectionView::IntersectionView(const Shape* s, const SubGeo subgeo_, const Ray& r, scalar tval)
@@ -20,6 +18,16 @@ IntersectionView::IntersectionView(const Shape* s, const SubGeo subgeo_, const R
   t_ = tval;
   assert(t_ >= 0);
 }
+const spectrum& IntersectionView::texture_value() const
+{
+  if (!has_texture_value)
+  {
+    texture_value_ = shape->material->texture_value(*this);
+    has_texture_value = true;
+  }
+  return texture_value_;
+}
+
 Intersection::Intersection(const Shape* s, const SubGeo subgeo, const Vec3& pos)
   : IntersectionView(s, subgeo, pos)
 {
@@ -28,21 +36,32 @@ Intersection::Intersection(const Shape* s, const SubGeo subgeo, const Ray& r, sc
     : IntersectionView(s, subgeo, r, t_)
 {
 }
+Intersection::Intersection(const Hit& hit, const Ray& r)
+    : IntersectionView(hit.shape, hit.subgeo, r, hit.t)
+{
+}
 
 spectrum Intersection::reflectance(const Vec3& incoming, const Vec3& outgoing) const
 {
-  return shape->material->reflectance(*this, to_z * incoming, to_z * outgoing);
+  const auto f = frame();
+  return shape->material->reflectance(*this, f.to_local(incoming), f.to_local(outgoing));
 }
 
 
 MaterialSample Intersection::sample_bsdf(const Vec3& incoming, Sampler& sampler) const
 {
-  auto local_incoming = to_z * incoming;
-  auto ms = shape->material->sample_bsdf(*this, local_incoming, sampler);
-  ms.direction = from_z * ms.direction;
+  const auto f = frame();
+  auto ms = shape->material->sample_bsdf(*this, f.to_local(incoming), sampler);
+  ms.direction = f.to_world(ms.direction);
   return ms;
 }
 
+scalar Intersection::pdf(const Vec3& incoming, const Vec3& outgoing) const
+{
+  const auto f = frame();
+  return shape->material->pdf(f.to_local(incoming), f.to_local(outgoing));
+}
+
 bool Intersection::is_emissive() const
 {
   return shape->material->is_emissive(*this);
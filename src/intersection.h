@@ -3,13 +3,25 @@
 #include "ray.h"
 #include "spectrum.h"
 #include "sampler.h"
-#include "mat33.h"
+#include "frame.h"
 #include "vec2.h"
 #include "geometry.h"
 
 class Shape;
 struct MaterialSample;
 
+/**
+ * The closest hit of a ray with the scene: the shape and sub-shape hit, and
+ * the ray parameter. Cheap to find and copy, for callers that do not need any
+ * shading information.
+ */
+struct Hit
+{
+  const Shape* shape;
+  SubGeo subgeo;
+  scalar t;
+};
+
 /**
  * An IntersectionView represents the results of intersection a ray with the
  * scene. It stores relevant local information about the intersection, in
@@ -25,6 +37,21 @@ public:
 
   const Shape* get_shape_for_id() const { return shape; }
 
+  /*
+   * The shading frame around the normal, built on each call.
+   */
+  Frame frame() const
+  {
+    return Frame{normal};
+  }
+
+  /*
+   * The material's texture value here (Material::texture_value), evaluated on
+   * the first call and reused by every later reflectance, sample_bsdf and
+   * emission at this intersection.
+   */
+  const spectrum& texture_value() const;
+
   Vec3 position, normal;
   Vec2 tc;
   Vec3 dpdu, dpdv;
@@ -35,9 +62,10 @@ protected:
 
   const SubGeo subgeo;
   const Shape* shape;
-  Mat33 to_z;
-  Mat33 from_z;
   scalar t_;
+
+  mutable bool has_texture_value;
+  mutable spectrum texture_value_;
 };
 
 /**
@@ -49,11 +77,17 @@ class Intersection : public IntersectionView
 public:
   Intersection(const Shape* s, const SubGeo subgeo, const Vec3& pos);
   Intersection(const Shape* s, const SubGeo subgeo, const Ray& r, scalar t_);
+  Intersection(const Hit& hit, const Ray& r);
 
   spectrum reflectance(const Vec3& incoming, const Vec3& outgoing) const;
 
   MaterialSample sample_bsdf(const Vec3& incoming, Sampler& sampler) const;
 
+  /*
+   * The material's density for sample_bsdf choosing outgoing.
+   */
+  scalar pdf(const Vec3& incoming, const Vec3& outgoing) const;
+
 
   bool is_emissive() const;
 
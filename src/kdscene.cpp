@@ -7,7 +7,7 @@ using std::numeric_limits;
 using std::min;
 using std::make_unique;
 
-KDScene::KDScene() : env_light_(nullptr)
+KDScene::KDScene(AccelType accel) : accel_type_(accel), env_light_(nullptr)
 {
 }
 
@@ -34,7 +34,26 @@ void KDScene::prepare()
     else
       unbounded_shapes_.push_back(shape);
   }
-  shape_tree_ = make_unique<kd::Tree<Shape>>(bounded_shapes, kd::TreeOptions());
+  shape_tree_ = make_unique<Accelerator<Shape>>(bounded_shapes, accel_type_);
+
+  for (const auto& shape: shape_vector_)
+  {
+    auto light = make_area_light(shape);
+    if (light)
+    {
+      lights_.push_back(light.get());
+      shape_lights_[shape] = light.get();
+      area_lights_.push_back(move(light));
+    }
+  }
+
+  light_tree_ = LightTree(lights_);
+}
+
+const Light* KDScene::area_light(const Shape* shape) const
+{
+  const auto it = shape_lights_.find(shape);
+  return it == shape_lights_.end() ? nullptr : it->second;
 }
 
 const vector<const Light*>& KDScene::lights() const
@@ -57,6 +76,17 @@ Light const* KDScene::sample_light(scalar r1, scalar& light_prob) const
   return lights_[min(max_light_idx, decltype(max_light_idx)(r1 * lights_.size()))];
 }
 
+Light const* KDScene::sample_light(const IntersectionView& isect, scalar r1,
+                                   scalar& light_prob) const
+{
+  return light_tree_.sample(isect.position, isect.normal, r1, light_prob);
+}
+
+scalar KDScene::light_pmf(const IntersectionView& isect, const Light* light) const
+{
+  return light_tree_.pmf(isect.position, isect.normal, light);
+}
+
 EmissionSample KDScene::sample_emission(Sampler& sampler) const
 {
   scalar lp = 0;
@@ -72,7 +102,7 @@ EmissionSample KDScene::sample_emission(Sampler& sampler) const
   return es;
 }
 
-optional<Intersection> KDScene::intersect(const Ray& ray, scalar_fp max_t) const
+optional<Hit> KDScene::closest_hit(const Ray& ray, scalar_fp max_t) const
 {
   /*
    * In most scenes, you expect the infinite objects to behind the finite
@@ -110,11 +140,25 @@ optional<Intersection> KDScene::intersect(const Ray& ray, scalar_fp max_t) const
 
   }
   if (best_t.is())
-    return Intersection(best_shape, best_geom, ray, best_t.get());
+    return Hit{best_shape, best_geom, best_t.get()};
 
   return none_tag;
 }
 
+bool KDScene::occluded(const Ray& ray, scalar_fp max_t) const
+{
+  if (shape_tree_->occluded(ray, max_t))
+    return true;
+
+  for (auto s: unbounded_shapes_)
+  {
+    if (s->occluded(ray, max_t))
+      return true;
+  }
+
+  return false;
+}
+
 spectrum KDScene::environment_light_emission(const Vec3& dir) const
 {
   return env_light_ ? env_light_->emission(dir) : spectrum::zero;
@@ -1,14 +1,22 @@
 #pragma once
 
 #include "scene.h"
-#include "kdtree.h"
+#include "accel.h"
+#include "light_tree.h"
+#include "area_light.h"
+#include <unordered_map>
 
 using std::unique_ptr;
 
 class KDScene : public Scene
 {
 public:
-  KDScene();
+  KDScene(AccelType accel = AccelType::KD_TREE);
+
+  /*
+   * Choose the acceleration structure built by prepare().
+   */
+  void set_accelerator(AccelType accel) { accel_type_ = accel; }
 
   void add(const Shape*) override;
   void add(const Light*) override;
@@ -16,12 +24,18 @@ public:
   void prepare() override;
 
   Light const* sample_light(scalar r1, scalar&) const override;
+  Light const* sample_light(const IntersectionView& isect, scalar r1,
+                            scalar& light_prob) const override;
+  scalar light_pmf(const IntersectionView& isect, const Light* light) const override;
   EmissionSample sample_emission(Sampler& sampler) const override;
+  const Light* area_light(const Shape* shape) const override;
 
-  optional<Intersection> intersect(const Ray& ray, scalar_fp max_t) const override;
-  using Scene::intersect;
+  optional<Hit> closest_hit(const Ray& ray, scalar_fp max_t) const override;
+
+  bool occluded(const Ray& ray, scalar_fp max_t) const override;
 
   spectrum environment_light_emission(const Vec3& dir) const override;
+  const EnvironmentLight* environment_light() const override { return env_light_; }
 
   const vector<const Light*>& lights() const override;
 
@@ -35,8 +49,14 @@ private:
   vector<const Shape*> shape_vector_;
 
   vector<const Shape*> unbounded_shapes_;
-  unique_ptr<kd::Tree<Shape>> shape_tree_;
+  AccelType accel_type_;
+  unique_ptr<Accelerator<Shape>> shape_tree_;
 
   vector<const Light*> lights_;
+  LightTree light_tree_;
+
+  // lights made by prepare() for the emissive shapes
+  vector<unique_ptr<AreaLight>> area_lights_;
+  std::unordered_map<const Shape*, const Light*> shape_lights_;
   const EnvironmentLight* env_light_;
 };
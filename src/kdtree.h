@@ -1,8 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #include <vector>
 #include <stack>
+#include <array>
 #include <type_traits>
 #include "bounds.h"
 #include "geometry.h"
@@ -23,11 +25,40 @@ using std::stack;
  * It uses the SAH heuristic, empty-node cost discounts, and an adpative
  * sampling method for quickly choosing the near-optimal splitting plane heuristic.
  */
+class Scheduler;
+
 namespace kd
 {
   template <typename T>
   class Node;
 
+  /*
+   * Nodes and leaf indices produced while building a (sub)tree. Subtrees built
+   * by separate tasks each fill their own storage, which is then spliced into
+   * the tree's.
+   */
+  template <typename T>
+  struct BuildStorage
+  {
+    using obj_index = uint32_t;
+
+    vector<Node<T>> nodes;
+    vector<obj_index> indices;
+
+    /*
+     * When non-zero, child subtrees with at most defer_limit elements are
+     * queued in jobs rather than built in place.
+     */
+    size_t defer_limit = 0;
+    vector<subtree_job> jobs;
+
+    // scheduler for searching split axes in parallel, if any
+    Scheduler* scheduler = nullptr;
+
+    uint add_nodes(const Node<T>&, const Node<T>&);
+    uint32_t add_node_indices(const vector<obj_index>&);
+  };
+
   template <typename T>
   class Tree
   {
@@ -37,10 +68,48 @@ namespace kd
     using obj_index = uint32_t;
     using element_offset_t = uint32_t;
 
+    // padding between leaf index ranges
+    static const obj_index EMPTY_INDEX = UINT32_MAX;
+
     Tree(const vector<element_type>& objects, const TreeOptions& opt);
 
     scalar_fp intersect(const Ray& ray, const scalar_fp max_t, element_type& geom, SubGeo& subgeo) const;
 
+    /*
+     * As intersect, calling visit(const node_type*) on every node traversed.
+     */
+    template <typename Visit>
+    scalar_fp intersect(const Ray& ray, const scalar_fp max_t, element_type& geom, SubGeo& subgeo,
+                        Visit&& visit) const;
+
+    /*
+     * True if any element is hit before max_t. Traversal stops at the first
+     * hit found, in any order.
+     */
+    bool occluded(const Ray& ray, const scalar_fp max_t) const;
+
+    /*
+     * Closest-hit and any-hit traversals with custom leaf tests, for callers
+     * that keep their own per-leaf data. leaf_intersect(leaf, max_t) returns
+     * the closest hit in the leaf nearer than max_t, and leaf_occluded(leaf)
+     * whether any element in the leaf is hit before the query's max_t. Leaves
+     * refer to leaf_indices()[leaf.offset(), leaf.offset() + leaf.num_objects()).
+     */
+    template <typename LeafIntersect, typename Visit>
+    scalar_fp intersect_leaves(const Ray& ray, const scalar_fp max_t, LeafIntersect&& leaf_intersect,
+                               Visit&& visit) const;
+
+    template <typename LeafIntersect>
+    scalar_fp intersect_leaves(const Ray& ray, const scalar_fp max_t, LeafIntersect&& leaf_intersect) const
+    {
+      return intersect_leaves(ray, max_t, leaf_intersect, [](const node_type*) { });
+    }
+
+    template <typename LeafOccluded>
+    bool occluded_leaves(const Ray& ray, const scalar_fp max_t, LeafOccluded&& leaf_occluded) const;
+
+    const vector<obj_index>& leaf_indices() const { return indices; }
+
     auto get_bounding_box() const { return bound; }
 
     int height() const
@@ -57,6 +126,15 @@ namespace kd
       return root->count_objects(*this);
     }
 
+    /*
+     * Bytes used by the nodes and element references.
+     */
+    size_t memory_usage() const
+    {
+      return node_storage.size() * sizeof(node_type) + indices.size() * sizeof(obj_index) +
+        elements.size() * sizeof(element_type);
+    }
+
   private:
     vector<element_type> elements;
     vector<obj_index> indices;
@@ -64,9 +142,38 @@ namespace kd
     scalar_fp leaf_intersect(const Node<T>& leaf,
                              const Ray& ray, scalar_fp max_t, element_type& obj, SubGeo& geo) const;
 
-    element_offset_t add_node_indices(const vector<obj_index>&);
+    /*
+     * Walk the leaves pierced by the ray front to back, until
+     * leaf_test(leaf, t0, t1) returns true. Returns whether it did.
+     */
+    template <typename LeafTest, typename Visit>
+    bool traverse(const Ray& ray, const scalar_fp max_t, LeafTest&& leaf_test, Visit&& visit) const;
+
+    /*
+     * Build the deferred subtrees of storage as tasks on scheduler, and splice
+     * them into storage.
+     */
+    static void build_subtrees(BuildStorage<T>& storage, Scheduler& scheduler,
+                               const TreeOptions& opt);
+
+    /*
+     * Reorder node_storage into cache-line sized clusters of sibling pairs.
+     * Each cluster is grown best-first from its top pair, by the surface area
+     * of the pairs' parents (the SAH probability of traversing them), so the
+     * likely paths through a subtree are read with one or two line fetches.
+     * Child clusters follow their parent depth-first, and leaf indices are
+     * stored in the new node order.
+     */
+    void cluster_nodes();
+
+    /*
+     * Rewrite indices in node order, padding with EMPTY_INDEX so that every
+     * leaf range (and the whole array) starts at a multiple of block_size.
+     */
+    void pack_leaf_indices(uint block_size);
+
+    static const size_t CACHE_LINE_SIZE = 64;
 
-    uint add_nodes(const node_type&, const node_type&);
     const node_type* get_node(int offset) const { return &node_storage[offset]; }
     node_type* get_node(int offset) { return &node_storage[offset]; }
 
@@ -99,12 +206,18 @@ namespace kd
 
   private:
 
-    Node(Tree<T>& _parent,
+    Node(BuildStorage<T>& storage,
          const vector<element_index>& objects,
          const vector<bounds::AABB>& boxes,
          const bounds::AABB& total_bound,
          const TreeOptions& opt);
 
+    /*
+     * Shift the offsets of a node built in a separate storage, after that
+     * storage is appended at node_base and index_base.
+     */
+    void relocate(uint node_base, uint index_base);
+
     /**
      * construction methods
      **/
@@ -127,8 +240,32 @@ namespace kd
 
     static pair<scalar, scalar> child_areas(const bounds::AABB& bound, const split_plane& sp);
 
-    void make_leaf(Tree<T>&, const vector<element_index>& objects);
-    void make_split(Tree<T>&, const vector<element_index>& objects,
+    /**
+     * sweep construction (BuildMode::SWEEP)
+     */
+    using event_lists = std::array<vector<split_event>, 3>;
+
+    struct sweep_state
+    {
+      // elements of the subtree, and their boxes, by local index
+      const vector<element_index>& objects;
+      const vector<bounds::AABB>& boxes;
+
+      // scratch space for classifying elements against a split
+      vector<uint8_t> side;
+    };
+
+    void make_sweep(BuildStorage<T>&, const vector<element_index>& objects,
+                    const vector<bounds::AABB>& boxes, const bounds::AABB& bound,
+                    const TreeOptions& opt);
+
+    void sweep_node(BuildStorage<T>&, sweep_state& state, event_lists& events,
+                    const bounds::AABB& voxel, const TreeOptions& opt);
+
+    static void add_events(event_lists& events, uint32_t element, const bounds::AABB& box);
+
+    void make_leaf(BuildStorage<T>&, const vector<element_index>& objects);
+    void make_split(BuildStorage<T>&, const vector<element_index>& objects,
                     const vector<bounds::AABB>& boxes,
                     const bounds::AABB& bound, const split_plane& plane,
                     const TreeOptions& opt);
@@ -2,10 +2,12 @@
 #include <iterator>
 #include <memory>
 #include <cassert>
+#include <cstdint>
 #include <stack>
 #include <numeric>
 #include "kdtree.h"
 #include "math_util.h"
+#include "scheduler.h"
 
 using std::max_element;
 using std::make_unique;
@@ -22,16 +24,22 @@ using std::endl;
 namespace kd
 {
   template <typename T>
-  Node<T>::Node(Tree<T>& owner,
+  Node<T>::Node(BuildStorage<T>& storage,
                 const vector<element_index>& objects,
                 const vector<bounds::AABB>& boxes,
                 const bounds::AABB& total_bound, const TreeOptions& opt)
   {
     static_assert( sizeof(*this) == 8, "kd::Node is incorrect size" );
+    if (opt.build_mode == BuildMode::SWEEP)
+    {
+      make_sweep(storage, objects, boxes, total_bound, opt);
+      return;
+    }
+
     const auto num_boxes = boxes.size();
     if (num_boxes <= opt.max_elements_per_leaf)
     {
-      make_leaf(owner, objects);
+      make_leaf(storage, objects);
       return;
     }
 
@@ -42,20 +50,42 @@ namespace kd
 
     pair<scalar, split_plane> best_split = make_pair(SCALAR_MAX, split_plane{0, X});
 
-    // Search some subset of the axes for the best split plane.
-    for (int ai = 0; ai < 3; ++ai)
+    auto search_axis = [&](int ai)
     {
-      if (bb_size[ai] == 0)
-        continue;
-
-      if (num_boxes > opt.hybrid_one_axis_limit && ai != longest_axis)
-        continue;
-
-      auto x = num_boxes <= opt.exact_evaluation_limit ?
+      return num_boxes <= opt.exact_evaluation_limit ?
         best_plane_exhaustive(ai, boxes, total_bound, sa, opt) :
         best_plane_adaptive(ai, boxes, total_bound, sa, opt);
+    };
+
+    // Search some subset of the axes for the best split plane: only the
+    // longest, above the hybrid limit.
+    auto searched = [&](int ai)
+    {
+      return bb_size[ai] != 0 && (num_boxes <= opt.hybrid_one_axis_limit || ai == longest_axis);
+    };
+
+    if (storage.scheduler)
+    {
+      // Near the top of a parallel build, search the axes at once.
+      pair<scalar, split_plane> axis_best[3] = {best_split, best_split, best_split};
+      vector<std::function<void()>> searches;
+      for (int ai = 0; ai < 3; ++ai)
+      {
+        if (searched(ai))
+          searches.push_back([&, ai]() { axis_best[ai] = search_axis(ai); });
+      }
+      run_jobs(*storage.scheduler, searches);
 
-      best_split = min(x, best_split);
+      for (int ai = 0; ai < 3; ++ai)
+        best_split = min(axis_best[ai], best_split);
+    }
+    else
+    {
+      for (int ai = 0; ai < 3; ++ai)
+      {
+        if (searched(ai))
+          best_split = min(search_axis(ai), best_split);
+      }
     }
 
     const scalar no_split_cost = opt.empty_side_discount * num_boxes;
@@ -66,13 +96,13 @@ namespace kd
       // std::cerr << "cost of best split " << best_split.second << " = "
       // << best_split.first << " beats no split cost of "
       //           << no_split_cost << std::endl;
-      make_split(owner, objects, boxes, total_bound, best_split.second, opt);
+      make_split(storage, objects, boxes, total_bound, best_split.second, opt);
     }
     else
     {
       // cout << "cost " << best_split.first << " exceeds number of boxes "
       //      << num_boxes << "\n";
-      make_leaf(owner, objects);
+      make_leaf(storage, objects);
     }
   }
 
@@ -284,19 +314,293 @@ namespace kd
     return split_eval{sp.split, cost, static_cast<scalar>(num_left - num_right)};
   }
 
+////////////////////////////////////////////////////////////////////////////////
+
+  template <typename T>
+  void Node<T>::add_events(event_lists& events, uint32_t element, const bounds::AABB& box)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      if (box.min()[k] == box.max()[k])
+        events[k].push_back(split_event{box.min()[k], element, split_event::PLANAR});
+      else
+      {
+        events[k].push_back(split_event{box.min()[k], element, split_event::START});
+        events[k].push_back(split_event{box.max()[k], element, split_event::END});
+      }
+    }
+  }
+
+  /*
+   * Sort the split events of every element once, then build the subtree.
+   */
+  template <typename T>
+  void Node<T>::make_sweep(BuildStorage<T>& storage, const vector<element_index>& objects,
+                           const vector<bounds::AABB>& boxes, const bounds::AABB& bound,
+                           const TreeOptions& opt)
+  {
+    event_lists events;
+    for (auto i = 0u; i < boxes.size(); ++i)
+      add_events(events, i, boxes[i]);
+    for (auto& axis_events : events)
+      std::sort(axis_events.begin(), axis_events.end());
+
+    sweep_state state{objects, boxes, vector<uint8_t>(objects.size())};
+    sweep_node(storage, state, events, bound, opt);
+  }
+
+  template <typename T>
+  void Node<T>::sweep_node(BuildStorage<T>& storage, sweep_state& state, event_lists& events,
+                           const bounds::AABB& voxel, const TreeOptions& opt)
+  {
+    // Every element has exactly one start or planar event per axis.
+    auto count_elements = [](const vector<split_event>& axis_events)
+    {
+      return size_t(std::count_if(axis_events.begin(), axis_events.end(),
+                                  [](const auto& e) { return e.type != split_event::END; }));
+    };
+    auto element_indices = [&](const vector<split_event>& axis_events)
+    {
+      vector<element_index> indices;
+      for (const auto& e : axis_events)
+        if (e.type != split_event::END)
+          indices.push_back(state.objects[e.element]);
+      return indices;
+    };
+
+    const uint num_elements = count_elements(events[0]);
+    if (num_elements <= opt.max_elements_per_leaf)
+    {
+      make_leaf(storage, element_indices(events[0]));
+      return;
+    }
+
+    /*
+     * 1. Sweep each axis for the split with the lowest SAH cost. Elements
+     * lying in a candidate plane are put on whichever side is cheaper.
+     */
+    struct sweep_result
+    {
+      scalar cost;
+      split_plane plane;
+      bool planar_left;
+    };
+
+    const scalar sa = voxel.surface_area();
+    const auto voxel_size = voxel.size();
+
+    auto sweep_axis = [&](int k)
+    {
+      sweep_result best{SCALAR_MAX, split_plane{0, NodeAxis(k)}, true};
+      if (voxel_size[k] <= 0)
+        return best;
+
+      auto split_cost = [&](scalar sa_left, scalar sa_right, uint nl, uint nr)
+      {
+        scalar cost = opt.self_traversal_cost + (nl * sa_left + nr * sa_right) / sa;
+        return (nl == 0 || nr == 0) ? cost * opt.empty_side_discount : cost;
+      };
+
+      const auto& axis_events = events[k];
+      uint nl = 0, nr = num_elements;
+      for (auto i = 0u; i < axis_events.size(); )
+      {
+        const scalar pos = axis_events[i].pos;
+        uint num_end = 0, num_planar = 0, num_start = 0;
+        for (; i < axis_events.size() && axis_events[i].pos == pos &&
+               axis_events[i].type == split_event::END; ++i)
+          ++num_end;
+        for (; i < axis_events.size() && axis_events[i].pos == pos &&
+               axis_events[i].type == split_event::PLANAR; ++i)
+          ++num_planar;
+        for (; i < axis_events.size() && axis_events[i].pos == pos &&
+               axis_events[i].type == split_event::START; ++i)
+          ++num_start;
+
+        nr -= num_planar + num_end;
+        if (voxel.min()[k] < pos && pos < voxel.max()[k])
+        {
+          const split_plane sp{pos, NodeAxis(k)};
+          scalar sa_left, sa_right;
+          tie(sa_left, sa_right) = child_areas(voxel, sp);
+
+          const scalar left_cost = split_cost(sa_left, sa_right, nl + num_planar, nr);
+          const scalar right_cost = split_cost(sa_left, sa_right, nl, nr + num_planar);
+          if (left_cost < best.cost)
+            best = sweep_result{left_cost, sp, true};
+          if (right_cost < best.cost)
+            best = sweep_result{right_cost, sp, false};
+        }
+        nl += num_start + num_planar;
+      }
+      return best;
+    };
+
+    sweep_result axis_best[3];
+    if (storage.scheduler)
+    {
+      vector<std::function<void()>> sweeps;
+      for (int k = 0; k < 3; ++k)
+        sweeps.push_back([&, k]() { axis_best[k] = sweep_axis(k); });
+      run_jobs(*storage.scheduler, sweeps);
+    }
+    else
+    {
+      for (int k = 0; k < 3; ++k)
+        axis_best[k] = sweep_axis(k);
+    }
+
+    auto best = *std::min_element(axis_best, axis_best + 3,
+                                  [](const auto& a, const auto& b) { return a.cost < b.cost; });
+
+    if (best.cost >= opt.empty_side_discount * num_elements)
+    {
+      make_leaf(storage, element_indices(events[0]));
+      return;
+    }
+
+    /*
+     * 2. Classify the elements against the split plane, using the events on
+     * its axis.
+     */
+    enum : uint8_t { BOTH, LEFT, RIGHT };
+    const auto& sp = best.plane;
+    const int k = sp.axis;
+
+    for (const auto& e : events[k])
+      state.side[e.element] = BOTH;
+    for (const auto& e : events[k])
+    {
+      if (e.type == split_event::END && e.pos <= sp.split)
+        state.side[e.element] = LEFT;
+      else if (e.type == split_event::START && e.pos >= sp.split)
+        state.side[e.element] = RIGHT;
+      else if (e.type == split_event::PLANAR)
+      {
+        if (e.pos == sp.split)
+          state.side[e.element] = best.planar_left ? LEFT : RIGHT;
+        else
+          state.side[e.element] = e.pos < sp.split ? LEFT : RIGHT;
+      }
+    }
+
+    /*
+     * 3. Split the event lists. Events of elements on one side keep their
+     * order; elements straddling the plane get new events from their boxes
+     * clipped to each child, which are sorted and merged in.
+     */
+    auto left_voxel = voxel, right_voxel = voxel;
+    left_voxel.max()[k] = sp.split;
+    right_voxel.min()[k] = sp.split;
+
+    auto clip = [](const bounds::AABB& box, const bounds::AABB& v)
+    {
+      return bounds::AABB(::max(box.min(), v.min()), ::min(box.max(), v.max()));
+    };
+
+    event_lists left_events, right_events, left_new, right_new;
+    for (const auto& e : events[k])
+    {
+      if (e.type == split_event::START && state.side[e.element] == BOTH)
+      {
+        add_events(left_new, e.element, clip(state.boxes[e.element], left_voxel));
+        add_events(right_new, e.element, clip(state.boxes[e.element], right_voxel));
+      }
+    }
+
+    for (int j = 0; j < 3; ++j)
+    {
+      for (const auto& e : events[j])
+      {
+        if (state.side[e.element] == LEFT)
+          left_events[j].push_back(e);
+        else if (state.side[e.element] == RIGHT)
+          right_events[j].push_back(e);
+      }
+      vector<split_event>().swap(events[j]);
+
+      for (auto lists : {make_pair(&left_events[j], &left_new[j]),
+            make_pair(&right_events[j], &right_new[j])})
+      {
+        auto& merged = *lists.first;
+        auto& added = *lists.second;
+        std::sort(added.begin(), added.end());
+        const auto middle = merged.size();
+        merged.insert(merged.end(), added.begin(), added.end());
+        std::inplace_merge(merged.begin(), merged.begin() + middle, merged.end());
+      }
+    }
+
+    /*
+     * 4. Build the children, deferring small subtrees to jobs in parallel
+     * builds.
+     */
+    this->inner.plane_split = sp.split;
+    this->inner.plane_axis = sp.axis;
+
+    auto build_child = [&](event_lists& child_events, const bounds::AABB& child_voxel, int& job)
+    {
+      job = -1;
+      const auto child_count = count_elements(child_events[0]);
+      if (child_count <= storage.defer_limit && child_count > opt.max_elements_per_leaf)
+      {
+        subtree_job j{vector<uint32_t>(), vector<bounds::AABB>(), child_voxel, 0};
+        for (const auto& e : child_events[0])
+        {
+          if (e.type == split_event::END)
+            continue;
+          j.objects.push_back(state.objects[e.element]);
+          j.boxes.push_back(clip(state.boxes[e.element], child_voxel));
+        }
+        job = storage.jobs.size();
+        storage.jobs.push_back(std::move(j));
+
+        Node placeholder;
+        placeholder.leaf = leaf_t{0, 0, NONE};
+        return placeholder;
+      }
+
+      Node child;
+      child.sweep_node(storage, state, child_events, child_voxel, opt);
+      return child;
+    };
+
+    int left_job, right_job;
+    Node left = build_child(left_events, left_voxel, left_job);
+    Node right = build_child(right_events, right_voxel, right_job);
+
+    inner.left_offset = storage.add_nodes(left, right);
+
+    if (left_job >= 0)
+      storage.jobs[left_job].slot = left_offset();
+    if (right_job >= 0)
+      storage.jobs[right_job].slot = right_offset();
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
   /*
    * Store the indices in the owning tree
    */
   template <typename T>
-  void Node<T>::make_leaf(Tree<T>& owner, const vector<element_index>& objects)
+  void Node<T>::make_leaf(BuildStorage<T>& storage, const vector<element_index>& objects)
   {
     leaf.num_objects = objects.size();
-    leaf.offset = owner.add_node_indices(objects);
+    leaf.offset = storage.add_node_indices(objects);
     leaf.split = NONE;
   }
 
   template <typename T>
-  void Node<T>::make_split(Tree<T>& owner,
+  void Node<T>::relocate(uint node_base, uint index_base)
+  {
+    if (is_leaf())
+      leaf.offset += index_base;
+    else
+      inner.left_offset += node_base;
+  }
+
+  template <typename T>
+  void Node<T>::make_split(BuildStorage<T>& storage,
                            const vector<element_index>& objects, const vector<bounds::AABB>& boxes,
                            const bounds::AABB& bound, const split_plane& sp,
                            const TreeOptions& opt)
@@ -336,10 +640,36 @@ namespace kd
       }
     }
 
-    Node left(owner, left_objects, left_boxes, left_bound, opt);
-    Node right(owner, right_objects, right_boxes, right_bound, opt);
+    // Children small enough are queued as jobs, and built once the top of the
+    // tree is done.
+    auto build_child = [&](vector<element_index>& child_objects,
+                           vector<bounds::AABB>& child_boxes,
+                           const bounds::AABB& child_bound, int& job)
+    {
+      job = -1;
+      if (child_objects.size() <= storage.defer_limit &&
+          child_objects.size() > opt.max_elements_per_leaf)
+      {
+        job = storage.jobs.size();
+        storage.jobs.push_back(subtree_job{std::move(child_objects), std::move(child_boxes),
+                                           child_bound, 0});
+        Node placeholder;
+        placeholder.leaf = leaf_t{0, 0, NONE};
+        return placeholder;
+      }
+      return Node(storage, child_objects, child_boxes, child_bound, opt);
+    };
+
+    int left_job, right_job;
+    Node left = build_child(left_objects, left_boxes, left_bound, left_job);
+    Node right = build_child(right_objects, right_boxes, right_bound, right_job);
+
+    inner.left_offset = storage.add_nodes(left, right);
 
-    inner.left_offset = owner.add_nodes(left, right);
+    if (left_job >= 0)
+      storage.jobs[left_job].slot = left_offset();
+    if (right_job >= 0)
+      storage.jobs[right_job].slot = right_offset();
   }
 
   template <typename T>
@@ -348,6 +678,9 @@ namespace kd
   }
 
 ////////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  const typename Tree<T>::obj_index Tree<T>::EMPTY_INDEX;
+
   template <typename T>
   Tree<T>::Tree(const vector<element_type>& objects, const TreeOptions& opt) :
     root(nullptr), bound(Vec3::zero, Vec3::zero), _height(0)
@@ -376,39 +709,324 @@ namespace kd
         }
       }
 
-      root = unique_ptr<node_type>(new node_type(*this, indices, boxes, bound, opt));
+      BuildStorage<T> storage;
+
+      // Large trees are built in parallel: the top of the tree on this thread
+      // (with parallel axis searches), and the subtrees below it as tasks.
+      auto scheduler = build_scheduler();
+      const bool parallel = scheduler && scheduler->concurrency() > 1 &&
+        objects.size() >= opt.parallel_build_limit;
+      if (parallel)
+      {
+        storage.scheduler = scheduler;
+        storage.defer_limit = std::max<size_t>(
+          1, objects.size() / (opt.subtrees_per_thread * scheduler->concurrency()));
+      }
+
+      root = unique_ptr<node_type>(new node_type(storage, indices, boxes, bound, opt));
+
+      if (parallel)
+        build_subtrees(storage, *scheduler, opt);
+
+      node_storage = move(storage.nodes);
+      this->indices = move(storage.indices);
+      if (opt.cache_layout)
+        cluster_nodes();
+      if (opt.cache_layout || opt.leaf_block_size > 1)
+        pack_leaf_indices(std::max<uint>(1, opt.leaf_block_size));
       _height = root->height(*this);
     }
   }
 
   template <typename T>
-  uint Tree<T>::add_nodes(const Node<T>& left, const Node<T>& right)
+  void Tree<T>::build_subtrees(BuildStorage<T>& storage, Scheduler& scheduler,
+                               const TreeOptions& opt)
   {
-    size_t offset = node_storage.size();
-    node_storage.push_back(left);
-    node_storage.push_back(right);
+    auto& jobs = storage.jobs;
+    vector<BuildStorage<T>> results(jobs.size());
+    vector<Node<T>> roots(jobs.size());
+
+    // Start the largest subtrees first, so they don't finish last.
+    vector<uint> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint a, uint b)
+              {
+                return jobs[a].objects.size() > jobs[b].objects.size();
+              });
+
+    vector<std::function<void()>> builds;
+    for (auto i : order)
+    {
+      builds.push_back([&, i]()
+      {
+        auto& job = jobs[i];
+        roots[i] = Node<T>(results[i], job.objects, job.boxes, job.bound, opt);
+        job.objects = vector<uint32_t>();
+        job.boxes = vector<bounds::AABB>();
+      });
+    }
+    run_jobs(scheduler, builds);
+
+    for (auto i = 0u; i < jobs.size(); ++i)
+    {
+      const uint node_base = storage.nodes.size();
+      const uint index_base = storage.indices.size();
+
+      for (auto node : results[i].nodes)
+      {
+        node.relocate(node_base, index_base);
+        storage.nodes.push_back(node);
+      }
+      storage.indices.insert(storage.indices.end(),
+                             results[i].indices.begin(), results[i].indices.end());
+
+      roots[i].relocate(node_base, index_base);
+      storage.nodes[jobs[i].slot] = roots[i];
+    }
+
+    jobs.clear();
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  template <typename T>
+  uint BuildStorage<T>::add_nodes(const Node<T>& left, const Node<T>& right)
+  {
+    size_t offset = nodes.size();
+    nodes.push_back(left);
+    nodes.push_back(right);
     return offset;
   }
 
   template <typename T>
-  auto Tree<T>::add_node_indices(const vector<obj_index>& node_indices) -> element_offset_t
+  uint32_t BuildStorage<T>::add_node_indices(const vector<obj_index>& node_indices)
   {
     auto offset = indices.size();
     std::copy(node_indices.begin(), node_indices.end(), std::inserter(indices, indices.end()));
     return offset;
   }
 
+  template <typename T>
+  void Tree<T>::cluster_nodes()
+  {
+    if (root->is_leaf())
+      return;
+
+    const uint pair_size = 2 * sizeof(node_type);
+    const uint pairs_per_line = std::max<uint>(1, CACHE_LINE_SIZE / pair_size);
+
+    // A pair of siblings, by the offset of its left node, and the voxel of
+    // its parent.
+    struct pending_pair
+    {
+      uint offset;
+      bounds::AABB voxel;
+      scalar area;
+    };
+    auto make_pending = [](uint offset, const bounds::AABB& voxel)
+    {
+      return pending_pair{offset, voxel, voxel.surface_area()};
+    };
+    auto by_area = [](const pending_pair& a, const pending_pair& b) { return a.area < b.area; };
+
+    /*
+     * 1. Order the pairs into clusters, with padding (-1) wherever a cluster
+     * would otherwise straddle a line.
+     */
+    const int PADDING = -1;
+    vector<int> order;
+    order.reserve(node_storage.size() / 2);
+
+    stack<pending_pair, vector<pending_pair>> cluster_roots;
+    cluster_roots.push(make_pending(root->left_offset(), bound));
+
+    vector<pending_pair> frontier, cluster;
+    uint line_pos = 0;
+    while (!cluster_roots.empty())
+    {
+      frontier.assign(1, cluster_roots.top());
+      cluster_roots.pop();
+      cluster.clear();
+
+      while (!frontier.empty() && cluster.size() < pairs_per_line)
+      {
+        std::pop_heap(frontier.begin(), frontier.end(), by_area);
+        const auto p = frontier.back();
+        frontier.pop_back();
+        cluster.push_back(p);
+
+        for (int c = 0; c < 2; ++c)
+        {
+          const auto& child = node_storage[p.offset + c];
+          if (child.is_leaf())
+            continue;
+
+          auto voxel = p.voxel;
+          if (c == 0)
+            voxel.max()[child.plane_axis()] = std::max<scalar>(voxel.min()[child.plane_axis()], child.plane_split());
+          else
+            voxel.min()[child.plane_axis()] = std::min<scalar>(voxel.max()[child.plane_axis()], child.plane_split());
+          frontier.push_back(make_pending(child.left_offset(), voxel));
+          std::push_heap(frontier.begin(), frontier.end(), by_area);
+        }
+      }
+
+      if (line_pos + cluster.size() > pairs_per_line)
+      {
+        order.insert(order.end(), pairs_per_line - line_pos, PADDING);
+        line_pos = 0;
+      }
+      for (const auto& p : cluster)
+        order.push_back(p.offset);
+      line_pos = (line_pos + cluster.size()) % pairs_per_line;
+
+      // The hottest remaining subtree is laid out next.
+      std::sort(frontier.begin(), frontier.end(), by_area);
+      for (const auto& p : frontier)
+        cluster_roots.push(p);
+    }
+
+    /*
+     * 2. Copy the pairs into place, aligning the first to a cache line, and
+     * remap the child offsets.
+     */
+    node_type empty;
+    empty.leaf = typename node_type::leaf_t{0, 0, NONE};
+
+    vector<node_type> nodes;
+    nodes.reserve(2 * (order.size() + pairs_per_line));
+    const auto misalign = reinterpret_cast<uintptr_t>(nodes.data()) % CACHE_LINE_SIZE;
+    if (misalign % pair_size == 0)
+      nodes.resize(2 * (((CACHE_LINE_SIZE - misalign) % CACHE_LINE_SIZE) / pair_size), empty);
+
+    vector<uint> new_offset(node_storage.size());
+    for (auto p : order)
+    {
+      if (p == PADDING)
+      {
+        nodes.push_back(empty);
+        nodes.push_back(empty);
+        continue;
+      }
+      new_offset[p] = nodes.size();
+      nodes.push_back(node_storage[p]);
+      nodes.push_back(node_storage[p + 1]);
+    }
+
+    for (auto& node : nodes)
+    {
+      if (!node.is_leaf())
+        node.inner.left_offset = new_offset[node.left_offset()];
+    }
+    root->inner.left_offset = new_offset[root->left_offset()];
+
+    node_storage = move(nodes);
+  }
+
+  template <typename T>
+  void Tree<T>::pack_leaf_indices(uint block_size)
+  {
+    vector<obj_index> new_indices;
+    new_indices.reserve(indices.size());
+
+    auto pack = [&](node_type& node)
+    {
+      if (!node.is_leaf() || node.num_objects() == 0)
+        return;
+
+      const auto first = indices.begin() + node.offset();
+      node.leaf.offset = new_indices.size();
+      new_indices.insert(new_indices.end(), first, first + node.num_objects());
+      new_indices.resize((new_indices.size() + block_size - 1) / block_size * block_size,
+                         EMPTY_INDEX);
+    };
+
+    pack(*root);
+    for (auto& node : node_storage)
+      pack(node);
+
+    indices = move(new_indices);
+  }
+
   template <typename T>
   scalar_fp Tree<T>::intersect(const Ray& ray, const scalar_fp max_t, element_type& obj, SubGeo& geo) const
+  {
+    return intersect(ray, max_t, obj, geo, [](const node_type*) { });
+  }
+
+  template <typename T>
+  template <typename Visit>
+  scalar_fp Tree<T>::intersect(const Ray& ray, const scalar_fp max_t, element_type& obj, SubGeo& geo,
+                               Visit&& visit) const
+  {
+    return intersect_leaves(ray, max_t, [&](const Node<T>& leaf, scalar_fp leaf_max_t)
+                            {
+                              return leaf_intersect(leaf, ray, leaf_max_t, obj, geo);
+                            }, visit);
+  }
+
+  template <typename T>
+  template <typename LeafIntersect, typename Visit>
+  scalar_fp Tree<T>::intersect_leaves(const Ray& ray, const scalar_fp max_t,
+                                      LeafIntersect&& leaf_intersect, Visit&& visit) const
+  {
+    // A hit found in a leaf may lie beyond the leaf's cell, with a closer one
+    // in a later cell, so it only ends the traversal once no later cell can
+    // be closer.
+    scalar_fp best_t = max_t;
+    bool hit = false;
+    traverse(ray, max_t, [&](const Node<T>& leaf, scalar t0, scalar t1)
+             {
+               if (hit && best_t.get() <= t0)
+                 return true;
+
+               auto t = leaf_intersect(leaf, best_t);
+               if (t.is())
+               {
+                 best_t = t;
+                 hit = true;
+               }
+               return hit && best_t.get() <= t1;
+             }, visit);
+    return hit ? best_t : sfp_none;
+  }
+
+  template <typename T>
+  bool Tree<T>::occluded(const Ray& ray, const scalar_fp max_t) const
+  {
+    return occluded_leaves(ray, max_t, [&](const Node<T>& leaf)
+                           {
+                             const int end = leaf.offset() + leaf.num_objects();
+                             for (int i = leaf.offset(); i < end; ++i)
+                             {
+                               if (elements[indices[i]]->occluded(ray, max_t))
+                                 return true;
+                             }
+                             return false;
+                           });
+  }
+
+  template <typename T>
+  template <typename LeafOccluded>
+  bool Tree<T>::occluded_leaves(const Ray& ray, const scalar_fp max_t, LeafOccluded&& leaf_occluded) const
+  {
+    return traverse(ray, max_t, [&](const Node<T>& leaf, scalar, scalar) { return leaf_occluded(leaf); },
+                    [](const node_type*) { });
+  }
+
+  template <typename T>
+  template <typename LeafTest, typename Visit>
+  bool Tree<T>::traverse(const Ray& ray, const scalar_fp max_t, LeafTest&& leaf_test,
+                         Visit&& visit) const
   {
     scalar t0, t1;
     if (!bound.intersect(ray, t0, t1))
-      return sfp_none;
+      return false;
 
     assert(t0 <= t1);
 
     if (t1 <= 0 || max_t <= t0)
-      return sfp_none;
+      return false;
 
     t0 = std::max<scalar>(t0, 0);
     if (max_t.is())
@@ -426,19 +1044,21 @@ namespace kd
 
     while (t0 < max_t)
     {
+      if (active != nullptr)
+        visit(active);
+
       // if we push an empty node, just continue
       if (active == nullptr)
       {
       }
       /**
-       * When we hit a leaf, pick the best intersection of objects within the
-       * leaf, if any.
+       * When we hit a leaf, test the objects within the leaf over the ray's
+       * span [t0, t1] in its cell, and stop if the test is satisfied.
        **/
       else if (active->is_leaf())
       {
-        auto best_t = leaf_intersect(*active, ray, max_t, obj, geo);
-        if (best_t.is())
-          return best_t;
+        if (leaf_test(*active, t0, t1))
+          return true;
       }
       /**
        * Otherwise, use the split position to find which children, if any, to
@@ -476,7 +1096,7 @@ namespace kd
       node_stack.pop();
     }
 
-    return sfp_none;
+    return false;
   }
 
   template <typename T>
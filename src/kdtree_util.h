@@ -2,14 +2,36 @@
 
 #include <cstdint>
 #include <iostream>
+#include <vector>
 #include "twinkle.h"
+#include "bounds.h"
 
 using std::ostream;
+using std::vector;
 
 namespace kd
 {
+  /*
+   * How split planes are chosen.
+   *
+   * ADAPTIVE: sample each axis at a few uniform and adaptive positions, and
+   *           interpolate (exact evaluation only below exact_evaluation_limit)
+   * SWEEP: exact SAH at every node, by sweeping over split events that are
+   *        sorted once and kept sorted down the recursion (Wald and Havran,
+   *        "On building fast kd-Trees for Ray Tracing, and on doing that in
+   *        O(N log N)"). exact_evaluation_limit and hybrid_one_axis_limit are
+   *        unused.
+   */
+  enum class BuildMode
+  {
+    ADAPTIVE,
+    SWEEP
+  };
+
   struct TreeOptions
   {
+    BuildMode build_mode = BuildMode::ADAPTIVE;
+
     uint32_t num_uniform_samples = 8;
     uint32_t num_adaptive_samples = 8;
     scalar empty_side_discount = 0.85;
@@ -20,6 +42,67 @@ namespace kd
     uint32_t exact_evaluation_limit = 36;
 
     uint32_t max_elements_per_leaf = 4;
+
+    /*
+     * Trees with at least this many elements are built in parallel when a
+     * build scheduler is set. Once a subtree holds at most
+     * total / (subtrees_per_thread * threads) elements, it is built as a
+     * separate task; above that, the axes of each node are searched in
+     * parallel.
+     */
+    uint32_t parallel_build_limit = 4096;
+    uint32_t subtrees_per_thread = 8;
+
+    /*
+     * Reorder the finished tree so that nodes likely to be traversed together
+     * share cache lines.
+     */
+    bool cache_layout = true;
+
+    /*
+     * Start the index range of every leaf at a multiple of leaf_block_size,
+     * so that per-leaf data packed in blocks of that size (e.g. SIMD triangle
+     * blocks) can be addressed by leaf offset.
+     */
+    uint32_t leaf_block_size = 1;
+  };
+
+  /*
+   * A candidate split position for the sweep build: where an element's
+   * (clipped) box starts or ends along an axis, or where it lies if it is
+   * flat along that axis.
+   */
+  struct split_event
+  {
+    enum Type : uint8_t
+    {
+      END = 0,
+      PLANAR = 1,
+      START = 2
+    };
+
+    scalar pos;
+    uint32_t element;
+    Type type;
+
+    // Events at the same position are ordered end, planar, start.
+    bool operator <(const split_event& e) const
+    {
+      return pos < e.pos || (pos == e.pos && type < e.type);
+    }
+  };
+
+  /*
+   * A subtree whose construction has been deferred to a separate task.
+   */
+  struct subtree_job
+  {
+    vector<uint32_t> objects;
+    vector<bounds::AABB> boxes;
+    bounds::AABB bound;
+
+    // position of the subtree root in the parent's node storage
+    uint32_t slot;
   };
 
   enum NodeAxis
@@ -1,5 +1,6 @@
 #include "light.h"
 #include "scene.h"
+#include "math_util.h"
 
 LightSample::LightSample(spectrum s, scalar p, const Vec3& p1, const Vec3& p2) :
   ray{p1, p2-p1}, em(s), p_(p), occ_type(OCCLUSION_POINTS)
@@ -17,19 +18,102 @@ bool LightSample::is_occluded(const Scene& scene) const
   switch (occ_type)
   {
   case OCCLUSION_RAY:
-    return scene.intersect(ray).is();
-    
+    return scene.occluded(ray, sfp_none);
+
+  // the ray spans the two points over t in [0, 1], stopping just short of
+  // the second, which may lie on an emitting surface
   case OCCLUSION_POINTS:
-    {
-      auto isect = scene.intersect(ray);
-      return isect.is() && approx_gt(1.0, isect.get().t());
-    }
+    return scene.occluded(ray, scalar_fp{1.0 - SCALAR_EPSILON});
     
   default:
     return true;
   }
 }
 
+namespace
+{
+  scalar safe_sqrt(scalar x)
+  {
+    return sqrt(std::max<scalar>(x, 0.0));
+  }
+
+  // cos(max(0, a - b)) and sin(max(0, a - b)), from the cosines and sines
+  scalar cos_sub_clamped(scalar cos_a, scalar sin_a, scalar cos_b, scalar sin_b)
+  {
+    return cos_a > cos_b ? 1.0 : cos_a * cos_b + sin_a * sin_b;
+  }
+  scalar sin_sub_clamped(scalar cos_a, scalar sin_a, scalar cos_b, scalar sin_b)
+  {
+    return cos_a > cos_b ? 0.0 : sin_a * cos_b - cos_a * sin_b;
+  }
+}
+
+scalar LightBounds::importance(const Vec3& p, const Vec3& n) const
+{
+  // Bound the box by a sphere, and the directions from p to it by a cone.
+  const auto center = box.center();
+  const scalar radius2 = (box.size() * 0.5).norm2();
+  const scalar d2 = (p - center).norm2();
+  const scalar scale = power / (falloff ? std::max(d2, radius2) : 1.0);
+
+  if (d2 <= radius2)
+    return scale;
+
+  const scalar sin2_theta_b = radius2 / d2;
+  const scalar cos_theta_b = safe_sqrt(1 - sin2_theta_b), sin_theta_b = sqrt(sin2_theta_b);
+
+  // The smallest angle between an emission normal and the direction to p
+  const Vec3 wi = (p - center) / sqrt(d2);
+  const scalar cos_theta_w = wi.dot(axis), sin_theta_w = safe_sqrt(1 - cos_theta_w * cos_theta_w);
+  const scalar sin_theta_o = safe_sqrt(1 - cos_theta_o * cos_theta_o);
+  const scalar cos_theta_x = cos_sub_clamped(cos_theta_w, sin_theta_w, cos_theta_o, sin_theta_o);
+  const scalar sin_theta_x = sin_sub_clamped(cos_theta_w, sin_theta_w, cos_theta_o, sin_theta_o);
+  const scalar cos_theta_p = cos_sub_clamped(cos_theta_x, sin_theta_x, cos_theta_b, sin_theta_b);
+  if (cos_theta_p <= cos_theta_e)
+    return 0;
+
+  scalar importance = scale * cos_theta_p;
+  if (n.norm2() > 0)
+  {
+    // Both sides of the surface, for transmissive materials.
+    const scalar cos_theta_i = fabs(wi.dot(n)), sin_theta_i = safe_sqrt(1 - cos_theta_i * cos_theta_i);
+    importance *= cos_sub_clamped(cos_theta_i, sin_theta_i, cos_theta_b, sin_theta_b);
+  }
+  return importance;
+}
+
+LightBounds LightBounds::merge(const LightBounds& a, const LightBounds& b)
+{
+  LightBounds m{bounds::AABB::box_union(a.box, b.box), a.power + b.power, a.axis, a.cos_theta_o,
+      std::min(a.cos_theta_e, b.cos_theta_e), a.falloff && b.falloff};
+
+  // Smallest cone of normals containing both cones
+  const scalar theta_a = acos(clamp(a.cos_theta_o, -1, 1));
+  const scalar theta_b = acos(clamp(b.cos_theta_o, -1, 1));
+  const scalar theta_d = acos(clamp(a.axis.dot(b.axis), -1, 1));
+  if (std::min<scalar>(theta_d + theta_b, PI) <= theta_a)
+    return m;
+  if (std::min<scalar>(theta_d + theta_a, PI) <= theta_b)
+  {
+    m.axis = b.axis;
+    m.cos_theta_o = b.cos_theta_o;
+    return m;
+  }
+
+  const scalar theta_o = (theta_a + theta_d + theta_b) * 0.5;
+  const auto rotation_axis = a.axis.cross(b.axis);
+  if (theta_o >= PI || rotation_axis.norm2() == 0)
+  {
+    m.cos_theta_o = -1;
+    return m;
+  }
+  m.axis = a.axis.rotateAxisAngle(rotation_axis.normal(), theta_o - theta_a);
+  m.cos_theta_o = cos(theta_o);
+  return m;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 std::string PointLight::to_string() const
 {
   using std::ostringstream;
@@ -45,7 +129,7 @@ LightSample PointLight::sample_emission(const Intersection& isect,
   const auto d = position - isect.position;
   spectrum emit = _emission;// / d.norm2();
 
-  return LightSample{emit, 1.0, isect.position + d.normal() * 0.001, position};
+  return LightSample{emit, 1.0, Ray{isect.position, d}.offset(isect.normal).position, position};
 }
 
 /* Sample an emission generically, from anywhere within the scene. */
@@ -61,11 +145,13 @@ spectrum PointLight::emission(const Scene& scene, const IntersectionView& isect,
                               const EmissionSample& sample) const
 {
   auto L = isect.position - position;
-  auto shadow_isect = scene.intersect(Ray{position, L}, scalar_fp{1.0 - EPSILON});
-  if (!shadow_isect.is() || shadow_isect.get().t() >= 1.0)
-    return _emission;
+  return scene.occluded(Ray{position, L}, scalar_fp{1.0 - EPSILON}) ? spectrum::zero : _emission;
+}
 
-  return spectrum::zero;
+optional<LightBounds> PointLight::bounds() const
+{
+  // Emits in every direction, with no falloff.
+  return LightBounds{bounds::AABB{position, position}, _emission.luminance(), Vec3::z_axis, -1, 0, false};
 }
 
 LightSample DirectionalLight::sample_emission(const Intersection& isect,
@@ -74,7 +160,7 @@ LightSample DirectionalLight::sample_emission(const Intersection& isect,
   if (isect.normal.dot(direction) < 0)
     return LightSample();
 
-  return LightSample(_emission, 1.0, Ray{isect.position, direction}.normal().nudge(0.0005) );
+  return LightSample(_emission, 1.0, Ray{isect.position, direction}.normal().offset(isect.normal) );
 }
 
 EmissionSample DirectionalLight::sample_emission(const Scene& scene,
@@ -85,7 +171,7 @@ EmissionSample DirectionalLight::sample_emission(const Scene& scene,
 spectrum DirectionalLight::emission(const Scene& scene, const IntersectionView& isect,
                                           const EmissionSample& e_sample) const
 {
-  auto shadow_isect = scene.intersect(Ray{isect.position, direction}.nudge(SHADOW_EPSILON));
-  return shadow_isect.is() ? spectrum::zero : _emission;
+  const bool occluded = scene.occluded(Ray{isect.position, direction}.offset(isect.normal), sfp_none);
+  return occluded ? spectrum::zero : _emission;
 }
 
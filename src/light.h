@@ -71,9 +71,43 @@ public:
   scalar ray_prob;
 };
 
+/*
+ * Conservative bounds on the emission of a light, or of a cluster of lights,
+ * used to estimate how much it can contribute at a shading point.
+ *
+ * Emission leaves from within box, from surfaces whose normals lie within
+ * theta_o of axis, in directions within theta_e of those normals.
+ */
+struct LightBounds
+{
+  bounds::AABB box;
+  scalar power; // luminance of the emission
+  Vec3 axis;
+  scalar cos_theta_o;
+  scalar cos_theta_e;
+  bool falloff; // whether the emission falls off with the squared distance
+
+  /*
+   * An estimate of the contribution at p, on a surface with normal n (or
+   * zero, for no surface). Zero only if nothing can reach p.
+   */
+  scalar importance(const Vec3& p, const Vec3& n) const;
+
+  static LightBounds merge(const LightBounds& a, const LightBounds& b);
+};
+
 class Light : public Base
 {
 public:
+  /*
+   * Bounds on the emission of this light, or none for lights at infinity,
+   * which are chosen separately from the light tree.
+   */
+  virtual optional<LightBounds> bounds() const
+  {
+    return none_tag;
+  }
+
   /* Given an intersection point, sample an emission from the point. */
   virtual LightSample sample_emission(const Intersection& isect, Sampler&) const = 0;
 
@@ -123,6 +157,8 @@ public:
   spectrum emission(const Scene& scene, const IntersectionView& isect,
                     const EmissionSample& sample) const override;
 
+  optional<LightBounds> bounds() const override;
+
   std::string to_string() const override;
 
 private:
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "light_tree.h"
+
+using std::pair;
+
+namespace
+{
+  const scalar ONE_MINUS_EPSILON = std::nextafter(scalar(1), scalar(0));
+}
+
+LightTree::LightTree(const vector<const Light*>& lights)
+{
+  vector<pair<const Light*, LightBounds>> bounded;
+  for (auto light : lights)
+  {
+    const auto b = light->bounds();
+    if (b.is())
+    {
+      if (b.get().power > 0)
+        bounded.emplace_back(light, b.get());
+    }
+    else
+      infinite_lights.push_back(light);
+  }
+
+  if (!bounded.empty())
+  {
+    nodes.reserve(2 * bounded.size() - 1);
+    build(bounded, 0, bounded.size(), 0, 0);
+  }
+}
+
+uint LightTree::build(vector<pair<const Light*, LightBounds>>& lights, uint start, uint end,
+                      uint64_t trail, uint depth)
+{
+  assert(depth < 64);
+
+  const uint index = nodes.size();
+  if (end - start == 1)
+  {
+    nodes.push_back(Node{lights[start].second, lights[start].first, 0});
+    light_trails[lights[start].first] = trail;
+    return index;
+  }
+
+  // Split at the median along the widest axis of the light centers.
+  bounds::AABB centers{lights[start].second.box.center(), lights[start].second.box.center()};
+  for (auto i = start + 1; i < end; ++i)
+  {
+    const auto c = lights[i].second.box.center();
+    centers = centers.union_with(bounds::AABB{c, c});
+  }
+  const auto size = centers.size();
+  const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+  const uint mid = (start + end) / 2;
+  std::nth_element(lights.begin() + start, lights.begin() + mid, lights.begin() + end,
+                   [axis](const auto& a, const auto& b)
+                   {
+                     return a.second.box.center()[axis] < b.second.box.center()[axis];
+                   });
+
+  nodes.push_back(Node{});
+  build(lights, start, mid, trail, depth + 1);
+  const auto second = build(lights, mid, end, trail | (uint64_t(1) << depth), depth + 1);
+
+  nodes[index].bounds = LightBounds::merge(nodes[index + 1].bounds, nodes[second].bounds);
+  nodes[index].light = nullptr;
+  nodes[index].second_child = second;
+  return index;
+}
+
+scalar LightTree::infinite_prob() const
+{
+  return scalar(infinite_lights.size()) / (infinite_lights.size() + (nodes.empty() ? 0 : 1));
+}
+
+scalar LightTree::first_child_prob(uint index, const Vec3& p, const Vec3& n) const
+{
+  const auto& first = nodes[index + 1].bounds;
+  const auto& second = nodes[nodes[index].second_child].bounds;
+
+  const scalar i0 = first.importance(p, n), i1 = second.importance(p, n);
+  if (i0 + i1 > 0)
+    return i0 / (i0 + i1);
+
+  if (first.power + second.power > 0)
+    return first.power / (first.power + second.power);
+
+  return 0.5;
+}
+
+const Light* LightTree::sample(const Vec3& p, const Vec3& n, scalar r1, scalar& light_prob) const
+{
+  light_prob = 0;
+  if (empty())
+    return nullptr;
+
+  const scalar p_infinite = infinite_prob();
+  if (r1 < p_infinite)
+  {
+    const auto num = infinite_lights.size();
+    light_prob = p_infinite / num;
+    return infinite_lights[std::min<size_t>(num - 1, r1 / p_infinite * num)];
+  }
+
+  // Reuse r1 for each choice down the tree.
+  r1 = std::min<scalar>((r1 - p_infinite) / (1 - p_infinite), ONE_MINUS_EPSILON);
+  if (nodes[0].bounds.importance(p, n) == 0)
+    return nullptr;
+
+  scalar prob = 1 - p_infinite;
+  uint index = 0;
+  while (nodes[index].light == nullptr)
+  {
+    const scalar p0 = first_child_prob(index, p, n);
+    if (r1 < p0)
+    {
+      r1 = std::min<scalar>(r1 / p0, ONE_MINUS_EPSILON);
+      prob *= p0;
+      index = index + 1;
+    }
+    else
+    {
+      r1 = std::min<scalar>((r1 - p0) / (1 - p0), ONE_MINUS_EPSILON);
+      prob *= 1 - p0;
+      index = nodes[index].second_child;
+    }
+  }
+
+  light_prob = prob;
+  return nodes[index].light;
+}
+
+scalar LightTree::pmf(const Vec3& p, const Vec3& n, const Light* light) const
+{
+  const auto trail_it = light_trails.find(light);
+  if (trail_it == light_trails.end())
+  {
+    const bool infinite = std::find(infinite_lights.begin(), infinite_lights.end(), light) !=
+      infinite_lights.end();
+    return infinite ? infinite_prob() / infinite_lights.size() : 0;
+  }
+
+  if (nodes[0].bounds.importance(p, n) == 0)
+    return 0;
+
+  auto trail = trail_it->second;
+  scalar prob = 1 - infinite_prob();
+  uint index = 0;
+  while (nodes[index].light == nullptr)
+  {
+    const scalar p0 = first_child_prob(index, p, n);
+    if (trail & 1)
+    {
+      prob *= 1 - p0;
+      index = nodes[index].second_child;
+    }
+    else
+    {
+      prob *= p0;
+      index = index + 1;
+    }
+    trail >>= 1;
+  }
+  return prob;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "light.h"
+
+using std::vector;
+
+/*
+ * Chooses lights in proportion to their estimated contribution at a shading
+ * point, so that scenes with many lights spend their samples on the few that
+ * matter at each point.
+ *
+ * Lights with bounds are clustered into a binary tree, each node holding the
+ * merged LightBounds of its lights. Sampling walks down from the root,
+ * choosing each child in proportion to its importance at the point, so the
+ * probability of a light is the product of the choices along its path. Lights
+ * at infinity have no bounds, and are chosen uniformly with probability
+ * proportional to their number (the tree counting as one more).
+ */
+class LightTree
+{
+public:
+  LightTree() { }
+  LightTree(const vector<const Light*>& lights);
+
+  /*
+   * Choose a light for the shading point p with normal n (zero for no
+   * surface). light_prob is the probability of the light returned, or zero
+   * if no light can contribute at p.
+   */
+  const Light* sample(const Vec3& p, const Vec3& n, scalar r1, scalar& light_prob) const;
+
+  /*
+   * The probability that sample chooses light at p.
+   */
+  scalar pmf(const Vec3& p, const Vec3& n, const Light* light) const;
+
+  bool empty() const { return nodes.empty() && infinite_lights.empty(); }
+
+private:
+  struct Node
+  {
+    LightBounds bounds;
+
+    // the light at a leaf, or the index of the second child of an inner
+    // node, whose first child follows it
+    const Light* light;
+    uint second_child;
+  };
+
+  scalar infinite_prob() const;
+
+  /*
+   * The probability of descending from the inner node at index to its first
+   * child. By their importance at p, or by their power where neither child
+   * can contribute but their merged bounds could, so that a walk the parent
+   * admits always reaches a light.
+   */
+  scalar first_child_prob(uint index, const Vec3& p, const Vec3& n) const;
+
+  uint build(vector<std::pair<const Light*, LightBounds>>& lights, uint start, uint end,
+             uint64_t trail, uint depth);
+
+  vector<Node> nodes;
+  vector<const Light*> infinite_lights;
+
+  // The path to each bounded light, one bit per level (1 for the second
+  // child), from the root in the lowest bit.
+  std::unordered_map<const Light*, uint64_t> light_trails;
+};
@@ -27,7 +27,7 @@ Mat33::Mat33(Mat33&& x)
 }
 
 Mat33::Mat33(const Vec3& r1, const Vec3& r2, const Vec3&r3) :
-  row{r1, r2, r3}
+  v{r1.x, r1.y, r1.z, r2.x, r2.y, r2.z, r3.x, r3.y, r3.z}
 {
 
 }
@@ -135,9 +135,9 @@ Mat33 operator*(scalar f, const Mat33& mat)
 Mat33 Mat33::operator*(const Mat33& rhs) const
 {
   return Mat33(
-    v[0] * rhs.row[0] + v[1] * rhs.row[1] + v[2] * rhs.row[2],
-    v[3] * rhs.row[0] + v[4] * rhs.row[1] + v[5] * rhs.row[2],
-    v[6] * rhs.row[0] + v[7] * rhs.row[1] + v[8] * rhs.row[2]);
+    v[0] * rhs.row(0) + v[1] * rhs.row(1) + v[2] * rhs.row(2),
+    v[3] * rhs.row(0) + v[4] * rhs.row(1) + v[5] * rhs.row(2),
+    v[6] * rhs.row(0) + v[7] * rhs.row(1) + v[8] * rhs.row(2));
 }
 
 Vec3 operator*(const Vec3& v, const Mat33& mat)
@@ -147,12 +147,12 @@ Vec3 operator*(const Vec3& v, const Mat33& mat)
 
 Vec3 Mat33::operator *(const Vec3& v) const
 {
-  return Vec3{row[0].dot(v), row[1].dot(v), row[2].dot(v)};
+  return Vec3{row(0).dot(v), row(1).dot(v), row(2).dot(v)};
 }
 
 Vec3 Mat33::tmul(const Vec3& v) const
 {
-  return row[0] * v[0] + row[1] * v[1] + row[2] * v[2];
+  return row(0) * v[0] + row(1) * v[1] + row(2) * v[2];
 }
 
 scalar Mat33::trace() const
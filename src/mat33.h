@@ -74,11 +74,13 @@ public:
 
   static Mat33 identity;
 
-  union
+  Vec3 row(int i) const
   {
-    scalar v[9];
-    Vec3 row[3];
-  };
+    return Vec3{v[3 * i], v[3 * i + 1], v[3 * i + 2]};
+  }
+
+  // row-major; Vec3 may be padded, so the rows are not stored as Vec3s
+  scalar v[9];
 
   static Mat33 z_to_y;
   static Mat33 y_to_z;
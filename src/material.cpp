@@ -8,14 +8,14 @@ using std::make_shared;
 
 MaterialSample MaterialSample::invalid{Vec3::zero, 0, spectrum::zero};
 
-MaterialSample::MaterialSample(const Vec3& d ,scalar p, const spectrum& s)
-  : direction(d), prob(p), reflectance(s)
+MaterialSample::MaterialSample(const Vec3& d ,scalar p, const spectrum& s, bool spec)
+  : direction(d), prob(p), reflectance(s), specular(spec)
 {
 
 }
 
-MaterialSample::MaterialSample(const BSDFSample& bs, const spectrum& s)
-  : direction(bs.direction), prob(bs.prob), reflectance(s * bs.reflectance)
+MaterialSample::MaterialSample(const BSDFSample& bs, const spectrum& s, bool spec)
+  : direction(bs.direction), prob(bs.prob), reflectance(s * bs.reflectance), specular(spec)
 {
 }
 
@@ -30,16 +30,21 @@ RoughMaterial::RoughMaterial(scalar roughness_, const Texture* tex_) :
     brdf = unique_ptr<BRDF>(new Lambertian(1.0));
 }
 
+spectrum RoughMaterial::texture_value(const IntersectionView& isect) const
+{
+  return texture->at_point(isect);
+}
+
 spectrum RoughMaterial::reflectance(const IntersectionView& isect,
                                     const Vec3& incoming, const Vec3& outgoing) const
 {
-  return brdf->reflectance(incoming, outgoing) * texture->at_point(isect);
+  return brdf->reflectance(incoming, outgoing) * isect.texture_value();
 }
 
 MaterialSample RoughMaterial::sample_bsdf(
   const IntersectionView& isect, const Vec3& incoming, Sampler& sampler) const
 {
-  return MaterialSample{brdf->sample(incoming, sampler), texture->at_point(isect)};
+  return MaterialSample{brdf->sample(incoming, sampler), isect.texture_value()};
 }
 
 scalar RoughMaterial::pdf(const Vec3& incoming,
@@ -74,7 +79,7 @@ spectrum MirrorMaterial::reflectance(const IntersectionView&,
 MaterialSample MirrorMaterial::sample_bsdf(
   const IntersectionView&, const Vec3& incoming, Sampler& sampler) const
 {
-  return MaterialSample{brdf.sample(incoming, sampler), spectrum{1.0}};
+  return MaterialSample{brdf.sample(incoming, sampler), spectrum{1.0}, true};
 
 }
 
@@ -121,13 +126,13 @@ MaterialSample GlassMaterial::sample_bsdf(
   if (samp < refl_prob)
   {
     // reflect
-    return MaterialSample{incoming.reflect_over(normal), refl_prob, spectrum{fr / az}};
+    return MaterialSample{incoming.reflect_over(normal), refl_prob, spectrum{fr / az}, true};
   }
   else
   {
     // transmit
     auto wo = refraction_direction(incoming, normal, nr);
-    return MaterialSample{wo, 1 - refl_prob, spectrum{(1 - fr) / az}};
+    return MaterialSample{wo, 1 - refl_prob, spectrum{(1 - fr) / az}, true};
   }
 }
 
@@ -160,8 +165,13 @@ scalar EmissiveMaterial::pdf(const Vec3&, const Vec3&) const
   return 0.0;
 }
 
-spectrum EmissiveMaterial::emission(const IntersectionView& isect) const
+spectrum EmissiveMaterial::texture_value(const IntersectionView& isect) const
 {
   return texture->at_point(isect);
 }
+
+spectrum EmissiveMaterial::emission(const IntersectionView& isect) const
+{
+  return isect.texture_value();
+}
   
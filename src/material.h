@@ -16,20 +16,35 @@ using std::unique_ptr;
  */
 struct MaterialSample
 {
-  MaterialSample() { }
-  MaterialSample(const Vec3&, scalar, const spectrum&);
-  MaterialSample(const BSDFSample&, const spectrum&);
+  MaterialSample() : specular(false) { }
+  MaterialSample(const Vec3&, scalar, const spectrum&, bool specular = false);
+  MaterialSample(const BSDFSample&, const spectrum&, bool specular = false);
 
   static MaterialSample invalid;
 
   Vec3 direction;
   scalar prob;
   spectrum reflectance;
+
+  // True for a single mirror or refraction direction, which reflectance()
+  // is zero for, so light along it is only found by following the sample.
+  bool specular;
 };
 
 class Material : public Base
 {
 public:
+  /*
+   * The direction-independent part of the material at a point, usually its
+   * texture lookup. Materials read it through IntersectionView::texture_value,
+   * which evaluates it once per intersection, instead of calling this
+   * directly.
+   */
+  virtual spectrum texture_value(const IntersectionView&) const
+  {
+    return spectrum{1.0};
+  }
+
   virtual spectrum reflectance(const IntersectionView&, const Vec3& incoming,
                                const Vec3& outgoing) const = 0;
   
@@ -58,6 +73,8 @@ class RoughMaterial : public Material
 public:
   RoughMaterial(scalar roughness, const Texture* tex);
 
+  spectrum texture_value(const IntersectionView&) const override;
+
   spectrum reflectance(const IntersectionView&, const Vec3& incoming, 
                        const Vec3& outgoing) const override;
   
@@ -125,6 +142,8 @@ class EmissiveMaterial : public Material
 public:
   EmissiveMaterial(const Texture*);
 
+  spectrum texture_value(const IntersectionView&) const override;
+
   spectrum reflectance(const IntersectionView&, const Vec3& incoming, const Vec3& outgoing) const override;
 
   MaterialSample sample_bsdf(const IntersectionView&, const Vec3& incoming, 
@@ -6,6 +6,11 @@ SimpleSmoothPlastic::SimpleSmoothPlastic(const Texture* tex, scalar roughness)
 {
 }
 
+spectrum SimpleSmoothPlastic::texture_value(const IntersectionView& view) const
+{
+  return _base.texture_value(view);
+}
+
 spectrum SimpleSmoothPlastic::reflectance(
   const IntersectionView& view, const Vec3& incoming, const Vec3& outgoing) const
 {
@@ -27,7 +32,7 @@ MaterialSample SimpleSmoothPlastic::sample_bsdf(
     // specular + underlying diffuse (from remaining transmitted specular)
     spectrum refl = spectrum{fr_r} + (1 - fr_r) * _base.reflectance(isect, incoming, outgoing);
 
-    return MaterialSample{outgoing, fr_r, refl};
+    return MaterialSample{outgoing, fr_r, refl, true};
   }
   else
   {
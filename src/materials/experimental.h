@@ -7,6 +7,8 @@ class SimpleSmoothPlastic : public Material
 public:
   SimpleSmoothPlastic(const Texture*, scalar roughness);
 
+  spectrum texture_value(const IntersectionView&) const override;
+
   spectrum reflectance(const IntersectionView&, const Vec3& incoming,
                        const Vec3& outgoing) const override;
 
@@ -130,12 +130,19 @@ Vec3 refraction_direction(const Vec3& incoming, const Vec3& normal, scalar nr)
 }
 
 
+/*
+ * Solved with divided differences in double precision, since inverting the
+ * Vandermonde matrix loses too much precision in single-precision builds.
+ */
 Vec3 interpolate_quadratic(scalar x1, scalar y1, scalar x2, scalar y2, scalar x3, scalar y3)
 {
-  Mat33 vandermonde({x1*x1, x1, 1, x2*x2, x2, 1, x3*x3, x3, 1});
-  auto inv = vandermonde.inverse();
-  auto y = Vec3{y1, y2, y3};
-  return inv * y;
+  const double d12 = (double(y2) - y1) / (double(x2) - x1);
+  const double d23 = (double(y3) - y2) / (double(x3) - x2);
+
+  const double a = (d23 - d12) / (double(x3) - x1);
+  const double b = d12 - a * (double(x1) + x2);
+  const double c = y1 - (a * x1 + b) * x1;
+  return Vec3(a, b, c);
 }
 
 void convolve(uint w, uint h, const vector<scalar>& data,
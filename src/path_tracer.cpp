@@ -30,7 +30,7 @@ PathTracerIntegrator::PathTracerIntegrator(const PathTracerIntegrator::Options&
 }
 
 spectrum PathTracerIntegrator::_trace_ray(const Scene& scene, const Ray& ray,
-                                          Sampler& sampler, int depth) const
+                                          Sampler& sampler, int depth, const Bounce& bounce) const
 {
   ++rays_traced;
   if (depth == 1)
@@ -39,18 +39,45 @@ spectrum PathTracerIntegrator::_trace_ray(const Scene& scene, const Ray& ray,
   auto isect_opt = scene.intersect(ray);
   const Vec3 ray_dir_origin = -ray.direction.normal();
   if (!isect_opt.is())
-    return scene.environment_light_emission(-ray_dir_origin);
+  {
+    const auto emission = scene.environment_light_emission(-ray_dir_origin);
+    const auto env = scene.environment_light();
+    if (!bounce.lights_sampled || !env)
+      return emission;
+
+    const scalar p_light = scene.light_pmf(*bounce.from, env) * env->pdf(-ray_dir_origin);
+    return emission * power_heuristic(bounce.bsdf_pdf, p_light);
+  }
 
   auto isect = isect_opt.get();
 
   spectrum total(0);
 
-  total += isect.emission();
+  if (!bounce.lights_sampled || !scene.area_light(isect.get_shape_for_id()))
+    total += isect.emission();
+
+  // Decide whether or not to continue trace and, if so, what the multiplier
+  // should be. This comes before direct lighting, which must know whether a
+  // bounce can follow.
+  const bool last_vertex = opt.max_depth > 0 && depth >= opt.max_depth;
+  bool continue_trace = !last_vertex;
+  scalar p_mult = 1.0;
+  if (continue_trace && opt.russian_roulette && depth >= opt.min_rr_depth)
+  {
+    if (sampler.sample_1d() < opt.rr_kill_prob)
+    {
+      continue_trace = false;
+    }
+    else
+    {
+      p_mult /= (1 - opt.rr_kill_prob);
+    }
+  }
 
   // direct lighting: randomly choose a light, and contribute
   // the light from that shape if appropriate
   scalar light_prob;
-  const auto light = scene.sample_light(sampler.sample_1d(), light_prob);
+  const auto light = scene.sample_light(isect, sampler.sample_1d(), light_prob);
 
   if (light_prob > 0)
   {
@@ -62,27 +89,15 @@ spectrum PathTracerIntegrator::_trace_ray(const Scene& scene, const Ray& ray,
         scalar NL = max<scalar>(ls.direction().dot(isect.normal), 0.0);
         auto ca = isect.reflectance(ls.direction(), ray_dir_origin);
 
-        auto light_contrib = ls.emission() * ca * spectrum{NL / (light_prob * ls.p())};
-        total += light_contrib;
-      }
-    }
-  }
+        // The environment may also be found by the next bounce, unless the
+        // path ends here. (Russian roulette leaves the weight alone: the
+        // bounces that survive it are scaled up to make up the share.)
+        scalar weight = NL / (light_prob * ls.p());
+        if (light == scene.environment_light() && !last_vertex)
+          weight *= power_heuristic(light_prob * ls.p(), isect.pdf(ray_dir_origin, ls.direction()));
 
-  // Decide whether or not to continue trace and, if so, what the multiplier
-  // should be.
-  bool continue_trace = true;
-  scalar p_mult = 1.0;
-  if (opt.max_depth > 0 && depth >= opt.max_depth)
-    continue_trace = false;
-  else if (opt.russian_roulette && depth >= opt.min_rr_depth)
-  {
-    if (sampler.sample_1d() < opt.rr_kill_prob)
-    {
-      continue_trace = false;
-    }
-    else
-    {
-      p_mult /= (1 - opt.rr_kill_prob);
+        add_scaled_product(total, ls.emission(), ca, weight);
+      }
     }
   }
 
@@ -93,10 +108,16 @@ spectrum PathTracerIntegrator::_trace_ray(const Scene& scene, const Ray& ray,
     scalar nl = fabs(mat_sample.direction.dot(isect.normal));// max<scalar>(brdf_dir.dot(isect.normal), 0);
     if (mat_sample.prob > 0 && nl > 0)
     {
-      total += _trace_ray(scene, Ray{isect.position, mat_sample.direction}.nudge(),
-                          sampler, depth + 1) *
-        mat_sample.reflectance *
-        spectrum{p_mult / mat_sample.prob * nl};
+      // Direct lighting only covers the side of the normal, can't reach
+      // through specular directions, and finds nothing for materials that
+      // can't be evaluated (a pdf of zero), such as the rough mirror.
+      const scalar bsdf_pdf = !mat_sample.specular && mat_sample.direction.dot(isect.normal) > 0 ?
+        isect.pdf(ray_dir_origin, mat_sample.direction) : 0;
+      const Bounce next{&isect, bsdf_pdf, bsdf_pdf > 0};
+      add_scaled_product(total,
+                         _trace_ray(scene, Ray{isect.position, mat_sample.direction}.offset(isect.normal),
+                                    sampler, depth + 1, next),
+                         mat_sample.reflectance, p_mult / mat_sample.prob * nl);
     }
   }
 
@@ -106,7 +127,7 @@ spectrum PathTracerIntegrator::_trace_ray(const Scene& scene, const Ray& ray,
 spectrum PathTracerIntegrator::trace_ray(const Scene& scene, const Ray& r,
                                          Sampler& sampler) const
 {
-  return _trace_ray(scene, r, sampler, 1);
+  return _trace_ray(scene, r, sampler, 1, Bounce{nullptr, 0, false});
 }
 
 
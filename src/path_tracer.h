@@ -38,8 +38,21 @@ public:
                      Sampler& sampler) const override;
 
 private:
+  /*
+   * How the ray being traced left the vertex before: whether direct lighting
+   * there already sampled the lights in its direction and, if so, from where
+   * and with what density the material chose the direction. Light the ray
+   * finds is then weighed against, or left to, that direct lighting.
+   */
+  struct Bounce
+  {
+    const Intersection* from;
+    scalar bsdf_pdf;
+    bool lights_sampled;
+  };
+
   spectrum _trace_ray(const Scene& scene, const Ray& r,
-                     Sampler& sampler, int depth) const;
+                     Sampler& sampler, int depth, const Bounce& bounce) const;
 
   mutable std::atomic_ullong rays_traced;
   mutable std::atomic_ullong primary_rays_traced;
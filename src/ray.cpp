@@ -1,8 +1,49 @@
 #include "ray.h"
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+#ifdef USE_DOUBLES
+  using scalar_bits = int64_t;
+
+  // the same offset, relative to the coordinate, as for floats
+  const scalar INT_SCALE = 256.0 * (1 << 29);
+#else
+  using scalar_bits = int32_t;
+  const scalar INT_SCALE = 256.0;
+#endif
+
+  // Near the origin, ulps are too small; offset by a fixed amount instead.
+  const scalar ORIGIN = 1.0 / 32;
+  const scalar FLOAT_SCALE = 1.0 / 65536;
+
+  scalar offset_ulps(scalar x, scalar_bits ulps)
+  {
+    scalar_bits bits;
+    memcpy(&bits, &x, sizeof(x));
+    bits += x < 0 ? -ulps : ulps;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+  }
+}
 
 Ray Ray::nudge(scalar epsilon) const
 {
   return Ray(position + direction.normal() * epsilon, direction);
 }
 
+Ray Ray::offset(const Vec3& normal) const
+{
+  const Vec3 n = normal.dot(direction) < 0 ? -normal : normal;
+
+  Vec3 p;
+  for (int i = 0; i < 3; ++i)
+  {
+    p[i] = fabs(position[i]) < ORIGIN ? position[i] + FLOAT_SCALE * n[i] :
+      offset_ulps(position[i], scalar_bits(INT_SCALE * n[i]));
+  }
+  return Ray(p, direction);
+}
+
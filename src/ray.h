@@ -30,7 +30,20 @@ public:
     return Ray{position, direction.normal()};
   }
   
+  /*
+   * Move the origin a fixed distance along the direction. For rays that do
+   * not start on a surface; use offset for those that do.
+   */
   Ray nudge(scalar eps = NUDGE_EPSILON) const;
+
+  /*
+   * Move the origin off the surface it lies on, given the surface's normal,
+   * to the side the ray leaves toward. The origin is moved by a fixed number
+   * of ulps per coordinate, so the offset follows the rounding error of the
+   * hit point at any scene scale and precision (Wachter and Binder, "A Fast
+   * and Robust Method for Avoiding Self-Intersection", Ray Tracing Gems).
+   */
+  Ray offset(const Vec3& normal) const;
   
   Vec3 position, direction;
   Vec3 inv_direction;
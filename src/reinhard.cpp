@@ -19,8 +19,9 @@ void reinhard_tonemap_aux(const sp_image& input,
   transform(input.begin(), input.end(), luminances.begin(),
             [](const spectrum& s) { return s.luminance(); });
 
-  scalar total_log = accumulate(luminances.begin(), luminances.end(), scalar(0),
-                                [=](scalar s, scalar v) { return s + log(delta + v); });
+  // summed in double, since there may be millions of pixels
+  double total_log = accumulate(luminances.begin(), luminances.end(), 0.0,
+                                [=](double s, scalar v) { return s + log(delta + v); });
 
   mean_log_luminance = exp(total_log / n);
 }
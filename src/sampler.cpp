@@ -194,6 +194,26 @@ scalar uniform_sphere_pdf(const Vec3& UNUSED(v))
   return INV_4PI;
 }
 
+Vec3 uniform_cone_sample(const Sample2D& sample, scalar cos_theta_max)
+{
+  const scalar cos_theta = 1 - sample[1] * (1 - cos_theta_max);
+  const scalar sin_theta = sqrt(max(scalar(0.0), 1 - cos_theta * cos_theta));
+  const scalar phi = 2 * PI * sample[0];
+
+  return Vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+scalar uniform_cone_pdf(scalar cos_theta_max)
+{
+  return 1 / (2 * PI * (1 - cos_theta_max));
+}
+
+Vec2 uniform_triangle_sample(const Sample2D& sample)
+{
+  const scalar su = sqrt(sample[0]);
+  return Vec2(su * (1 - sample[1]), su * sample[1]);
+}
+
 Vec2 uniform_sample_disc(const Sample2D& sample)
 {
   scalar p;
@@ -235,26 +255,21 @@ std::chrono::system_clock::duration::rep time_seed()
 
 ////////////////////////////////////////////////////////////////////////////////
 
-// multinomial sampling via the alias method
-using std::vector;
-vector<uint> multinomial_distribution(const vector<double>& p_orig, uint64_t num_draws)
+AliasTable::AliasTable(const vector<double>& weights) :
+  keep_(weights.size()), alias_(weights.size()), p_(weights.size())
 {
-  using std::cerr;
-  using std::endl;
-  using std::ostream_iterator;
-
-  UniformSampler s;
-  s.seed(time_seed());
+  const auto n = weights.size();
+  const double tp = accumulate(weights.begin(), weights.end(), 0.0);
+  assert(tp > 0);
 
-  const auto n = p_orig.size();
   vector<double> p(n);
-  const double tp = accumulate(p_orig.begin(), p_orig.end(), 0.0);
-
-  std::transform(p_orig.begin(), p_orig.end(), p.begin(),
+  std::transform(weights.begin(), weights.end(), p.begin(),
                  [=] (double x) { return x / tp * n; });
-
-  vector<int> alias(n);
-  vector<double> prob(n);
+  for (auto i = 0u; i < n; ++i)
+  {
+    p_[i] = weights[i] / tp;
+    alias_[i] = i;
+  }
 
   std::stack<uint> small, large;
 
@@ -272,8 +287,8 @@ vector<uint> multinomial_distribution(const vector<double>& p_orig, uint64_t num
     auto g = large.top(), l = small.top();
     large.pop();
     small.pop();
-    prob[l] = p[l];
-    alias[l] = g;
+    keep_[l] = p[l];
+    alias_[l] = g;
     p[g] = (p[g] + p[l]) - 1.0;
     if (p[g] < 1)
       small.push(g);
@@ -282,29 +297,110 @@ vector<uint> multinomial_distribution(const vector<double>& p_orig, uint64_t num
   }
   while (!large.empty())
   {
-    prob[large.top()] = 1;
+    keep_[large.top()] = 1;
     large.pop();
   }
   while (!small.empty())
   {
-    prob[small.top()] = 1;
+    keep_[small.top()] = 1;
     small.pop();
   }
+}
+
+uint AliasTable::sample(scalar r, scalar& p) const
+{
+  // The integer part picks the slot, and the fraction whether to keep it.
+  const auto n = keep_.size();
+  const double x = double(r) * n;
+  const auto slot = std::min<size_t>(n - 1, size_t(x));
+  const uint i = (x - slot) < keep_[slot] ? slot : alias_[slot];
+  p = p_[i];
+  return i;
+}
+
+Distribution2D::Distribution2D(const vector<scalar>& weights, uint w, uint h) :
+  width(w), height(h), conditional_cdf(h * (w + 1)), marginal_cdf(h + 1), density(w * h)
+{
+  assert(weights.size() == w * h);
+
+  // Sum in doubles, so the CDFs of large grids still end at 1.
+  vector<double> row_sums(h);
+  double total = 0;
+  for (auto j = 0u; j < h; ++j)
+  {
+    row_sums[j] = accumulate(weights.begin() + j * w, weights.begin() + (j + 1) * w, 0.0);
+    total += row_sums[j];
+  }
+  assert(total > 0);
+
+  for (auto j = 0u; j < h; ++j)
+  {
+    scalar* cdf = &conditional_cdf[j * (w + 1)];
+    double sum = 0;
+    for (auto i = 0u; i < w; ++i)
+    {
+      sum += weights[j * w + i];
+      cdf[i + 1] = row_sums[j] > 0 ? sum / row_sums[j] : double(i + 1) / w;
+      density[j * w + i] = weights[j * w + i] * w * h / total;
+    }
+  }
+
+  double sum = 0;
+  for (auto j = 0u; j < h; ++j)
+  {
+    sum += row_sums[j];
+    marginal_cdf[j + 1] = sum / total;
+  }
+}
+
+namespace
+{
+  // Invert the CDF over n cells, returning the cell and the position of r
+  // within it, in [0, 1).
+  scalar invert_cdf(const scalar* cdf, uint n, scalar r, uint& cell)
+  {
+    cell = std::min<uint>(n - 1, std::max<long>(0, std::upper_bound(cdf, cdf + n + 1, r) - cdf - 1));
+    while (cell > 0 && cdf[cell + 1] == cdf[cell])
+      --cell;
+
+    const scalar width = cdf[cell + 1] - cdf[cell];
+    return width > 0 ? std::min<scalar>((r - cdf[cell]) / width, 1 - 1e-6) : 0.5;
+  }
+}
+
+Vec2 Distribution2D::sample(const Sample2D& s, scalar& p) const
+{
+  uint i, j;
+  const scalar dv = invert_cdf(&marginal_cdf[0], height, s[1], j);
+  const scalar du = invert_cdf(&conditional_cdf[j * (width + 1)], width, s[0], i);
+
+  p = density[j * width + i];
+  return Vec2((i + du) / width, (j + dv) / height);
+}
+
+scalar Distribution2D::pdf(const Vec2& uv) const
+{
+  const uint i = std::min<uint>(width - 1, std::max<scalar>(0, uv.u * width));
+  const uint j = std::min<uint>(height - 1, std::max<scalar>(0, uv.v * height));
+  return density[j * width + i];
+}
+
+// multinomial sampling via the alias method
+using std::vector;
+vector<uint> multinomial_distribution(const vector<double>& p_orig, uint64_t num_draws)
+{
+  const AliasTable table(p_orig);
 
   std::mt19937_64 eng;
-  std::uniform_int_distribution<decltype(n)> slot_dist(0, n-1);
-  std::uniform_real_distribution<double> alias_dist(0, 1.0);
+  std::uniform_real_distribution<double> dist(0, 1.0);
 
-  vector<uint> draws(n);
+  vector<uint> draws(p_orig.size());
 
   // Execute the distribution;
   for (auto i = 0u; i < num_draws; ++i)
   {
-    int slot = slot_dist(eng);
-    if (alias_dist(eng) < prob[slot])
-      ++draws[slot];
-    else
-      ++draws[alias[slot]];
+    scalar p;
+    ++draws[table.sample(dist(eng), p)];
   }
 
   return draws;
@@ -154,10 +154,92 @@ Vec3 uniform_sphere_sample(const Sample2D& sample);
 scalar uniform_sphere_pdf(const Vec3&);
 Vec3 uniform_sphere_sample(const Sample2D& sample, scalar& p);
 
+/*
+ * Directions within theta_max of the z-axis, with uniform density
+ * 1 / (2 pi (1 - cos_theta_max)) over the solid angle.
+ */
+Vec3 uniform_cone_sample(const Sample2D& sample, scalar cos_theta_max);
+scalar uniform_cone_pdf(scalar cos_theta_max);
+
+/*
+ * The multiple importance sampling weight, by Veach's power heuristic, of a
+ * sample drawn with density p that another strategy would have drawn with
+ * density q. Samples the other strategy can't draw keep all their weight.
+ */
+inline scalar power_heuristic(scalar p, scalar q)
+{
+  return q > 0 ? p * p / (p * p + q * q) : 1;
+}
+
 class Vec2;
 
 Vec2 uniform_sample_disc(const Sample2D& sample);
 Vec2 uniform_sample_disc(const Sample2D& sample, scalar& p);
 
+/*
+ * Barycentric coordinates (of the second and third vertices) of a point
+ * uniformly distributed over a triangle's area.
+ */
+Vec2 uniform_triangle_sample(const Sample2D& sample);
+
 using std::vector;
+
+/*
+ * Walker's alias method: chooses among n outcomes, in proportion to their
+ * weights, in constant time from a single random number.
+ */
+class AliasTable
+{
+public:
+  AliasTable() { }
+  AliasTable(const vector<double>& weights);
+
+  /*
+   * The outcome for r in [0, 1), and its probability.
+   */
+  uint sample(scalar r, scalar& p) const;
+
+  scalar prob(uint i) const { return p_[i]; }
+
+  uint size() const { return p_.size(); }
+
+private:
+  // the chance of keeping each slot, rather than taking its alias
+  vector<double> keep_;
+  vector<uint> alias_;
+
+  // the probability of each outcome
+  vector<scalar> p_;
+};
+
+/*
+ * A piecewise-constant density over [0, 1]^2, proportional to a grid of
+ * weights (row-major, with rows along v). Sampling inverts the marginal CDF
+ * of the rows, then the conditional CDF of the chosen row, each by binary
+ * search.
+ */
+class Distribution2D
+{
+public:
+  Distribution2D() : width(0), height(0) { }
+  Distribution2D(const vector<scalar>& weights, uint width, uint height);
+
+  /*
+   * A point for the sample, and its density p over [0, 1]^2.
+   */
+  Vec2 sample(const Sample2D& s, scalar& p) const;
+
+  scalar pdf(const Vec2& uv) const;
+
+private:
+  uint width, height;
+
+  // height rows of width + 1 entries, then the height + 1 entries over rows,
+  // each rising from 0 to 1
+  vector<scalar> conditional_cdf;
+  vector<scalar> marginal_cdf;
+
+  vector<scalar> density;
+};
+
 vector<uint> multinomial_distribution(const vector<double>& p_org, uint64_t num_draws);
@@ -13,6 +13,10 @@ shared_ptr<Scene> make_scene(const std::string& scene_type)
   {
     return make_shared<KDScene>();
   }
+  if (scene_type == "bvh" || scene_type == "kd-sweep")
+  {
+    return make_shared<KDScene>(accel_type_from_string(scene_type));
+  }
   #endif
   #if FEATURE_BASIC_SCENE
   if (scene_type == "basic")
@@ -24,6 +28,14 @@ shared_ptr<Scene> make_scene(const std::string& scene_type)
   return nullptr;
 }
 
+optional<Intersection> Scene::intersect(const Ray& ray, scalar_fp max_t) const
+{
+  const auto hit = closest_hit(ray, max_t);
+  if (hit.is())
+    return Intersection(hit.get(), ray);
+  return none_tag;
+}
+
 
 #if FEATURE_BASIC_SCENE
 
@@ -67,7 +79,7 @@ Light const* BasicScene::sample_light(scalar r1, scalar& light_prob) const
 }
 
 
-optional<Intersection> BasicScene::intersect(const Ray& ray, scalar_fp max_t) const
+optional<Hit> BasicScene::closest_hit(const Ray& ray, scalar_fp max_t) const
 {
   const Shape* best_shape = nullptr;
   SubGeo best_geom = 0;
@@ -85,7 +97,7 @@ optional<Intersection> BasicScene::intersect(const Ray& ray, scalar_fp max_t) co
     }
   }
   if (best_shape != nullptr)
-    return Intersection(best_shape, best_geom, ray, best_t.get());
+    return Hit{best_shape, best_geom, best_t.get()};
   return none_tag;
 }
 
@@ -5,6 +5,7 @@
 #include "shape.h"
 #include "light.h"
 #include "env_light.h"
+#include "intersection.h"
 #include "util/optional.h"
 
 using std::vector;
@@ -21,16 +22,65 @@ public:
   virtual void prepare() { }
 
   virtual Light const* sample_light(scalar r1, scalar&) const = 0;
+
+  /*
+   * Choose a light for shading isect, favoring the lights likely to
+   * contribute most there. light_prob is the probability of the light
+   * returned, or zero if there is none.
+   */
+  virtual Light const* sample_light(const IntersectionView& isect, scalar r1,
+                                    scalar& light_prob) const
+  {
+    return sample_light(r1, light_prob);
+  }
+
+  /*
+   * The probability that sample_light(isect, ...) chooses light.
+   */
+  virtual scalar light_pmf(const IntersectionView& UNUSED(isect), const Light* UNUSED(light)) const
+  {
+    return lights().empty() ? 0 : scalar(1) / lights().size();
+  }
+
   virtual EmissionSample sample_emission(Sampler& sampler) const = 0;
 
-  virtual optional<Intersection> intersect(const Ray& ray, scalar_fp max_t) const = 0;
-  virtual optional<Intersection> intersect(const Ray& ray) const
+  /*
+   * The light sampling the emission of shape, if any. Integrators that
+   * sample it at a vertex don't also count its emission where their next
+   * bounce hits it.
+   */
+  virtual const Light* area_light(const Shape*) const { return nullptr; }
+
+  /*
+   * The closest hit before max_t, without any shading information.
+   */
+  virtual optional<Hit> closest_hit(const Ray& ray, scalar_fp max_t) const = 0;
+
+  /*
+   * The closest hit before max_t, with the shading information at the hit.
+   */
+  optional<Intersection> intersect(const Ray& ray, scalar_fp max_t) const;
+  optional<Intersection> intersect(const Ray& ray) const
   {
     return intersect(ray, sfp_none);
   }
 
+  /*
+   * True if anything is hit before max_t. Unlike closest_hit, this may stop
+   * at any hit.
+   */
+  virtual bool occluded(const Ray& ray, scalar_fp max_t) const
+  {
+    return closest_hit(ray, max_t).is();
+  }
+
   virtual spectrum environment_light_emission(const Vec3& dir) const = 0;
 
+  /*
+   * The light of environment_light_emission, if it is one of the lights.
+   */
+  virtual const EnvironmentLight* environment_light() const { return nullptr; }
+
   virtual const vector<const Light*>& lights() const = 0;
 
   virtual ~Scene() { }
@@ -51,8 +101,7 @@ public:
   Light const* sample_light(scalar r1, scalar&) const override;
   Ray sample_light_ray(Sampler& sample, spectrum& emit) const;
 
-  using Scene::intersect;
-  optional<Intersection> intersect(const Ray& ray) const override;
+  optional<Hit> closest_hit(const Ray& ray, scalar_fp max_t) const override;
 
   spectrum environment_light_emission(const Vec3& dir) const override;
 
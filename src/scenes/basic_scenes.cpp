@@ -1,4 +1,5 @@
 #include "basic_scenes.h"
+#include "kdscene.h"
 #include "geometries.h"
 #include "textures.h"
 #include "script/proc_texture.h"
@@ -23,15 +24,23 @@ shared_ptr<Material> COLOR(const spectrum& x)
 #include "script/runner.h"
 #include "script/script_util.h"
 
-Camera* lua_scene(Scene& scene, const string& filename)
+Camera* lua_scene(Scene& scene, LuaRunner& runner)
 {
-  LuaRunner runner(filename.c_str());
-
   auto L = runner.state();
   lua_getglobal(L, "scene");
   assert(lua_isfunction(L, -1));
   lua_call(L, 0, 1);
 
+  // acceleration structure ("kd", "kd-sweep" or "bvh"), if the script chooses one
+  script::lua_gettablefield(L, -1, "accelerator");
+  if (lua_isstring(L, -1))
+  {
+    auto kd_scene = dynamic_cast<KDScene*>(&scene);
+    if (kd_scene)
+      kd_scene->set_accelerator(accel_type_from_string(lua_tostring(L, -1)));
+  }
+  lua_pop(L, 1);
+
   // shapes
   script::lua_gettablefield(L, -1, "shapes");
   assert(lua_istable(L, -1));
@@ -5,7 +5,11 @@
 #include "twinkle.h"
 #include "scene.h"
 #include "camera.h"
+#include "script/runner.h"
 
 using std::string;
 
-Camera* lua_scene(Scene& scene, const string&);
+/*
+ * Build the scene from the scene() function of the script loaded in runner.
+ */
+Camera* lua_scene(Scene& scene, LuaRunner& runner);
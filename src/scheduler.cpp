@@ -5,6 +5,9 @@
 #include <thread>
 #include <chrono>
 #include <cassert>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 
 using std::future;
@@ -12,6 +15,8 @@ using std::unique_lock;
 using std::mutex;
 using std::make_shared;
 using std::make_unique;
+using std::lock_guard;
+using std::condition_variable;
 
 
 /**
@@ -187,11 +192,210 @@ LocalThreadScheduler::~LocalThreadScheduler()
     thread.join();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The work-stealing scheduler gives each worker its own deque of tasks. A
+ * worker pops from the back of its own deque, and when that is empty, steals
+ * from the front of the other workers' deques. Workers with nothing to do
+ * sleep on a condition variable instead of polling, and complete_pending
+ * sleeps until the last outstanding task finishes.
+ */
+class WorkStealingScheduler : public Scheduler
+{
+public:
+  WorkStealingScheduler(uint num_threads_ = 0);
+
+  void add_task(shared_ptr<LocalTask> t) override;
+
+  /* blocks until all current tasks are complete. */
+  void complete_pending() override;
+
+  uint concurrency() const override { return pool.size(); }
+
+  ~WorkStealingScheduler();
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<shared_ptr<LocalTask>> tasks;
+  };
+
+  static void worker(WorkStealingScheduler& sched, uint worker_id);
+
+  /*
+   * Find a task for the given worker, either from its own queue or stolen from
+   * another worker. Returns nullptr if every queue is empty.
+   */
+  shared_ptr<LocalTask> find_task(uint worker_id);
+
+  void on_task_completed();
+
+  std::vector<unique_ptr<WorkerQueue>> queues;
+
+  // tasks sitting in a queue, not yet started
+  std::atomic<int> queued_task_count;
+
+  // tasks added and not yet completed
+  std::atomic<int> pending_task_count;
+
+  // number of workers waiting on work_available
+  std::atomic<int> num_sleeping;
+
+  // round-robin index used when adding tasks
+  std::atomic<uint> next_queue;
+
+  std::mutex idle_mutex;
+  condition_variable work_available;
+
+  std::mutex complete_mutex;
+  condition_variable all_complete;
+
+  std::mutex init_mutex;
+  condition_variable all_initialized;
+  uint num_threads_initialized;
+
+  bool shutting_down;
+
+  std::vector<std::thread> pool;
+};
+
+void WorkStealingScheduler::worker(WorkStealingScheduler& scheduler, uint worker_id)
+{
+  register_thread();
+  {
+    lock_guard<std::mutex> lock(scheduler.init_mutex);
+    ++scheduler.num_threads_initialized;
+  }
+  scheduler.all_initialized.notify_all();
+
+  while (true)
+  {
+    auto task = scheduler.find_task(worker_id);
+    if (task)
+    {
+      task->run(worker_id);
+      scheduler.on_task_completed();
+      continue;
+    }
+
+    // Nothing to run anywhere, so sleep until a task is added. num_sleeping is
+    // raised before the queue count is checked, so that add_task either sees
+    // a sleeper and wakes it, or this thread sees the new task.
+    unique_lock<std::mutex> lock(scheduler.idle_mutex);
+    ++scheduler.num_sleeping;
+    scheduler.work_available.wait(lock, [&] {
+        return scheduler.shutting_down || scheduler.queued_task_count > 0; });
+    --scheduler.num_sleeping;
+
+    if (scheduler.shutting_down && scheduler.queued_task_count == 0)
+      break;
+  }
+}
+
+WorkStealingScheduler::WorkStealingScheduler(uint num_threads_)
+  : queued_task_count(0), pending_task_count(0), num_sleeping(0), next_queue(0),
+    num_threads_initialized(0), shutting_down(false)
+{
+  if (num_threads_ == 0)
+    num_threads_ = num_system_procs();
+
+  for (auto i = 0u; i < num_threads_; ++i)
+    queues.push_back(make_unique<WorkerQueue>());
+
+  for (auto i = 0u; i < num_threads_; ++i)
+    pool.emplace_back(WorkStealingScheduler::worker, std::ref(*this), i);
+
+  // Every worker must have registered its thread state before any task uses
+  // it.
+  unique_lock<std::mutex> lock(init_mutex);
+  all_initialized.wait(lock, [&] { return num_threads_initialized == pool.size(); });
+}
+
+void WorkStealingScheduler::add_task(shared_ptr<LocalTask> task)
+{
+  ++pending_task_count;
+
+  auto& queue = *queues[next_queue++ % queues.size()];
+  {
+    lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  ++queued_task_count;
+
+  if (num_sleeping > 0)
+  {
+    // Taking the lock guarantees a sleeper that missed the new count is
+    // already waiting, and will see the notification.
+    { lock_guard<std::mutex> lock(idle_mutex); }
+    work_available.notify_one();
+  }
+}
+
+shared_ptr<LocalTask> WorkStealingScheduler::find_task(uint worker_id)
+{
+  if (queued_task_count == 0)
+    return nullptr;
+
+  const auto num_queues = queues.size();
+  for (auto i = 0u; i < num_queues; ++i)
+  {
+    auto& queue = *queues[(worker_id + i) % num_queues];
+    lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+
+    shared_ptr<LocalTask> task;
+    if (i == 0)
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    --queued_task_count;
+    return task;
+  }
+
+  return nullptr;
+}
+
+void WorkStealingScheduler::on_task_completed()
+{
+  if (--pending_task_count == 0)
+  {
+    { lock_guard<std::mutex> lock(complete_mutex); }
+    all_complete.notify_all();
+  }
+}
+
+void WorkStealingScheduler::complete_pending()
+{
+  unique_lock<std::mutex> lock(complete_mutex);
+  all_complete.wait(lock, [&] { return pending_task_count == 0; });
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+  {
+    lock_guard<std::mutex> lock(idle_mutex);
+    shutting_down = true;
+  }
+  work_available.notify_all();
+
+  for (auto& thread: pool)
+    thread.join();
+}
+
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////
 
-unique_ptr<Scheduler> make_scheduler(uint num_threads)
+unique_ptr<Scheduler> make_scheduler(uint num_threads, const std::string& scheduler_type)
 {
   assert(num_threads > 0);
   if (num_threads == 1)
@@ -200,12 +404,76 @@ unique_ptr<Scheduler> make_scheduler(uint num_threads)
   }
 
   #if FEATURE_MULTITHREADED
-  else
+  else if (scheduler_type == "spin")
   {
     return make_unique<LocalThreadScheduler>(num_threads);
   }
+  else
+  {
+    assert(scheduler_type == "" || scheduler_type == "steal");
+    return make_unique<WorkStealingScheduler>(num_threads);
+  }
   #else
   assert("must run with one thread." && false);
   return nullptr;
   #endif
 }
+
+static Scheduler* _build_scheduler = nullptr;
+
+void set_build_scheduler(Scheduler* scheduler)
+{
+  _build_scheduler = scheduler;
+}
+
+Scheduler* build_scheduler()
+{
+  return _build_scheduler;
+}
+
+namespace
+{
+  // Shared with the tasks, which may outlive run_jobs if the caller ran
+  // their jobs first.
+  struct JobBatch
+  {
+    JobBatch(size_t n) : claimed(new std::atomic_bool[n]), remaining(n)
+    {
+      for (auto i = 0u; i < n; ++i)
+        claimed[i] = false;
+    }
+
+    // run job i here unless some other thread already has
+    void run(const std::vector<std::function<void()>>& jobs, uint i)
+    {
+      if (claimed[i].exchange(true))
+        return;
+
+      jobs[i]();
+
+      lock_guard<mutex> lock(m);
+      if (--remaining == 0)
+        done.notify_all();
+    }
+
+    unique_ptr<std::atomic_bool[]> claimed;
+    size_t remaining;
+    mutex m;
+    condition_variable done;
+  };
+}
+
+void run_jobs(Scheduler& scheduler, const std::vector<std::function<void()>>& jobs)
+{
+  auto batch = make_shared<JobBatch>(jobs.size());
+
+  // Tasks only touch jobs after claiming one, which keeps this call waiting.
+  for (auto i = 0u; i < jobs.size(); ++i)
+    scheduler.add_task(make_shared<FunctionTask>([batch, &jobs, i]() { batch->run(jobs, i); }));
+
+  for (auto i = 0u; i < jobs.size(); ++i)
+    batch->run(jobs, i);
+
+  unique_lock<mutex> lock(batch->m);
+  batch->done.wait(lock, [&]() { return batch->remaining == 0; });
+}
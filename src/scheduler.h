@@ -7,6 +7,8 @@
 #include <future>
 #include <queue>
 #include <memory>
+#include <string>
+#include <functional>
 #include "thread_state.h"
 
 using std::istream;
@@ -22,6 +24,20 @@ public:
   virtual ~LocalTask() {}
 };
 
+/*
+ * Task that runs a callable.
+ */
+class FunctionTask : public LocalTask
+{
+public:
+  FunctionTask(std::function<void()> f_) : f(std::move(f_)) { }
+
+  void run(uint worker_id) override { f(); }
+
+private:
+  std::function<void()> f;
+};
+
 /**
  * A scheduler is responsible for registering each thread it uses.
  */
@@ -42,4 +58,27 @@ public:
   virtual ~Scheduler() { }
 };
 
-unique_ptr<Scheduler> make_scheduler(uint num_threads);
+/*
+ * Run jobs on the scheduler's workers and the calling thread, returning once
+ * all of them are done. Unlike complete_pending, this waits only for these
+ * jobs, and the caller runs any that no worker has started; so it is safe to
+ * call from a task of the same scheduler, as nested parallel builds do.
+ */
+void run_jobs(Scheduler& scheduler, const std::vector<std::function<void()>>& jobs);
+
+/*
+ * Create a scheduler for num_threads threads. scheduler_type chooses the
+ * multi-threaded implementation:
+ *
+ * "steal" (or ""): per-worker deques with work-stealing. Idle workers sleep
+ *                  until work arrives.
+ * "spin": a single shared queue, polled by busy workers.
+ */
+unique_ptr<Scheduler> make_scheduler(uint num_threads, const std::string& scheduler_type = "");
+
+/*
+ * Scheduler that acceleration structures use to build in parallel, or nullptr
+ * (the default) to build on the calling thread.
+ */
+void set_build_scheduler(Scheduler* scheduler);
+Scheduler* build_scheduler();
@@ -0,0 +1,232 @@
+#include <lua.hpp>
+#include <cmath>
+#include "dual.h"
+#include "script/dual_number.h"
+
+#if FEATURE_LUA_SCRIPTING
+
+namespace script
+{
+  namespace
+  {
+    const char* const METATABLE = "twinkle.dual";
+
+    // the value then the gradient, as userdata needn't be aligned for Vec3
+    struct DualData
+    {
+      scalar v, d[3];
+    };
+
+    int push_dual(lua_State* L, const Dual& a)
+    {
+      auto data = static_cast<DualData*>(lua_newuserdata(L, sizeof(DualData)));
+      *data = DualData{a.v, {a.d.x, a.d.y, a.d.z}};
+      luaL_getmetatable(L, METATABLE);
+      lua_setmetatable(L, -2);
+      return 1;
+    }
+
+    // null unless the value at index is a dual number
+    const DualData* test_dual(lua_State* L, int index)
+    {
+      auto data = lua_touserdata(L, index);
+      if (!data || !lua_getmetatable(L, index))
+        return nullptr;
+
+      luaL_getmetatable(L, METATABLE);
+      const bool is_dual = lua_rawequal(L, -1, -2);
+      lua_pop(L, 2);
+      return is_dual ? static_cast<const DualData*>(data) : nullptr;
+    }
+
+    Dual to_dual(lua_State* L, int index)
+    {
+      if (lua_type(L, index) == LUA_TNUMBER)
+        return Dual(lua_tonumber(L, index));
+
+      auto data = static_cast<const DualData*>(luaL_checkudata(L, index, METATABLE));
+      return Dual(data->v, Vec3(data->d[0], data->d[1], data->d[2]));
+    }
+
+    bool is_number(lua_State* L, int index)
+    {
+      return lua_type(L, index) == LUA_TNUMBER;
+    }
+
+    int dual_add(lua_State* L) { return push_dual(L, to_dual(L, 1) + to_dual(L, 2)); }
+    int dual_sub(lua_State* L) { return push_dual(L, to_dual(L, 1) - to_dual(L, 2)); }
+    int dual_mul(lua_State* L) { return push_dual(L, to_dual(L, 1) * to_dual(L, 2)); }
+    int dual_div(lua_State* L) { return push_dual(L, to_dual(L, 1) / to_dual(L, 2)); }
+    int dual_unm(lua_State* L) { return push_dual(L, -to_dual(L, 1)); }
+
+    int dual_pow(lua_State* L)
+    {
+      const Dual a = to_dual(L, 1);
+      if (is_number(L, 2))
+        return push_dual(L, pow(a, lua_tonumber(L, 2)));
+
+      return push_dual(L, exp(to_dual(L, 2) * log(a)));
+    }
+
+    // Lua 5.1 only compares values of the same type with these.
+    int dual_lt(lua_State* L)
+    {
+      lua_pushboolean(L, to_dual(L, 1).v < to_dual(L, 2).v);
+      return 1;
+    }
+
+    int dual_le(lua_State* L)
+    {
+      lua_pushboolean(L, to_dual(L, 1).v <= to_dual(L, 2).v);
+      return 1;
+    }
+
+    // The math functions, on numbers as before and on duals too
+#define DUAL_UNARY(NAME, EXPR)                    \
+    int NAME(lua_State* L)                        \
+    {                                             \
+      if (is_number(L, 1))                        \
+      {                                           \
+        const lua_Number x = lua_tonumber(L, 1);  \
+        lua_pushnumber(L, EXPR);                  \
+        return 1;                                 \
+      }                                           \
+      const Dual x = to_dual(L, 1);               \
+      return push_dual(L, EXPR);                  \
+    }
+
+    DUAL_UNARY(dual_abs, fabs(x))
+    DUAL_UNARY(dual_sqrt, sqrt(x))
+    DUAL_UNARY(dual_sin, sin(x))
+    DUAL_UNARY(dual_cos, cos(x))
+    DUAL_UNARY(dual_exp, exp(x))
+    DUAL_UNARY(dual_log, log(x))
+    DUAL_UNARY(dual_floor, floor(x))
+
+#undef DUAL_UNARY
+
+    int math_pow(lua_State* L)
+    {
+      if (is_number(L, 1) && is_number(L, 2))
+      {
+        lua_pushnumber(L, std::pow(lua_tonumber(L, 1), lua_tonumber(L, 2)));
+        return 1;
+      }
+      return dual_pow(L);
+    }
+
+    int math_atan2(lua_State* L)
+    {
+      if (is_number(L, 1) && is_number(L, 2))
+      {
+        lua_pushnumber(L, std::atan2(lua_tonumber(L, 1), lua_tonumber(L, 2)));
+        return 1;
+      }
+      return push_dual(L, atan2(to_dual(L, 1), to_dual(L, 2)));
+    }
+
+    int math_fmod(lua_State* L)
+    {
+      if (is_number(L, 1) && is_number(L, 2))
+      {
+        lua_pushnumber(L, std::fmod(lua_tonumber(L, 1), lua_tonumber(L, 2)));
+        return 1;
+      }
+
+      const Dual a = to_dual(L, 1), b = to_dual(L, 2);
+      const scalar q = std::trunc(a.v / b.v);
+      return push_dual(L, a - b * q);
+    }
+
+    template <bool MIN>
+    int math_extremum(lua_State* L)
+    {
+      const int n = lua_gettop(L);
+      bool numbers = true;
+      for (int i = 1; i <= n; ++i)
+        numbers = numbers && is_number(L, i);
+
+      if (numbers)
+      {
+        lua_Number best = luaL_checknumber(L, 1);
+        for (int i = 2; i <= n; ++i)
+        {
+          const lua_Number x = lua_tonumber(L, i);
+          best = MIN ? std::min(best, x) : std::max(best, x);
+        }
+        lua_pushnumber(L, best);
+        return 1;
+      }
+
+      Dual best = to_dual(L, 1);
+      for (int i = 2; i <= n; ++i)
+        best = MIN ? min(best, to_dual(L, i)) : max(best, to_dual(L, i));
+      return push_dual(L, best);
+    }
+  }
+
+  void register_dual(lua_State* L)
+  {
+    luaL_newmetatable(L, METATABLE);
+    luaL_Reg metamethods[] = {{"__add", dual_add},
+                              {"__sub", dual_sub},
+                              {"__mul", dual_mul},
+                              {"__div", dual_div},
+                              {"__unm", dual_unm},
+                              {"__pow", dual_pow},
+                              {"__lt", dual_lt},
+                              {"__le", dual_le},
+                              {NULL, NULL}};
+    luaL_register(L, NULL, metamethods);
+    lua_pop(L, 1);
+
+    luaL_Reg math_functions[] = {{"abs", dual_abs},
+                                 {"sqrt", dual_sqrt},
+                                 {"sin", dual_sin},
+                                 {"cos", dual_cos},
+                                 {"exp", dual_exp},
+                                 {"log", dual_log},
+                                 {"floor", dual_floor},
+                                 {"pow", math_pow},
+                                 {"atan2", math_atan2},
+                                 {"fmod", math_fmod},
+                                 {"min", math_extremum<true>},
+                                 {"max", math_extremum<false>},
+                                 {NULL, NULL}};
+    luaL_register(L, "math", math_functions);
+    lua_pop(L, 1);
+  }
+
+  bool lua_eval_dual(lua_State* L, const char* fn, const Vec3& p, scalar& value, Vec3& grad)
+  {
+    lua_getglobal(L, fn);
+    push_dual(L, Dual(p.x, Vec3::x_axis));
+    push_dual(L, Dual(p.y, Vec3::y_axis));
+    push_dual(L, Dual(p.z, Vec3::z_axis));
+
+    if (lua_pcall(L, 3, 1, 0) != 0)
+    {
+      lua_pop(L, 1);
+      return false;
+    }
+
+    bool ok = true;
+    if (is_number(L, -1))
+    {
+      value = lua_tonumber(L, -1);
+      grad = Vec3::zero;
+    }
+    else if (auto data = test_dual(L, -1))
+    {
+      value = data->v;
+      grad = Vec3(data->d[0], data->d[1], data->d[2]);
+    }
+    else
+      ok = false;
+
+    lua_pop(L, 1);
+    return ok;
+  }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "vec3.h"
+
+struct lua_State;
+
+namespace script
+{
+  /*
+   * Register dual numbers for Lua functions of points: a userdata with the
+   * arithmetic metamethods, and versions of the math library functions that
+   * take them as well as plain numbers.
+   */
+  void register_dual(lua_State* L);
+
+  /*
+   * Call the global function fn with dual numbers for x, y and z, giving its
+   * value and gradient at p in one call. False if the function failed on
+   * them, for instance by comparing one with a plain number, which Lua 5.1
+   * can't overload.
+   */
+  bool lua_eval_dual(lua_State* L, const char* fn, const Vec3& p, scalar& value, Vec3& grad);
+}
@@ -5,6 +5,9 @@
 #include "script/make_geometry.h"
 #include "script/proc_implicit.h"
 #include "geometry/geometry_util.h"
+#include "geometry/sdf.h"
+#include "geometry/implicit_union.h"
+#include <iostream>
 
 using std::make_shared;
 
@@ -76,20 +79,28 @@ namespace script
       return script_geometry(L, make_shared<Plane>(v, d));
     }
 
+    /*
+     * geom.mesh(filename [, bbox] [, accel]), where accel is "kd", "kd-sweep" or "bvh".
+     */
     int mesh(lua_State* L)
     {
-      LUA_CHECK_RANGE_ARGS(L, 1, 2);
+      LUA_CHECK_RANGE_ARGS(L, 1, 3);
 
       const char* s = lua_tostring(L, 1);
 
-      if (lua_gettop(L) == 2)
+      auto accel = AccelType::KD_TREE;
+      int num_args = lua_gettop(L);
+      if (num_args >= 2 && lua_type(L, num_args) == LUA_TSTRING)
+        accel = accel_type_from_string(lua_tostring(L, num_args--));
+
+      if (num_args == 2)
       {
         auto box = lua_tobbox(L, 2);
-        return script_geometry(L, load_mesh(s, box));
+        return script_geometry(L, load_mesh(s, box, accel));
       }
       else
       {
-        return script_geometry(L, load_mesh(s));
+        return script_geometry(L, load_mesh(s, accel));
       }
     }
 
@@ -115,6 +126,17 @@ namespace script
         return script_geometry(L, make_shared<ImplicitWithGrad>(name, grad_name, lc, box));
     }
 
+    int implicit_batch(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 3);
+
+      auto name = std::string{lua_tostring(L, 1)};
+      scalar lc = lua_tonumber(L, 2);
+      auto box = lua_tobbox(L, 3);
+
+      return script_geometry(L, make_shared<ImplicitBatch>(name, lc, box));
+    }
+
     int heightfield(lua_State* L)
     {
       LUA_CHECK_NUM_ARGS(L, 7);
@@ -138,8 +160,8 @@ namespace script
           return height;
         };
 
-      return script_geometry(L, heightfield_mesh(f, Vec2(x_min, z_min), Vec2(x_max, z_max), 
-                                                 xd, zd));
+      return script_geometry(L, make_shared<Heightfield>(f, Vec2(x_min, z_min), Vec2(x_max, z_max),
+                                                         xd, zd));
     }
 
     int parametric(lua_State* L)
@@ -169,6 +191,108 @@ namespace script
                                                 ud, vd));
     }
 
+    /*
+     * geom.sdf(node [, bbox]) traces the zero set of an sdf node, within bbox
+     * if given, or else the bounds of the node.
+     */
+    int sdf(lua_State* L)
+    {
+      LUA_CHECK_RANGE_ARGS(L, 1, 2);
+
+      auto node = lua_tosdf(L, 1);
+      if (lua_gettop(L) == 2)
+        return script_geometry(L, ::sdf::make_surface(*node, lua_tobbox(L, 2)));
+
+      const auto box = ::sdf::node_bounds(*node);
+      if (!box.is())
+      {
+        std::cerr << "geom.sdf needs a bounding box for an unbounded sdf\n";
+        exit(1);
+      }
+      return script_geometry(L, ::sdf::make_surface(*node, box.get()));
+    }
+
+    /*
+     * geom.cache_distances(geom, resolution [, max_megabytes]) gives an
+     * implicit surface a cache of distance bounds, with resolution cells along
+     * the longest side of its box, coarsened to fit in max_megabytes (64 by
+     * default). Returns the same geometry.
+     */
+    int cache_distances(lua_State* L)
+    {
+      LUA_CHECK_RANGE_ARGS(L, 2, 3);
+
+      auto surface = dynamic_cast<ImplicitSurface*>(lua_togeometry(L, 1));
+      if (!surface)
+      {
+        std::cerr << "geom.cache_distances needs an implicit surface\n";
+        exit(1);
+      }
+
+      const uint resolution = lua_tonumber(L, 2);
+      const scalar megabytes = lua_gettop(L) == 3 ? lua_tonumber(L, 3) : 64;
+      surface->cache_distances(resolution, megabytes * (1 << 20));
+
+      lua_pushvalue(L, 1);
+      return 1;
+    }
+
+    /*
+     * geom.tracing(geom, method [, relaxation]) sets how rays are traced
+     * through an implicit surface: "sphere", or "relaxed" for over-relaxed
+     * steps (1.6 times the safe distance by default). Returns the same
+     * geometry.
+     */
+    int tracing(lua_State* L)
+    {
+      LUA_CHECK_RANGE_ARGS(L, 2, 3);
+
+      auto surface = dynamic_cast<ImplicitSurface*>(lua_togeometry(L, 1));
+      if (!surface)
+      {
+        std::cerr << "geom.tracing needs an implicit surface\n";
+        exit(1);
+      }
+
+      const std::string method = lua_tostring(L, 2);
+      if (method == "sphere")
+        surface->set_tracing(ImplicitSurface::Tracing::SPHERE);
+      else if (method == "relaxed")
+        surface->set_tracing(ImplicitSurface::Tracing::RELAXED,
+                             lua_gettop(L) == 3 ? lua_tonumber(L, 3) : 1.6);
+      else
+      {
+        std::cerr << "unknown tracing method " << method << "\n";
+        exit(1);
+      }
+
+      lua_pushvalue(L, 1);
+      return 1;
+    }
+
+    /*
+     * geom.implicit_union(geom, ...) is the union of implicit surfaces as one
+     * surface, evaluating only the parts whose bounds lie near each point.
+     */
+    int implicit_union(lua_State* L)
+    {
+      assert(lua_gettop(L) >= 1);
+
+      vector<const ImplicitSurface*> parts;
+      for (int i = 1; i <= lua_gettop(L); ++i)
+      {
+        auto part = dynamic_cast<const ImplicitSurface*>(lua_togeometry(L, i));
+        if (!part)
+        {
+          std::cerr << "geom.implicit_union needs implicit surfaces\n";
+          exit(1);
+        }
+        parts.push_back(part);
+      }
+
+      return script_geometry(L, make_implicit_union(parts));
+    }
+
     namespace transform
     {
       int scale(lua_State* L)
@@ -16,9 +16,14 @@ namespace script
     int box(lua_State*);
     int plane(lua_State*);
     int implicit(lua_State*);
+    int implicit_batch(lua_State*);
     int mesh(lua_State*);
     int heightfield(lua_State*);
     int parametric(lua_State*);
+    int sdf(lua_State*);
+    int cache_distances(lua_State*);
+    int tracing(lua_State*);
+    int implicit_union(lua_State*);
 
     namespace transform
     {
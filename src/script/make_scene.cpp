@@ -5,6 +5,7 @@
 #include "env_light.h"
 #include "camera.h"
 #include "script/script_util.h"
+#include "script/proc_texture.h"
 
 using std::make_shared;
 
@@ -74,7 +75,13 @@ namespace script
       auto tex = lua_totexture(L, 1);
       auto tex2d = reinterpret_cast<const Texture2D*>(tex);
       assert(tex2d);
-      auto light = make_shared<EnvironmentLight>(tex2d);
+
+      // Script textures can only be evaluated here in the loading state.
+      shared_ptr<EnvironmentLight> light;
+      if (auto st = dynamic_cast<const ScriptTexture*>(tex))
+        light = make_shared<EnvironmentLight>(tex2d, LoadingScriptTexture(L, *st));
+      else
+        light = make_shared<EnvironmentLight>(tex2d);
 
       return script_light(L, light);
     }
@@ -0,0 +1,142 @@
+#include <lua.hpp>
+#include "geometry/sdf.h"
+#include "script/script_util.h"
+#include "script/make_sdf.h"
+
+namespace script
+{
+  namespace sdf
+  {
+    namespace
+    {
+      shared_ptr<const ::sdf::Node> node_at(lua_State* L, int index)
+      {
+        return lua_tosdf(L, index)->shared_from_this();
+      }
+
+      // the nodes from index to the top of the stack
+      vector<shared_ptr<const ::sdf::Node>> nodes_from(lua_State* L, int index)
+      {
+        vector<shared_ptr<const ::sdf::Node>> nodes;
+        for (int i = index; i <= lua_gettop(L); ++i)
+          nodes.push_back(node_at(L, i));
+        return nodes;
+      }
+    }
+
+    int sphere(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 1);
+
+      return script_sdf(L, ::sdf::sphere(lua_tonumber(L, 1)));
+    }
+
+    int box(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 1);
+
+      return script_sdf(L, ::sdf::box(lua_tovector(L, 1)));
+    }
+
+    int torus(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::torus(lua_tonumber(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int cylinder(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::cylinder(lua_tonumber(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int capsule(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 3);
+
+      return script_sdf(L, ::sdf::capsule(lua_tovector(L, 1), lua_tovector(L, 2),
+                                          lua_tonumber(L, 3)));
+    }
+
+    int plane(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::plane(lua_tovector(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int csg_union(lua_State* L)
+    {
+      assert(lua_gettop(L) >= 1);
+
+      return script_sdf(L, ::sdf::csg_union(nodes_from(L, 1)));
+    }
+
+    int intersection(lua_State* L)
+    {
+      assert(lua_gettop(L) >= 1);
+
+      return script_sdf(L, ::sdf::intersection(nodes_from(L, 1)));
+    }
+
+    int difference(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::difference(node_at(L, 1), node_at(L, 2)));
+    }
+
+    int smooth_union(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 3);
+
+      return script_sdf(L, ::sdf::smooth_union(node_at(L, 1), node_at(L, 2),
+                                               lua_tonumber(L, 3)));
+    }
+
+    int rounded(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::rounded(node_at(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int shell(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::shell(node_at(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int translate(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::translate(node_at(L, 1), lua_tovector(L, 2)));
+    }
+
+    int rotate(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 3);
+
+      return script_sdf(L, ::sdf::rotate(node_at(L, 1), lua_tovector(L, 2),
+                                         lua_tonumber(L, 3)));
+    }
+
+    int scale(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::scale(node_at(L, 1), lua_tonumber(L, 2)));
+    }
+
+    int repetition(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 2);
+
+      return script_sdf(L, ::sdf::repeat(node_at(L, 1), lua_tovector(L, 2)));
+    }
+  }
+}
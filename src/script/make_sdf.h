@@ -0,0 +1,29 @@
+#pragma once
+
+struct lua_State;
+
+namespace script
+{
+  namespace sdf
+  {
+    int sphere(lua_State*);
+    int box(lua_State*);
+    int torus(lua_State*);
+    int cylinder(lua_State*);
+    int capsule(lua_State*);
+    int plane(lua_State*);
+
+    int csg_union(lua_State*);
+    int intersection(lua_State*);
+    int difference(lua_State*);
+    int smooth_union(lua_State*);
+
+    int rounded(lua_State*);
+    int shell(lua_State*);
+
+    int translate(lua_State*);
+    int rotate(lua_State*);
+    int scale(lua_State*);
+    int repetition(lua_State*);
+  }
+}
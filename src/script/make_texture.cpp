@@ -1,6 +1,9 @@
 #include "script/make_texture.h"
 #include "script/script_util.h"
+#include "script/proc_texture.h"
+#include "script/runner.h"
 #include "textures.h"
+#include <iostream>
 
 using std::make_shared;
 
@@ -74,5 +77,61 @@ namespace script
 
       return script_texture(L, make_shared<HosekSkyTexture>(sun_dir, turbidity, false));
     }
+
+    int script(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 1);
+
+      auto fn_name = lua_tostring(L, 1);
+
+      return script_texture(L, make_shared<ScriptTexture>(fn_name));
+    }
+
+    int script_batch(lua_State* L)
+    {
+      LUA_CHECK_NUM_ARGS(L, 1);
+
+      auto fn_name = lua_tostring(L, 1);
+
+      return script_texture(L, make_shared<ScriptTexture>(fn_name, true));
+    }
+
+    /*
+     * texture.bake(tex, width, height [, tolerance]) returns tex baked into a
+     * bilinear-filtered image, or tex itself if baking loses too much.
+     */
+    int bake(lua_State* L)
+    {
+      LUA_CHECK_RANGE_ARGS(L, 3, 4);
+
+      auto tex = dynamic_cast<const Texture2D*>(lua_totexture(L, 1));
+      if (!tex)
+      {
+        std::cerr << "texture.bake: only 2D textures can be baked\n";
+        lua_pushvalue(L, 1);
+        return 1;
+      }
+
+      const lua_Number width = luaL_checknumber(L, 2);
+      const lua_Number height = luaL_checknumber(L, 3);
+      luaL_argcheck(L, width >= 1, 2, "width must be at least 1");
+      luaL_argcheck(L, height >= 1, 3, "height must be at least 1");
+      const scalar tolerance = lua_gettop(L) == 4 ? luaL_checknumber(L, 4) : 0.01;
+
+      shared_ptr<ImageTexture2D> baked;
+      if (auto st = dynamic_cast<const ScriptTexture*>(tex))
+        baked = bake_texture(LoadingScriptTexture(L, *st), uint(width), uint(height), tolerance);
+      else
+        baked = bake_texture(*tex, uint(width), uint(height), tolerance);
+
+      if (!baked)
+      {
+        std::cerr << "texture.bake: keeping the texture, which no resolution matches\n";
+        lua_pushvalue(L, 1);
+        return 1;
+      }
+
+      return script_texture(L, baked);
+    }
   }
 }
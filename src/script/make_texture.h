@@ -13,5 +13,8 @@ namespace script
     int image(lua_State* L);
     int normal(lua_State* L);
     int hoseksky(lua_State* L);
+    int script(lua_State* L);
+    int script_batch(lua_State* L);
+    int bake(lua_State* L);
   }
 }
@@ -1,7 +1,9 @@
 #include "thread_state.h"
 #include "script/proc_implicit.h"
 #include "script/script_util.h"
+#include "script/dual_number.h"
 #include <lua.hpp>
+#include <iostream>
 
 #if FEATURE_LUA_SCRIPTING
 
@@ -21,7 +23,7 @@ namespace script
       },
       lc,
       bbox
-      ), fn_name(fn_name_)
+      ), fn_name(fn_name_), dual_gradients(true)
   {
   }
   scalar lua_eval(lua_State* L, const char* fn, scalar x, scalar y, scalar z)
@@ -53,10 +55,24 @@ namespace script
 
     const auto cfn = fn_name.c_str();
 
+    if (dual_gradients)
+    {
+      scalar value;
+      Vec3 grad;
+      if (lua_eval_dual(L, cfn, v, value, grad))
+        return grad;
+
+      if (dual_gradients.exchange(false))
+        std::cerr << "implicit function " << fn_name << " fails on dual numbers, "
+                  << "using differences for its normals\n";
+    }
+
+    // forward differences
     const scalar GRAD_STEP = 0.0001;
-    return Vec3(lua_eval(L, cfn, v.x+GRAD_STEP, v.y, v.z),
-                lua_eval(L, cfn, v.x, v.y + GRAD_STEP, v.z),
-                lua_eval(L, cfn, v.x, v.y, v.z + GRAD_STEP));
+    const scalar f0 = lua_eval(L, cfn, v.x, v.y, v.z);
+    return Vec3(lua_eval(L, cfn, v.x + GRAD_STEP, v.y, v.z) - f0,
+                lua_eval(L, cfn, v.x, v.y + GRAD_STEP, v.z) - f0,
+                lua_eval(L, cfn, v.x, v.y, v.z + GRAD_STEP) - f0) / GRAD_STEP;
   }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -109,6 +125,63 @@ namespace script
     return lua_grad_eval(L, grad, v[0], v[1], v[2]);
   }
 
+////////////////////////////////////////////////////////////////////////////////
+
+
+  ImplicitBatch::ImplicitBatch(const std::string& fn_name_, scalar lc, const bounds::AABB& bbox)
+    : ImplicitSurface(
+      [=] (const Vec3* points, scalar* values, uint n)
+      {
+        this->eval_func(points, values, n);
+      },
+      gradient_from_batch(
+        [=] (const Vec3* points, scalar* values, uint n)
+        {
+          this->eval_func(points, values, n);
+        }),
+      lc,
+      bbox,
+      BATCH_SIZE
+      ), fn_name(fn_name_)
+  {
+  }
+
+  void lua_eval_batch(lua_State* L, const char* fn, const Vec3* points, scalar* values, uint n)
+  {
+    lua_getglobal(L, fn);
+    for (int c = 0; c < 3; ++c)
+    {
+      lua_createtable(L, n, 0);
+      for (auto i = 0u; i < n; ++i)
+      {
+        lua_pushnumber(L, points[i][c]);
+        lua_rawseti(L, -2, i + 1);
+      }
+    }
+
+    lua_call(L, 3, 1);
+
+    // A missing value would read as zero, which is a hit.
+    if (!lua_istable(L, -1) || lua_objlen(L, -1) < n)
+      luaL_error(L, "implicit function %s must return an array of %d values", fn, int(n));
+
+    for (auto i = 0u; i < n; ++i)
+    {
+      lua_rawgeti(L, -1, i + 1);
+      values[i] = lua_tonumber(L, -1);
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+
+  void ImplicitBatch::eval_func(const Vec3* points, scalar* values, uint n)
+  {
+    auto& runner = get_thread_lua_runner();
+    auto L = runner.state();
+
+    lua_eval_batch(L, fn_name.c_str(), points, values, n);
+  }
+
 }
 
 #endif
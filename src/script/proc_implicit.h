@@ -1,6 +1,7 @@
 #pragma once
 
 #include "geometry/implicit.h"
+#include <atomic>
 #include <memory>
 #include <string>
 
@@ -18,6 +19,9 @@ namespace script
     Vec3 grad_func(const Vec3&);
 
     std::string fn_name;
+
+    // cleared if the function fails on dual numbers, for differences instead
+    std::atomic_bool dual_gradients;
   };
 
   class ImplicitWithGrad : public ImplicitSurface
@@ -34,4 +38,21 @@ namespace script
     const char *fn, *grad;
   };
 
+  /*
+   * A function of arrays of x, y and z, returning an array of distances, so
+   * that sphere tracing calls it once for several steps.
+   */
+  class ImplicitBatch : public ImplicitSurface
+  {
+  public:
+    ImplicitBatch(const std::string& fn_name, scalar lc, const ::bounds::AABB& bbox);
+
+    static const uint BATCH_SIZE = 8;
+
+  private:
+    void eval_func(const Vec3* points, scalar* values, uint n);
+
+    std::string fn_name;
+  };
+
 }
@@ -3,7 +3,8 @@
 
 #if FEATURE_LUA_SCRIPTING
 
-ScriptTexture::ScriptTexture(const string& fn_name) : _fn_name(fn_name)
+ScriptTexture::ScriptTexture(const string& fn_name, bool batched)
+  : _fn_name(fn_name), _batched(batched)
 {
 
 }
@@ -12,7 +13,47 @@ spectrum ScriptTexture::at_coord(const Vec2& uv) const
 {
   auto& s = get_thread_lua_runner();
 
+  if (_batched)
+  {
+    spectrum value;
+    s.call_texture_2d_batch(_fn_name, &uv, &value, 1);
+    return value;
+  }
+
   return s.call_texture_2d_function(_fn_name, uv);
 }
 
+void ScriptTexture::at_coords(const Vec2* uvs, spectrum* values, uint n) const
+{
+  if (!_batched)
+  {
+    Texture2D::at_coords(uvs, values, n);
+    return;
+  }
+
+  get_thread_lua_runner().call_texture_2d_batch(_fn_name, uvs, values, n);
+}
+
+LoadingScriptTexture::LoadingScriptTexture(lua_State* L, const ScriptTexture& tex)
+  : L(L), fn(tex.function_name()), batched(tex.batched())
+{
+
+}
+
+spectrum LoadingScriptTexture::at_coord(const Vec2& uv) const
+{
+  spectrum value;
+  at_coords(&uv, &value, 1);
+  return value;
+}
+
+void LoadingScriptTexture::at_coords(const Vec2* uvs, spectrum* values, uint n) const
+{
+  if (batched)
+    call_texture_2d_batch(L, fn, uvs, values, n);
+  else
+    for (auto i = 0u; i < n; ++i)
+      values[i] = call_texture_2d_function(L, fn, uvs[i]);
+}
+
 #endif
@@ -3,14 +3,43 @@
 #include <string>
 #include "texture.h"
 
+struct lua_State;
+
 class ScriptTexture : public Texture2D
 {
 public:
-  ScriptTexture(const std::string& fn_name);
+  /*
+   * A batched function takes arrays of coordinates, as in
+   * call_texture_2d_batch, rather than one coordinate at a time.
+   */
+  ScriptTexture(const std::string& fn_name, bool batched = false);
 
   spectrum at_coord(const Vec2& uv) const override;
+  void at_coords(const Vec2* uvs, spectrum* values, uint n) const override;
+
+  const std::string& function_name() const { return _fn_name; }
+  bool batched() const { return _batched; }
 
 private:
   std::string _fn_name;
+  bool _batched;
+};
+
+/*
+ * A script texture evaluated in the state still loading the scene, for
+ * baking before the render threads have states of their own.
+ */
+class LoadingScriptTexture : public Texture2D
+{
+public:
+  LoadingScriptTexture(lua_State* L, const ScriptTexture& tex);
+
+  spectrum at_coord(const Vec2& uv) const override;
+  void at_coords(const Vec2* uvs, spectrum* values, uint n) const override;
+
+private:
+  lua_State* L;
+  std::string fn;
+  bool batched;
 };
 
@@ -3,6 +3,7 @@
 #include "vec3.h"
 #include "script/runner.h"
 #include "script/script_util.h"
+#include "script/snapshot.h"
 #include "util/filesystem.h"
 
 #if FEATURE_LUA_SCRIPTING
@@ -25,9 +26,18 @@ LuaRunner::LuaRunner(const string& filename) : _state(luaL_newstate())
     return;
 
   assert(filesystem::exists(filename.c_str()));
-  luaL_openlibs(state());
+  open_libraries();
 
-  script::register_all(state());
+  // Remember what the libraries define, so snapshot() captures only the
+  // script's own globals.
+  auto L = state();
+  lua_pushnil(L);
+  while (lua_next(L, LUA_GLOBALSINDEX))
+  {
+    if (lua_type(L, -2) == LUA_TSTRING)
+      _builtin_globals.push_back(lua_tostring(L, -2));
+    lua_pop(L, 1);
+  }
 
   auto result = luaL_dofile(state(), filename.c_str());
   if (result != 0)
@@ -39,18 +49,91 @@ LuaRunner::LuaRunner(const string& filename) : _state(luaL_newstate())
   }
 }
 
+LuaRunner::LuaRunner(const LuaSnapshot& snapshot) : _state(luaL_newstate())
+{
+  open_libraries();
+  snapshot.restore(state());
+}
+
+void LuaRunner::open_libraries()
+{
+  luaL_openlibs(state());
+  script::register_all(state());
+}
+
+shared_ptr<const LuaSnapshot> LuaRunner::snapshot()
+{
+  return std::make_shared<LuaSnapshot>(state(), _builtin_globals);
+}
+
 spectrum LuaRunner::call_texture_2d_function(const string& fn, const Vec2& v)
 {
-  auto L = state();
+  return ::call_texture_2d_function(state(), fn, v);
+}
+
+namespace
+{
+  // Re-raise the error a texture function left on the stack, naming it.
+  void texture_error(lua_State* L, const string& fn)
+  {
+    luaL_error(L, "texture function %s: %s", fn.c_str(), lua_tostring(L, -1));
+  }
+}
+
+spectrum call_texture_2d_function(lua_State* L, const string& fn, const Vec2& v)
+{
   lua_getglobal(L, fn.c_str());
   lua_pushnumber(L, v[0]);
   lua_pushnumber(L, v[1]);
 
-  lua_pcall(L, 2, 3, 0);
+  if (lua_pcall(L, 2, 3, 0) != 0)
+    texture_error(L, fn);
 
   spectrum s(lua_tonumber(L, -3), lua_tonumber(L, -2), lua_tonumber(L, -1));
   lua_pop(L, 3);
   return s;
 }
 
+void LuaRunner::call_texture_2d_batch(const string& fn, const Vec2* coords,
+                                      spectrum* values, uint n)
+{
+  ::call_texture_2d_batch(state(), fn, coords, values, n);
+}
+
+void call_texture_2d_batch(lua_State* L, const string& fn, const Vec2* coords,
+                           spectrum* values, uint n)
+{
+  lua_getglobal(L, fn.c_str());
+  for (int c = 0; c < 2; ++c)
+  {
+    lua_createtable(L, n, 0);
+    for (auto i = 0u; i < n; ++i)
+    {
+      lua_pushnumber(L, coords[i][c]);
+      lua_rawseti(L, -2, i + 1);
+    }
+  }
+
+  if (lua_pcall(L, 2, 3, 0) != 0)
+    texture_error(L, fn);
+
+  // Missing values would read as zero, and go unnoticed.
+  for (int c = -3; c < 0; ++c)
+  {
+    if (!lua_istable(L, c) || lua_objlen(L, c) < n)
+      luaL_error(L, "texture function %s must return three arrays of %d values", fn.c_str(), int(n));
+  }
+
+  for (auto i = 0u; i < n; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      lua_rawgeti(L, c - 3, i + 1);
+      values[i][c] = lua_tonumber(L, -1);
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 3);
+}
+
 #endif
@@ -2,16 +2,34 @@
 
 #include <lua.hpp>
 #include <memory>
+#include <vector>
 #include <vec2.h>
 #include <spectrum.h>
 
 using std::unique_ptr;
+using std::shared_ptr;
+
+class LuaSnapshot;
 
 struct lua_deleter
 {
   void operator()(lua_State* ptr) const;
 };
 
+/*
+ * Call the global texture function fn, of (u, v), in the state L. Errors in
+ * fn are raised again in L, naming fn.
+ */
+spectrum call_texture_2d_function(lua_State* L, const string& fn, const Vec2& coord);
+
+/*
+ * Call the global texture function fn once for n coordinates. It takes an
+ * array of u and an array of v, and returns arrays of red, green and blue,
+ * with a value for each coordinate; otherwise this raises an error in L.
+ */
+void call_texture_2d_batch(lua_State* L, const string& fn, const Vec2* coords,
+                           spectrum* values, uint n);
+
 // instantiation of lua state
 class LuaRunner
 {
@@ -19,10 +37,29 @@ public:
   LuaRunner();
   LuaRunner(const string& filename);
 
+  /*
+   * Lightweight runner for worker threads, holding only the functions and data
+   * captured from a scene script. The script itself is not run again.
+   */
+  LuaRunner(const LuaSnapshot& snapshot);
+
   spectrum call_texture_2d_function(const string&, const Vec2& coord);
+  void call_texture_2d_batch(const string&, const Vec2* coords, spectrum* values, uint n);
 
   lua_State* state() { return _state.get(); }
 
+  /*
+   * Capture the globals defined so far by the script, for use in per-thread
+   * runners. Call this after the scene has been built, so that callbacks
+   * defined while building it are included.
+   */
+  shared_ptr<const LuaSnapshot> snapshot();
+
 private:
+  void open_libraries();
+
   unique_ptr<lua_State, lua_deleter> _state;
+
+  // globals defined before the script ran
+  std::vector<string> _builtin_globals;
 };
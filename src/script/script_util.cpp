@@ -6,10 +6,13 @@
 #include "vec3.h"
 #include "spectrum.h"
 #include "shape.h"
+#include "geometry/sdf.h"
 #include "script/make_geometry.h"
 #include "script/make_material.h"
 #include "script/make_scene.h"
 #include "script/make_texture.h"
+#include "script/make_sdf.h"
+#include "script/dual_number.h"
 #include <lua.hpp>
 #include <iostream>
 #include <cassert>
@@ -84,6 +87,7 @@ namespace script
   LUA_METHODS(Texture, texture);
   LUA_METHODS(Camera, camera);
   LUA_METHODS(Light, light);
+  LUA_METHODS(::sdf::Node, sdf);
 
   LUA_NATIVE_METHODS(::bounds::AABB, bbox);
 
@@ -169,6 +173,8 @@ namespace script
 
   void register_all(lua_State* L)
   {
+    register_dual(L);
+
     luaL_Reg bounds_package[] = {{"bbox", bounds::bbox},
                                  {NULL, NULL}};
     luaL_register(L, "bounds", bounds_package);
@@ -178,9 +184,14 @@ namespace script
                                {"box", geometry::box},
                                {"plane", geometry::plane},
                                {"implicit", geometry::implicit},
+                               {"implicit_batch", geometry::implicit_batch},
                                {"mesh", geometry::mesh},
                                {"heightfield", geometry::heightfield},
                                {"parametric", geometry::parametric},
+                               {"sdf", geometry::sdf},
+                               {"cache_distances", geometry::cache_distances},
+                               {"tracing", geometry::tracing},
+                               {"implicit_union", geometry::implicit_union},
 
                                {"translate", geometry::transform::translate},
                                {"scale", geometry::transform::scale},
@@ -217,9 +228,31 @@ namespace script
                                   {"image", texture::image},
                                   {"normal", texture::normal},
                                   {"hoseksky", texture::hoseksky},
+                                  {"script", texture::script},
+                                  {"script_batch", texture::script_batch},
+                                  {"bake", texture::bake},
                                   {NULL, NULL}};
     luaL_register(L, "texture", texture_package);
 
+    luaL_Reg sdf_package[] = {{"sphere", sdf::sphere},
+                              {"box", sdf::box},
+                              {"torus", sdf::torus},
+                              {"cylinder", sdf::cylinder},
+                              {"capsule", sdf::capsule},
+                              {"plane", sdf::plane},
+                              {"union", sdf::csg_union},
+                              {"intersection", sdf::intersection},
+                              {"difference", sdf::difference},
+                              {"smooth_union", sdf::smooth_union},
+                              {"round", sdf::rounded},
+                              {"shell", sdf::shell},
+                              {"translate", sdf::translate},
+                              {"rotate", sdf::rotate},
+                              {"scale", sdf::scale},
+                              {"repetition", sdf::repetition},
+                              {NULL, NULL}};
+    luaL_register(L, "sdf", sdf_package);
+
     lua_register(L, "shape", shape);
   }
 }
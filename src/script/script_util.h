@@ -17,6 +17,10 @@ namespace bounds
 {
   class AABB;
 }
+namespace sdf
+{
+  class Node;
+}
 
 class Vec3;
 class spectrum;
@@ -40,6 +44,7 @@ namespace script
   int script_texture(lua_State*, shared_ptr<Texture>);
   int script_camera(lua_State*, shared_ptr<Camera>);
   int script_light(lua_State*, shared_ptr<Light>);
+  int script_sdf(lua_State*, shared_ptr<::sdf::Node>);
 
   int script_bbox(lua_State*, const ::bounds::AABB&);
 
@@ -53,6 +58,7 @@ namespace script
   Texture* lua_totexture(lua_State*, int);
   Camera* lua_tocamera(lua_State*, int);
   Light* lua_tolight(lua_State*, int);
+  ::sdf::Node* lua_tosdf(lua_State*, int);
 
   ::bounds::AABB lua_tobbox(lua_State*, int);
 
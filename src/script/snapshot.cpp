@@ -0,0 +1,249 @@
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include "script/snapshot.h"
+
+#if FEATURE_LUA_SCRIPTING
+
+namespace
+{
+  int write_bytecode(lua_State*, const void* p, size_t size, void* ud)
+  {
+    static_cast<string*>(ud)->append(static_cast<const char*>(p), size);
+    return 0;
+  }
+
+  // Worker threads would otherwise run with nil in place of the value,
+  // without any sign of why.
+  void warn_dropped(lua_State* L, int index, const string& where)
+  {
+    std::cerr << "script snapshot: " << where << " holds a " << lua_typename(L, lua_type(L, index))
+              << ", which can't be copied to worker threads and will be nil there\n";
+  }
+}
+
+LuaSnapshot::LuaSnapshot(lua_State* L, const vector<string>& builtins)
+{
+  // Builtin libraries are referenced by name rather than copied, along with
+  // the functions they contain.
+  for (const auto& name : builtins)
+  {
+    lua_getglobal(L, name.c_str());
+    if (lua_istable(L, -1) || lua_isfunction(L, -1))
+      builtin_paths.emplace(lua_topointer(L, -1), name);
+
+    if (lua_istable(L, -1))
+    {
+      lua_pushnil(L);
+      while (lua_next(L, -2))
+      {
+        if (lua_type(L, -2) == LUA_TSTRING && lua_isfunction(L, -1))
+          builtin_paths.emplace(lua_topointer(L, -1), name + "." + lua_tostring(L, -2));
+        lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 1);
+  }
+
+  lua_pushnil(L);
+  while (lua_next(L, LUA_GLOBALSINDEX))
+  {
+    if (lua_type(L, -2) == LUA_TSTRING)
+    {
+      string name = lua_tostring(L, -2);
+      if (std::find(builtins.begin(), builtins.end(), name) == builtins.end())
+      {
+        auto v = capture(L, lua_gettop(L), name);
+        if (v.kind != Kind::NIL)
+          globals.emplace_back(name, v);
+      }
+    }
+    lua_pop(L, 1);
+  }
+
+  builtin_paths.clear();
+  captured.clear();
+}
+
+LuaSnapshot::Value LuaSnapshot::capture(lua_State* L, int index, const string& where)
+{
+  // Each level of nested tables and upvalues holds a key and a value.
+  luaL_checkstack(L, 3, where.c_str());
+
+  Value v;
+  switch (lua_type(L, index))
+  {
+  case LUA_TBOOLEAN:
+    v.kind = Kind::BOOLEAN;
+    v.number = lua_toboolean(L, index);
+    return v;
+  case LUA_TNUMBER:
+    v.kind = Kind::NUMBER;
+    v.number = lua_tonumber(L, index);
+    return v;
+  case LUA_TSTRING:
+  {
+    size_t len;
+    auto s = lua_tolstring(L, index, &len);
+    v.kind = Kind::STRING;
+    v.str.assign(s, len);
+    return v;
+  }
+  case LUA_TTABLE:
+  case LUA_TFUNCTION:
+    break;
+  case LUA_TNIL:
+    return v;
+  default:
+    warn_dropped(L, index, where);
+    return v;
+  }
+
+  const void* ptr = lua_topointer(L, index);
+  auto builtin = builtin_paths.find(ptr);
+  if (builtin != builtin_paths.end())
+  {
+    v.kind = Kind::BUILTIN;
+    v.str = builtin->second;
+    return v;
+  }
+
+  // C functions outside the builtin libraries can't be reproduced.
+  if (lua_iscfunction(L, index))
+  {
+    warn_dropped(L, index, where);
+    return v;
+  }
+
+  auto seen = captured.find(ptr);
+  if (seen != captured.end())
+  {
+    v.kind = Kind::OBJECT;
+    v.object = seen->second;
+    return v;
+  }
+
+  // Register the object before visiting its contents, so cycles terminate.
+  const int id = objects.size();
+  captured.emplace(ptr, id);
+  objects.emplace_back();
+
+  Object obj;
+  if (lua_isfunction(L, index))
+  {
+    obj.is_function = true;
+    lua_pushvalue(L, index);
+    lua_dump(L, write_bytecode, &obj.bytecode);
+    lua_pop(L, 1);
+
+    for (int n = 1; lua_getupvalue(L, index, n); ++n)
+    {
+      obj.upvalues.push_back(capture(L, lua_gettop(L), "upvalue " + std::to_string(n) + " of " + where));
+      lua_pop(L, 1);
+    }
+  }
+  else
+  {
+    lua_pushnil(L);
+    while (lua_next(L, index))
+    {
+      auto key = capture(L, lua_gettop(L) - 1, "a key of " + where);
+      const string field = lua_type(L, -2) == LUA_TSTRING ? where + "." + lua_tostring(L, -2) : where + "[...]";
+      auto value = capture(L, lua_gettop(L), field);
+      if (key.kind != Kind::NIL && value.kind != Kind::NIL)
+        obj.fields.emplace_back(key, value);
+      lua_pop(L, 1);
+    }
+  }
+  objects[id] = std::move(obj);
+
+  v.kind = Kind::OBJECT;
+  v.object = id;
+  return v;
+}
+
+void LuaSnapshot::push(lua_State* L, const Value& v, int objects_index) const
+{
+  switch (v.kind)
+  {
+  case Kind::NIL:
+    lua_pushnil(L);
+    break;
+  case Kind::BOOLEAN:
+    lua_pushboolean(L, v.number != 0);
+    break;
+  case Kind::NUMBER:
+    lua_pushnumber(L, v.number);
+    break;
+  case Kind::STRING:
+    lua_pushlstring(L, v.str.data(), v.str.size());
+    break;
+  case Kind::OBJECT:
+    lua_rawgeti(L, objects_index, v.object + 1);
+    break;
+  case Kind::BUILTIN:
+  {
+    auto dot = v.str.find('.');
+    lua_getglobal(L, v.str.substr(0, dot).c_str());
+    if (dot != string::npos)
+    {
+      lua_getfield(L, -1, v.str.substr(dot + 1).c_str());
+      lua_remove(L, -2);
+    }
+    break;
+  }
+  }
+}
+
+void LuaSnapshot::restore(lua_State* L) const
+{
+  // Create every object first, so references between them (including cycles)
+  // can be filled in afterwards.
+  lua_createtable(L, objects.size(), 0);
+  const int objects_index = lua_gettop(L);
+
+  for (auto i = 0u; i < objects.size(); ++i)
+  {
+    const auto& obj = objects[i];
+    if (obj.is_function)
+    {
+      auto result = luaL_loadbuffer(L, obj.bytecode.data(), obj.bytecode.size(), "snapshot");
+      assert(result == 0);
+    }
+    else
+      lua_createtable(L, 0, obj.fields.size());
+
+    lua_rawseti(L, objects_index, i + 1);
+  }
+
+  for (auto i = 0u; i < objects.size(); ++i)
+  {
+    const auto& obj = objects[i];
+    lua_rawgeti(L, objects_index, i + 1);
+
+    for (auto n = 0u; n < obj.upvalues.size(); ++n)
+    {
+      push(L, obj.upvalues[n], objects_index);
+      lua_setupvalue(L, -2, n + 1);
+    }
+
+    for (const auto& field : obj.fields)
+    {
+      push(L, field.first, objects_index);
+      push(L, field.second, objects_index);
+      lua_rawset(L, -3);
+    }
+
+    lua_pop(L, 1);
+  }
+
+  for (const auto& g : globals)
+  {
+    push(L, g.second, objects_index);
+    lua_setglobal(L, g.first.c_str());
+  }
+
+  lua_pop(L, 1);
+}
+
+#endif
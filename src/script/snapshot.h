@@ -0,0 +1,77 @@
+#pragma once
+
+#include <lua.hpp>
+#include "twinkle.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using std::string;
+using std::vector;
+using std::pair;
+
+/*
+ * A copy of the globals defined by a scene script, which can be restored into
+ * a fresh lua state without running the script again.
+ *
+ * Lua functions are stored as bytecode (lua_dump) along with their upvalues,
+ * and tables are copied by value. References to builtin globals (math.sin,
+ * geom, ...) are stored by name and resolved in the new state. Userdata
+ * (geometry, materials, ...) belongs to the scene and is not copied; it, and
+ * any other C function, becomes nil in the copy, with a warning naming it.
+ *
+ * Upvalues shared between closures become separate copies, so callbacks should
+ * not rely on mutating shared state.
+ */
+class LuaSnapshot
+{
+public:
+  /*
+   * Capture every global of L not named in builtins, which should hold the
+   * globals present before the script ran.
+   */
+  LuaSnapshot(lua_State* L, const vector<string>& builtins);
+
+  /*
+   * Define the captured globals in L, which must already have the builtin
+   * libraries registered.
+   */
+  void restore(lua_State* L) const;
+
+private:
+  enum class Kind
+  {
+    NIL,
+    BOOLEAN,
+    NUMBER,
+    STRING,
+    OBJECT,
+    BUILTIN
+  };
+
+  struct Value
+  {
+    Kind kind = Kind::NIL;
+    lua_Number number = 0;
+    string str; // string contents, or the path of a builtin
+    int object = -1;
+  };
+
+  struct Object
+  {
+    bool is_function = false;
+    string bytecode;
+    vector<Value> upvalues;
+    vector<pair<Value, Value>> fields;
+  };
+
+  // where names the value in the warning if it can't be copied
+  Value capture(lua_State* L, int index, const string& where);
+  void push(lua_State* L, const Value& v, int objects_index) const;
+
+  std::unordered_map<const void*, string> builtin_paths;
+  std::unordered_map<const void*, int> captured;
+
+  vector<Object> objects;
+  vector<pair<string, Value>> globals;
+};
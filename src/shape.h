@@ -26,6 +26,11 @@ public:
     return geometry->intersect(r, max_t, subgeo);
   }
 
+  bool occluded(const Ray& r, scalar_fp max_t) const
+  {
+    return geometry->occluded(r, max_t);
+  }
+
   spectrum emission(const IntersectionView& isect) const
   {
     return material->emission(isect);
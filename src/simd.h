@@ -0,0 +1,157 @@
+#pragma once
+
+#include "twinkle.h"
+#include <cmath>
+
+// Packed lanes only where they beat the scalar code: doubles need an AVX
+// register (split across two SSE2 registers they are slower), floats fit SSE.
+#if FEATURE_SIMD_VECTORS && (defined(USE_DOUBLES) ? defined(__AVX__) : defined(__SSE2__))
+#define SIMD_PACKED_VECTORS 1
+#include <immintrin.h>
+#else
+#define SIMD_PACKED_VECTORS 0
+#endif
+
+/*
+ * Packed arithmetic on the lanes of a VectorT3: x, y, z, plus a padding lane
+ * (zero on construction) that never affects the other three.
+ *
+ * With FEATURE_SIMD_VECTORS, vectors are padded to four lanes: one AVX
+ * register in double precision (build with SIMD=avx), one SSE register in
+ * single precision. Otherwise vectors keep three lanes and the operations
+ * are plain loops.
+ *
+ * Each operation rounds exactly as the corresponding scalar expression does,
+ * so results do not depend on the configuration.
+ */
+namespace simd
+{
+#if SIMD_PACKED_VECTORS
+  const int WIDTH = 4;
+#else
+  const int WIDTH = 3;
+#endif
+
+#if SIMD_PACKED_VECTORS && defined(USE_DOUBLES)
+  struct packed { __m256d v; };
+
+  inline packed load(const scalar* p) { return {_mm256_loadu_pd(p)}; }
+  inline void store(scalar* p, packed a) { _mm256_storeu_pd(p, a.v); }
+  inline packed broadcast(scalar s) { return {_mm256_set1_pd(s)}; }
+
+  inline packed operator +(packed a, packed b) { return {_mm256_add_pd(a.v, b.v)}; }
+  inline packed operator -(packed a, packed b) { return {_mm256_sub_pd(a.v, b.v)}; }
+  inline packed operator *(packed a, packed b) { return {_mm256_mul_pd(a.v, b.v)}; }
+  inline packed operator /(packed a, packed b) { return {_mm256_div_pd(a.v, b.v)}; }
+  inline packed operator -(packed a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+
+  // Operand order matches std::min and std::max.
+  inline packed min(packed a, packed b) { return {_mm256_min_pd(b.v, a.v)}; }
+  inline packed max(packed a, packed b) { return {_mm256_max_pd(b.v, a.v)}; }
+  inline packed abs(packed a) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)}; }
+  inline packed sqrt(packed a) { return {_mm256_sqrt_pd(a.v)}; }
+
+  // a < b ? x : y, lane by lane
+  inline packed select_less(packed a, packed b, packed x, packed y)
+  {
+    return {_mm256_blendv_pd(y.v, x.v, _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ))};
+  }
+
+  inline scalar sum3(packed a)
+  {
+    const __m128d lo = _mm256_castpd256_pd128(a.v);
+    const __m128d hi = _mm256_extractf128_pd(a.v, 1);
+    return (_mm_cvtsd_f64(lo) + _mm_cvtsd_f64(_mm_unpackhi_pd(lo, lo))) + _mm_cvtsd_f64(hi);
+  }
+
+#ifdef __AVX2__
+  inline packed yzx(packed a) { return {_mm256_permute4x64_pd(a.v, _MM_SHUFFLE(3, 0, 2, 1))}; }
+#else
+  // (y, z, x, x), from (x, y, x, y) and (z, w, x, y)
+  inline packed yzx(packed a)
+  {
+    return {_mm256_shuffle_pd(_mm256_permute2f128_pd(a.v, a.v, 0x00),
+                              _mm256_permute2f128_pd(a.v, a.v, 0x01), 1)};
+  }
+#endif
+
+#elif SIMD_PACKED_VECTORS
+  struct packed { __m128 v; };
+
+  inline packed load(const scalar* p) { return {_mm_loadu_ps(p)}; }
+  inline void store(scalar* p, packed a) { _mm_storeu_ps(p, a.v); }
+  inline packed broadcast(scalar s) { return {_mm_set1_ps(s)}; }
+
+  inline packed operator +(packed a, packed b) { return {_mm_add_ps(a.v, b.v)}; }
+  inline packed operator -(packed a, packed b) { return {_mm_sub_ps(a.v, b.v)}; }
+  inline packed operator *(packed a, packed b) { return {_mm_mul_ps(a.v, b.v)}; }
+  inline packed operator /(packed a, packed b) { return {_mm_div_ps(a.v, b.v)}; }
+  inline packed operator -(packed a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; }
+
+  // Operand order matches std::min and std::max.
+  inline packed min(packed a, packed b) { return {_mm_min_ps(b.v, a.v)}; }
+  inline packed max(packed a, packed b) { return {_mm_max_ps(b.v, a.v)}; }
+  inline packed abs(packed a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+  inline packed sqrt(packed a) { return {_mm_sqrt_ps(a.v)}; }
+
+  // a < b ? x : y, lane by lane
+  inline packed select_less(packed a, packed b, packed x, packed y)
+  {
+    const __m128 less = _mm_cmplt_ps(a.v, b.v);
+    return {_mm_or_ps(_mm_and_ps(less, x.v), _mm_andnot_ps(less, y.v))};
+  }
+
+  inline scalar sum3(packed a)
+  {
+    const __m128 xy = _mm_add_ss(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_add_ss(xy, _mm_movehl_ps(a.v, a.v)));
+  }
+
+  inline packed yzx(packed a) { return {_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1))}; }
+
+#else
+  struct packed { scalar v[WIDTH]; };
+
+  inline packed load(const scalar* p) { return {{p[0], p[1], p[2]}}; }
+  inline void store(scalar* p, packed a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; }
+  inline packed broadcast(scalar s) { return {{s, s, s}}; }
+
+  template <typename Op>
+  inline packed map(packed a, packed b, Op op)
+  {
+    return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2])}};
+  }
+
+  inline packed operator +(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return x + y; }); }
+  inline packed operator -(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return x - y; }); }
+  inline packed operator *(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return x * y; }); }
+  inline packed operator /(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return x / y; }); }
+  inline packed operator -(packed a) { return {{-a.v[0], -a.v[1], -a.v[2]}}; }
+
+  inline packed min(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return y < x ? y : x; }); }
+  inline packed max(packed a, packed b) { return map(a, b, [](scalar x, scalar y) { return x < y ? y : x; }); }
+  inline packed abs(packed a) { return {{std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2])}}; }
+  inline packed sqrt(packed a) { return {{std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2])}}; }
+
+  inline packed select_less(packed a, packed b, packed x, packed y)
+  {
+    return {{a.v[0] < b.v[0] ? x.v[0] : y.v[0], a.v[1] < b.v[1] ? x.v[1] : y.v[1],
+             a.v[2] < b.v[2] ? x.v[2] : y.v[2]}};
+  }
+
+  inline scalar sum3(packed a) { return a.v[0] + a.v[1] + a.v[2]; }
+
+  inline packed yzx(packed a) { return {{a.v[1], a.v[2], a.v[0]}}; }
+#endif
+
+  inline scalar dot(packed a, packed b)
+  {
+    return sum3(a * b);
+  }
+
+  // (a.yzx * b.zxy - a.zxy * b.yzx), with one shuffle fewer
+  inline packed cross(packed a, packed b)
+  {
+    return yzx(a * yzx(b) - yzx(a) * b);
+  }
+}
@@ -36,7 +36,7 @@ spectrum::operator spectrum_XYZ() const
 
 spectrum spectrum::clamp(scalar m, scalar M) const
 {
-  return spectrum{::max(m, ::min(x, M)), ::max(m, ::min(y, M)), ::max(m, ::min(z, M))};
+  return unpack(simd::max(simd::broadcast(m), simd::min(pack(), simd::broadcast(M))));
 }
 
 spectrum spectrum::from_hex(uint hex)
@@ -87,7 +87,7 @@ spectrum spectrum::from_hsv(scalar hue, scalar sat, scalar value)
 
 spectrum spectrum::max(const spectrum &a, const spectrum& b)
 {
-  return spectrum{::max(a.x, b.x), ::max(a.y, b.y), ::max(a.z, b.z)};
+  return unpack(simd::max(a.pack(), b.pack()));
 }
 
 scalar spectrum::luminance() const
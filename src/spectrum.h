@@ -25,15 +25,13 @@ public:
   spectrum() : VectorT3<spectrum>() { }
   explicit spectrum(scalar s) : VectorT3<spectrum>(s) { }
   explicit spectrum(scalar x, scalar y, scalar z) : VectorT3<spectrum>(x, y, z) { }
-  spectrum(const spectrum& s) : VectorT3<spectrum>(s.x, s.y, s.z) { }
+  spectrum(const spectrum& s) = default;
 
   spectrum(const spectrum_XYZ&);
   
   spectrum& operator*=(const spectrum& r)
   {
-    this->x *= r.x;
-    this->y *= r.y;
-    this->z *= r.z;
+    simd::store(lanes, pack() * r.pack());
     return *this;
   }
 
@@ -47,21 +45,17 @@ public:
 
   spectrum operator*(const spectrum& r) const
   {
-    spectrum a = *this;
-    return (a *= r); 
+    return unpack(pack() * r.pack());
   }
 
   spectrum& operator/=(const spectrum& r)
   {
-    this->x /= r.x;
-    this->y /= r.y;
-    this->z /= r.z;
+    simd::store(lanes, pack() / r.pack());
     return *this;
   }
   spectrum operator/(const spectrum& r) const
   {
-    spectrum a = *this;
-    return (a /= r); 
+    return unpack(pack() / r.pack());
   }
   
   spectrum clamp(scalar m = 0.0, scalar M = 1.0) const;
@@ -132,6 +126,23 @@ public:
 
 };
 
+/*
+ * a * b * spectrum{s}, the usual form of a path contribution (emission or
+ * incoming radiance, times reflectance, times a scalar weight), in one pass.
+ */
+inline spectrum scaled_product(const spectrum& a, const spectrum& b, scalar s)
+{
+  return spectrum::unpack(a.pack() * b.pack() * simd::broadcast(s));
+}
+
+/*
+ * total += a * b * spectrum{s}
+ */
+inline void add_scaled_product(spectrum& total, const spectrum& a, const spectrum& b, scalar s)
+{
+  simd::store(total.lanes, total.pack() + a.pack() * b.pack() * simd::broadcast(s));
+}
+
 scalar tvi(scalar luminance);
 
 ostream&  operator<<(ostream& out, spectrum s);
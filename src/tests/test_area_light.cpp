@@ -0,0 +1,124 @@
+#include "tests/test_util.h"
+#include "geometry/sphere.h"
+#include "geometry/plane.h"
+#include "geometry/quad.h"
+#include "textures.h"
+#include "kdscene.h"
+#include "area_light.h"
+
+namespace
+{
+  // The irradiance at isect from light, by next-event estimation, ignoring
+  // occlusion.
+  scalar irradiance(const Light& light, const Intersection& isect, int samples)
+  {
+    UniformSampler sampler;
+    sampler.seed(7);
+
+    scalar total = 0;
+    for (int i = 0; i < samples; ++i)
+    {
+      const auto ls = light.sample_emission(isect, sampler);
+      if (ls && ls.p() > 0)
+        total += ls.emission().luminance() * std::max<scalar>(ls.direction().dot(isect.normal), 0) / ls.p();
+    }
+    return total / samples;
+  }
+
+  class AreaLightFixture
+  {
+  public:
+    AreaLightFixture() : color(spectrum{2.0}), emissive(&color),
+                         floor(Vec3::z_axis, 0), diffuse(0, spectrum{0.5}),
+                         floor_shape(&floor, &diffuse)
+    {
+    }
+
+    SolidColor color;
+    EmissiveMaterial emissive;
+    Plane floor;
+    RoughColorMaterial diffuse;
+    Shape floor_shape;
+  };
+
+  SUITE(area_light)
+  {
+    TEST(alias_table)
+    {
+      const vector<double> weights{1, 0, 3, 0.5, 2.5, 1};
+      AliasTable table(weights);
+
+      vector<int> counts(weights.size());
+      const int samples = 80000;
+      for (int i = 0; i < samples; ++i)
+      {
+        scalar p;
+        const auto k = table.sample((i + 0.5) / samples, p);
+        CHECK_EQUAL(table.prob(k), p);
+        ++counts[k];
+      }
+
+      for (auto i = 0u; i < weights.size(); ++i)
+      {
+        CHECK_CLOSE(weights[i] / 8, table.prob(i), PRECISE_EPS);
+        CHECK_CLOSE(weights[i] / 8, scalar(counts[i]) / samples, 1e-3);
+      }
+    }
+
+    // A sphere of radiance L subtending sin(theta) = r / d gives the facing
+    // point an irradiance of pi L sin^2(theta).
+    TEST_FIXTURE(AreaLightFixture, sphere_light)
+    {
+      Sphere sphere(Vec3{0.0, 0.0, 3.0}, 1.0);
+      Shape shape(&sphere, &emissive);
+      const auto light = make_area_light(&shape);
+      CHECK(light != nullptr);
+
+      Intersection isect(&floor_shape, 0, Vec3::zero);
+      CHECK_CLOSE(PI * 2.0 / 9.0, irradiance(*light, isect, 20000), 1e-3);
+    }
+
+    // Sampling the triangles of a quad must agree with finding it by chance.
+    TEST_FIXTURE(AreaLightFixture, mesh_light)
+    {
+      auto quad = make_quad(Vec3{1.0, 0.0, 0.0}, Vec3{0.0, 0.5, 0.0});
+      Shape shape(quad.get(), &emissive);
+      const auto light = make_area_light(&shape);
+      CHECK(light != nullptr);
+
+      const Vec3 pos{0.5, 0.2, -1.5};
+      Intersection isect(&floor_shape, 0, pos);
+
+      UniformSampler sampler;
+      sampler.seed(11);
+      const int samples = 400000;
+      int hits = 0;
+      for (int i = 0; i < samples; ++i)
+      {
+        SubGeo geo;
+        const auto dir = cosine_weighted_hemisphere_sample(sampler.sample_2d());
+        if (quad->intersect(Ray{pos, dir}, sfp_none, geo).is())
+          ++hits;
+      }
+      const scalar expected = PI * 2.0 * hits / samples;
+
+      CHECK_CLOSE(expected, irradiance(*light, isect, 100000), 0.01 * expected);
+    }
+
+    // Emissive shapes become lights of the scene, and non-emissive ones don't.
+    TEST_FIXTURE(AreaLightFixture, scene_lights)
+    {
+      Sphere sphere(Vec3{0.0, 0.0, 3.0}, 1.0);
+      Shape shape(&sphere, &emissive);
+
+      KDScene scene;
+      scene.add(&shape);
+      scene.add(&floor_shape);
+      scene.prepare();
+
+      CHECK_EQUAL(1u, scene.lights().size());
+      CHECK(scene.area_light(&shape) == scene.lights()[0]);
+      CHECK(scene.area_light(&floor_shape) == nullptr);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#include "tests/test_util.h"
+#include "geometry/sphere.h"
+#include "bvh.h"
+
+namespace
+{
+  SUITE(bvh)
+  {
+    // The BVH must report the same closest hit as testing every sphere.
+    TEST(closest_hit)
+    {
+      vector<shared_ptr<Sphere>> shapes;
+      vector<const Geometry*> spheres;
+      for (int i = 0; i < 500; ++i)
+      {
+        shapes.push_back(make_shared<Sphere>(Vec3{rus(), rus(), rus()} * 4.0, rf() * 0.3 + 0.01));
+        spheres.push_back(shapes.back().get());
+      }
+
+      bvh::TreeOptions opt;
+      bvh::Tree<Geometry> tree(spheres, opt);
+      CHECK_EQUAL(int(spheres.size()), tree.count_objects());
+      CHECK(tree.height() <= bvh::Tree<Geometry>::MAX_DEPTH);
+
+      for (int i = 0; i < 1000; ++i)
+      {
+        Ray ray(random_normal() * 8.0, random_normal());
+
+        scalar_fp best_t = sfp_none;
+        const Geometry* best = nullptr;
+        for (auto s : spheres)
+        {
+          SubGeo geo;
+          auto t = s->intersect(ray, best_t, geo);
+          if (t < best_t)
+          {
+            best_t = t;
+            best = s;
+          }
+        }
+
+        const Geometry* hit = nullptr;
+        SubGeo geo;
+        auto t = tree.intersect(ray, sfp_none, hit, geo);
+        CHECK_EQUAL(best_t.is(), t.is());
+        if (best_t.is() && t.is())
+        {
+          CHECK_CLOSE(best_t.get(), t.get(), EPS);
+          CHECK_EQUAL(best, hit);
+        }
+      }
+    }
+
+    TEST(occluded)
+    {
+      vector<shared_ptr<Sphere>> shapes;
+      vector<const Geometry*> spheres;
+      for (int i = 0; i < 500; ++i)
+      {
+        shapes.push_back(make_shared<Sphere>(Vec3{rus(), rus(), rus()} * 4.0, rf() * 0.3 + 0.01));
+        spheres.push_back(shapes.back().get());
+      }
+
+      bvh::Tree<Geometry> tree(spheres, bvh::TreeOptions());
+
+      for (int i = 0; i < 1000; ++i)
+      {
+        Ray ray(random_normal() * 8.0, random_normal());
+        const scalar_fp max_t = (i % 2) ? sfp_none : scalar_fp{rf() * 8};
+
+        bool expected = false;
+        for (auto s : spheres)
+          expected = expected || s->occluded(ray, max_t);
+
+        CHECK_EQUAL(expected, tree.occluded(ray, max_t));
+      }
+    }
+
+    TEST(empty)
+    {
+      bvh::Tree<Geometry> tree(vector<const Geometry*>{}, bvh::TreeOptions());
+      const Geometry* hit = nullptr;
+      SubGeo geo;
+      CHECK(!tree.intersect(Ray(Vec3::zero, Vec3::x_axis), sfp_none, hit, geo).is());
+    }
+  }
+}
@@ -0,0 +1,88 @@
+#include "tests/test_util.h"
+#include "geometry/plane.h"
+#include "textures.h"
+#include "env_light.h"
+#include "math_util.h"
+
+namespace
+{
+  // A dim sky with a small, bright sun.
+  class SunTexture : public Texture2D
+  {
+  public:
+    SunTexture(const Vec3& sun) : sun(sun.normal()) { }
+
+    spectrum at_coord(const Vec2& uv) const override
+    {
+      return spectrum{scalar(from_euler_uv(uv).dot(sun) > 0.999 ? 5000.0 : 0.5)};
+    }
+
+    Vec3 sun;
+  };
+
+  SUITE(env_light)
+  {
+    // Sampling follows the weights, and the density integrates to one.
+    TEST(distribution_2d)
+    {
+      const uint w = 4, h = 3;
+      const vector<scalar> weights{1, 0, 2, 1,
+                                   0, 0, 0, 0,
+                                   3, 1, 0, 4};
+      Distribution2D dist(weights, w, h);
+
+      scalar integral = 0;
+      for (auto j = 0u; j < h; ++j)
+        for (auto i = 0u; i < w; ++i)
+          integral += dist.pdf(Vec2((i + 0.5) / w, (j + 0.5) / h)) / (w * h);
+      CHECK_CLOSE(1.0, integral, PRECISE_EPS);
+
+      vector<int> counts(w * h);
+      const int n = 200;
+      for (int a = 0; a < n; ++a)
+      {
+        for (int b = 0; b < n; ++b)
+        {
+          scalar p;
+          const auto uv = dist.sample(Sample2D{{scalar((a + 0.5) / n), scalar((b + 0.5) / n)}}, p);
+          CHECK_CLOSE(dist.pdf(uv), p, PRECISE_EPS);
+          ++counts[std::min<uint>(h - 1, uv.v * h) * w + std::min<uint>(w - 1, uv.u * w)];
+        }
+      }
+
+      for (auto k = 0u; k < w * h; ++k)
+        CHECK_CLOSE(weights[k] / 12, scalar(counts[k]) / (n * n), 1e-3);
+    }
+
+    // Sampled directions report the density of pdf(), and the irradiance
+    // estimate matches the sky plus the sun's cap of solid angle 2 pi (1 -
+    // 0.999), whose cosine barely varies across it.
+    TEST(sun_irradiance)
+    {
+      const Vec3 sun = Vec3{0.3, 0.2, 1.0}.normal();
+      SunTexture sky(sun);
+      EnvironmentLight light(&sky);
+
+      Plane plane(Vec3::z_axis, 0);
+      RoughColorMaterial diffuse(0, spectrum{0.5});
+      Shape shape(&plane, &diffuse);
+      Intersection isect(&shape, 0, Vec3::zero);
+
+      UniformSampler sampler;
+      sampler.seed(5);
+
+      scalar total = 0;
+      const int samples = 100000;
+      for (int i = 0; i < samples; ++i)
+      {
+        const auto ls = light.sample_emission(isect, sampler);
+        CHECK(ls);
+        CHECK_CLOSE(light.pdf(ls.direction()), ls.p(), 1e-3 * ls.p());
+        total += ls.emission().luminance() * std::max<scalar>(0, ls.direction().z) / ls.p();
+      }
+
+      const scalar expected = 0.5 * PI + (5000.0 - 0.5) * sun.z * 2 * PI * 0.001;
+      CHECK_CLOSE(expected, total / samples, 0.01 * expected);
+    }
+  }
+}
@@ -0,0 +1,83 @@
+#include <set>
+#include "tests/test_util.h"
+#include "grid_tasks.h"
+
+namespace
+{
+  // Every pixel is covered by exactly one tile.
+  bool covers_exactly(const vector<Film::Rect>& tiles, uint w, uint h)
+  {
+    Array2D<uint> count(w, h);
+    for (const auto& r : tiles)
+    {
+      if (r.x + r.width > w || r.y + r.height > h)
+        return false;
+      for (auto y = r.y; y < r.y + r.height; ++y)
+        for (auto x = r.x; x < r.x + r.width; ++x)
+          ++count(x, y);
+    }
+
+    for (auto y = 0u; y < h; ++y)
+      for (auto x = 0u; x < w; ++x)
+        if (count(x, y) != 1)
+          return false;
+    return true;
+  }
+
+  SUITE(grid_tasks)
+  {
+    TEST(grid_cover)
+    {
+      for (auto order : {TileOrder::COLUMN_MAJOR, TileOrder::HILBERT})
+      {
+        CHECK(covers_exactly(subtasks_from_grid(400, 300, 4, order), 400, 300));
+        CHECK(covers_exactly(subtasks_from_grid(37, 91, 3, order), 37, 91));
+      }
+    }
+
+    TEST(hilbert_bijection)
+    {
+      const uint n = 16;
+      std::set<uint64_t> indices;
+      for (auto y = 0u; y < n; ++y)
+        for (auto x = 0u; x < n; ++x)
+        {
+          auto d = hilbert_index(n, x, y);
+          CHECK(d < n * n);
+          indices.insert(d);
+        }
+      CHECK_EQUAL(n * n, indices.size());
+    }
+
+    TEST(cost_split)
+    {
+      const uint w = 120, h = 80, threads = 4;
+      cost_subtask_options opt;
+
+      // Nearly all of the cost is concentrated in one corner.
+      Array2D<scalar> cost(w, h);
+      scalar total = 0;
+      for (auto y = 0u; y < h; ++y)
+        for (auto x = 0u; x < w; ++x)
+        {
+          cost(x, y) = (x < 20 && y < 20) ? 100.0 : 1.0;
+          total += cost(x, y);
+        }
+
+      auto tiles = subtasks_from_cost(cost, threads, opt);
+      CHECK(covers_exactly(tiles, w, h));
+
+      const scalar budget = total / (threads * opt.tiles_per_thread);
+      for (const auto& r : tiles)
+      {
+        scalar tile_cost = 0;
+        for (auto y = r.y; y < r.y + r.height; ++y)
+          for (auto x = r.x; x < r.x + r.width; ++x)
+            tile_cost += cost(x, y);
+
+        CHECK(tile_cost <= budget + EPS ||
+              std::max(r.width, r.height) < 2 * opt.min_tile_size);
+      }
+    }
+  }
+}
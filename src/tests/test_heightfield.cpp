@@ -0,0 +1,100 @@
+#include "geometry/heightfield.h"
+#include "geometry/geometry_util.h"
+#include "sampler.h"
+#include "test_util.h"
+
+namespace
+{
+  scalar hills(scalar x, scalar z)
+  {
+    return 2 - (x - 1) * (x - 1) - (z - 1) * (z - 1) +
+      0.3 * sin(4.1 * x) * cos(3.1 * z) + 0.2 * sin(11.1 * x - 5.6 * z + 0.4);
+  }
+}
+
+TEST(heightfield_matches_mesh)
+{
+  // sizes that aren't powers of two, to leave the quadtree's nodes ragged
+  const uint xd = 37, zd = 23;
+  Heightfield field(hills, Vec2(0.0, 0.0), Vec2(2.0, 1.5), xd, zd);
+  auto mesh = heightfield_mesh(hills, Vec2(0.0, 0.0), Vec2(2.0, 1.5), xd, zd);
+
+  const auto box = field.get_bounding_box();
+  CHECK_CLOSE(0.0, (box.min() - mesh->get_bounding_box().min()).norm(), 1e-6);
+  CHECK_CLOSE(0.0, (box.max() - mesh->get_bounding_box().max()).norm(), 1e-6);
+
+  UniformSampler samp;
+  samp.seed(11);
+  int hits = 0, mismatches = 0;
+  for (int i = 0; i < 2000; ++i)
+  {
+    const Vec3 target = box.min() + box.size().elem_mult(Vec3(samp.sample_1d(), samp.sample_1d(), samp.sample_1d()));
+    // a quarter of the rays start within the box
+    const scalar dist = i % 4 ? 5.0 : 0.2;
+    const Vec3 origin = target + uniform_sphere_sample(samp.sample_2d()) * dist;
+    const Ray ray(origin, (target - origin).normal());
+
+    SubGeo fg, mg;
+    const auto ft = field.intersect(ray, sfp_none, fg);
+    const auto mt = mesh->intersect(ray, sfp_none, mg);
+
+    // rays through an edge may hit on one side and not the other
+    if (ft.is() != mt.is() || (ft.is() && fabs(ft.get() - mt.get()) > 1e-4))
+    {
+      ++mismatches;
+      continue;
+    }
+    if (!ft.is())
+      continue;
+
+    ++hits;
+    const Vec3 p = ray.evaluate(ft.get());
+    if (field.normal(fg, p).dot(mesh->normal(mg, p)) < 1 - 1e-4)
+      ++mismatches;
+
+    scalar fu, fv, mu, mv;
+    field.texture_coord(fg, p, Vec3::y_axis, fu, fv);
+    mesh->texture_coord(mg, p, Vec3::y_axis, mu, mv);
+    CHECK_CLOSE(mu, fu, 1e-3);
+    CHECK_CLOSE(mv, fv, 1e-3);
+  }
+
+  CHECK(hits > 500);
+  CHECK(mismatches <= 4);
+}
+
+TEST(heightfield_limits)
+{
+  // a flat field has a box of no height
+  vector<scalar> flat(11 * 6, 0.5);
+  Heightfield field(flat, Vec2(-1.0, -1.0), Vec2(1.0, 1.0), 10, 5);
+
+  SubGeo geom;
+  const Ray down(Vec3(0.13, 2.0, 0.27), -Vec3::y_axis);
+  auto t = field.intersect(down, sfp_none, geom);
+  CHECK(t.is());
+  CHECK_CLOSE(1.5, t.get(), EPS);
+  CHECK_VEC(Vec3::y_axis, field.normal(geom, down.evaluate(t.get())));
+
+  CHECK(!field.intersect(down, scalar_fp{1.4}, geom).is());
+  CHECK(!field.intersect(Ray(Vec3(1.5, 2.0, 0.0), -Vec3::y_axis), sfp_none, geom).is());
+
+  // a grazing ray just above the surface, along a line of the grid
+  CHECK(!field.intersect(Ray(Vec3(-2.0, 0.51, 0.2), Vec3::x_axis), sfp_none, geom).is());
+
+  const Ray slant(Vec3(-2.0, 1.0, -0.6), Vec3(1.0, -0.3, 0.4).normal());
+  t = field.intersect(slant, sfp_none, geom);
+  CHECK(t.is());
+  CHECK_CLOSE(0.5, slant.evaluate(t.get()).y, EPS);
+
+  // cells far smaller than the determinant threshold of ray_triangle_intersection
+  Heightfield fine([](scalar x, scalar z) { return x + z; }, Vec2(0.0, 0.0), Vec2(0.01, 0.01), 300, 300);
+  const Ray fine_down(Vec3(0.004, 1.0, 0.003), -Vec3::y_axis);
+  t = fine.intersect(fine_down, sfp_none, geom);
+  CHECK(t.is());
+  CHECK_CLOSE(1.0 - 0.007, t.get(), EPS);
+  CHECK_VEC(Vec3(-1.0, 1.0, -1.0).normal(), fine.normal(geom, fine_down.evaluate(t.get())));
+
+  // the heights, and the quadtree's two-thirds of a range per cell
+  CHECK(fine.memory_usage() < 301 * 301 * 2 * sizeof(scalar));
+}
@@ -0,0 +1,63 @@
+#include "tests/test_util.h"
+#include "textures/image_texture.h"
+#include "math_util.h"
+
+namespace
+{
+  // Smooth in both directions, and periodic in u like a sky.
+  class SmoothTexture : public Texture2D
+  {
+  public:
+    spectrum at_coord(const Vec2& uv) const override
+    {
+      return spectrum{scalar(1.0 + 0.5 * sin(2 * PI * uv.u) * uv.v)};
+    }
+  };
+
+  // Far finer than any texel.
+  class NoisyTexture : public Texture2D
+  {
+  public:
+    spectrum at_coord(const Vec2& uv) const override
+    {
+      return spectrum{scalar(sin(5000 * uv.u) * sin(7000 * uv.v) > 0 ? 2.0 : 0.0)};
+    }
+  };
+
+  SUITE(image_texture)
+  {
+    // Bilinear lookups reproduce the texels at their centers.
+    TEST(bilinear_texel_centers)
+    {
+      SmoothTexture smooth;
+      const uint w = 8, h = 4;
+      ImageTexture2D nearest(smooth, w, h);
+      ImageTexture2D bilinear(smooth, w, h, ImageTexture2D::Filter::BILINEAR);
+
+      for (auto y = 0u; y < h; ++y)
+      {
+        for (auto x = 0u; x < w; ++x)
+        {
+          const Vec2 uv((x + 0.5) / w, (y + 0.5) / h);
+          CHECK_CLOSE(nearest.at_coord(uv).luminance(), bilinear.at_coord(uv).luminance(),
+                      PRECISE_EPS);
+        }
+      }
+    }
+
+    TEST(bake_smooth)
+    {
+      SmoothTexture smooth;
+      const auto baked = bake_texture(smooth, 64, 32);
+      CHECK(baked != nullptr);
+      CHECK(texture_error(smooth, *baked) < 0.01);
+    }
+
+    // No resolution captures the noise, so the texture should be kept.
+    TEST(bake_noisy)
+    {
+      NoisyTexture noisy;
+      CHECK(bake_texture(noisy, 16, 8, 0.01, 1) == nullptr);
+    }
+  }
+}
@@ -1,5 +1,7 @@
 #include <iostream>
 #include "geometry/implicit.h"
+#include "geometry/distance_cache.h"
+#include "geometry/implicit_union.h"
 #include "test_util.h"
 #include "geometry/sphere.h"
 
@@ -49,3 +51,249 @@ TEST(sphere_implicit)
     }
   }
 }
+
+// Batched sphere tracing finds the same hits as single steps, in fewer calls.
+TEST(sphere_implicit_batched)
+{
+  auto bbox = bounds::AABB(Vec3{-1.1}, Vec3{1.1});
+  ImplicitSurface single(sphere_sdf, sphere_grad, 1.0, bbox);
+
+  int calls = 0;
+  auto batch_sdf = [&](const Vec3* points, scalar* values, uint n)
+  {
+    ++calls;
+    for (auto i = 0u; i < n; ++i)
+      values[i] = sphere_sdf(points[i]);
+  };
+  ImplicitSurface batched(batch_sdf, gradient_from_batch(batch_sdf), 1.0, bbox, 8);
+
+  int single_calls = 0;
+  auto counted_sdf = [&](const Vec3& p) { ++single_calls; return sphere_sdf(p); };
+  ImplicitSurface counted(counted_sdf, sphere_grad, 1.0, bbox);
+
+  UniformSampler samp;
+  for (int i = 0; i < 100; ++i)
+  {
+    Vec3 n = cosine_weighted_hemisphere_sample(samp.sample_2d());
+    Ray ray(Vec3::z_axis * -3.0, n);
+
+    auto t = single.intersect(ray);
+    auto tb = batched.intersect(ray);
+    counted.intersect(ray);
+
+    CHECK_EQUAL(t.is(), tb.is());
+    if (t.is() && tb.is())
+    {
+      CHECK_CLOSE(t.get(), tb.get(), EPS);
+
+      const Vec3 p = ray.evaluate(tb.get());
+      CHECK_CLOSE(0.0, (batched.normal(0, p) - p.normal()).norm(), 0.01);
+    }
+  }
+
+  CHECK(calls < single_calls);
+}
+
+// The cached bounds never exceed the distance to the surface, in or out of
+// the box.
+TEST(distance_cache_bounds)
+{
+  auto eval = [](const Vec3* points, scalar* values, uint n)
+  {
+    for (auto i = 0u; i < n; ++i)
+      values[i] = sphere_sdf(points[i]);
+  };
+  DistanceCache cache(eval, 1.0, bounds::AABB(Vec3{-2.0}, Vec3{3.0}), 40, 1 << 20);
+  CHECK_EQUAL(40u, cache.resolution());
+
+  UniformSampler samp;
+  samp.seed(2);
+  int useful = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    const Vec3 p = Vec3{samp.sample_1d(), samp.sample_1d(), samp.sample_1d()} * 8.0 - Vec3{4.0};
+    const scalar b = cache.bound(p);
+    CHECK(b >= 0);
+    CHECK(b <= fabs(sphere_sdf(p)) + PRECISE_EPS);
+    if (b > cache.cell_size())
+      ++useful;
+  }
+  CHECK(useful > 500);
+
+  // Too little memory coarsens the grid.
+  DistanceCache small(eval, 1.0, bounds::AABB(Vec3{-2.0}, Vec3{3.0}), 256, 1 << 14);
+  CHECK(small.resolution() < 256);
+  CHECK(small.memory() < (1 << 15));
+}
+
+// Tracing through the cache finds the same hits with fewer evaluations: only
+// those within a cell or so of the surface.
+TEST(sphere_implicit_cached)
+{
+  int calls = 0;
+  auto counted_sdf = [&](const Vec3& p) { ++calls; return sphere_sdf(p); };
+  auto bbox = bounds::AABB(Vec3{-6.0}, Vec3{6.0});
+  ImplicitSurface plain(counted_sdf, sphere_grad, 1.0, bbox);
+  ImplicitSurface cached(counted_sdf, sphere_grad, 1.0, bbox);
+  cached.cache_distances(64, 1 << 20);
+  CHECK(cached.distance_cache() != nullptr);
+
+  UniformSampler samp;
+  samp.seed(4);
+  int plain_calls = 0, cached_calls = 0;
+  for (int i = 0; i < 200; ++i)
+  {
+    const Ray ray(Vec3(-5.0, 0.3 * samp.sample_1d(), -5.0), (Vec3{1.0, 0.0, 1.0} + uniform_sphere_sample(samp.sample_2d()) * 0.2).normal());
+
+    calls = 0;
+    const auto t = plain.intersect(ray);
+    plain_calls += calls;
+
+    calls = 0;
+    const auto tc = cached.intersect(ray);
+    cached_calls += calls;
+
+    CHECK_EQUAL(t.is(), tc.is());
+    if (t.is() && tc.is())
+      CHECK_CLOSE(t.get(), tc.get(), 1e-3);
+  }
+
+  CHECK(cached_calls < plain_calls);
+}
+
+// Over-relaxed tracing finds the same hits as plain sphere tracing, with
+// fewer evaluations, through the surface and along it.
+TEST(sphere_implicit_relaxed)
+{
+  count_implicit_evaluations(true);
+  auto bbox = bounds::AABB(Vec3{-1.1}, Vec3{1.1});
+  ImplicitSurface plain(sphere_sdf, sphere_grad, 1.0, bbox);
+  ImplicitSurface relaxed(sphere_sdf, sphere_grad, 1.0, bbox);
+  relaxed.set_tracing(ImplicitSurface::Tracing::RELAXED);
+  Sphere sp(Vec3::zero, 1.0);
+
+  UniformSampler samp;
+  samp.seed(5);
+  for (int i = 0; i < 200; ++i)
+  {
+    const Vec3 origin = uniform_sphere_sample(samp.sample_2d()) * 4.0;
+    const Vec3 target = uniform_sphere_sample(samp.sample_2d()) * 1.05;
+    const Ray ray(origin, (target - origin).normal());
+
+    const auto t = plain.intersect(ray);
+    const auto tr = relaxed.intersect(ray);
+    const auto t_exact = sp.intersect(ray);
+
+    CHECK_EQUAL(t.is(), tr.is());
+    CHECK_EQUAL(t_exact.is(), tr.is());
+    if (tr.is())
+      CHECK_CLOSE(1.0, ray.evaluate(tr.get()).norm(), 1e-3);
+  }
+
+  CHECK(relaxed.evaluations_per_ray() < plain.evaluations_per_ray());
+}
+
+// A union of spheres finds the nearest sphere's hit, evaluating only the
+// spheres near each step.
+TEST(implicit_union_spheres)
+{
+  count_implicit_evaluations(true);
+  const int N = 40;
+  int calls = 0;
+  vector<unique_ptr<ImplicitSurface>> spheres;
+  vector<const ImplicitSurface*> parts;
+  vector<Sphere> exact;
+  for (int i = 0; i < N; ++i)
+  {
+    const Vec3 center(2.5 * (i % 8), 0.0, 2.5 * (i / 8));
+    const scalar radius = 0.5 + 0.1 * (i % 3);
+    auto sdf = [&calls, center, radius](const Vec3& p) { ++calls; return (p - center).norm() - radius; };
+    auto grad = [center](const Vec3& p) { return p - center; };
+
+    // scaled by 2, to check the Lipschitz constants are kept per part
+    auto scaled = [sdf](const Vec3& p) { return 2 * sdf(p); };
+    if (i % 2)
+      spheres.emplace_back(new ImplicitSurface(sdf, grad, 1.0,
+                                               bounds::AABB(center - Vec3{radius}, center + Vec3{radius})));
+    else
+      spheres.emplace_back(new ImplicitSurface(scaled, grad, 2.0,
+                                               bounds::AABB(center - Vec3{radius}, center + Vec3{radius})));
+
+    parts.push_back(spheres.back().get());
+    exact.emplace_back(center, radius);
+  }
+
+  auto surface = make_implicit_union(parts);
+  const auto box = surface->get_bounding_box();
+  CHECK_CLOSE(0.0, (box.min() - Vec3{-0.7}).norm(), 1e-6);
+
+  UniformSampler samp;
+  samp.seed(6);
+  for (int i = 0; i < 200; ++i)
+  {
+    const Vec3 target = box.min() + box.size().elem_mult(Vec3{samp.sample_1d(), samp.sample_1d(), samp.sample_1d()});
+    const Vec3 origin = target + uniform_sphere_sample(samp.sample_2d()) * 10.0;
+    const Ray ray(origin, (target - origin).normal());
+
+    scalar_fp nearest = sfp_none;
+    for (const auto& sp : exact)
+    {
+      const auto ts = sp.intersect(ray);
+      if (ts.is() && (!nearest.is() || ts.get() < nearest.get()))
+        nearest = ts;
+    }
+
+    const auto t = surface->intersect(ray);
+    CHECK_EQUAL(nearest.is(), t.is());
+    if (t.is() && nearest.is())
+    {
+      CHECK_CLOSE(nearest.get(), t.get(), 1e-3);
+
+      const Vec3 p = ray.evaluate(t.get());
+      auto hit = std::min_element(exact.begin(), exact.end(), [&](const Sphere& a, const Sphere& b) {
+          return fabs((p - a.position).norm() - a.radius) < fabs((p - b.position).norm() - b.radius); });
+      CHECK_CLOSE(0.0, (surface->normal(0, p) - (p - hit->position).normal()).norm(), 1e-3);
+    }
+  }
+
+  // Each step evaluates a few of the spheres, not all of them.
+  const scalar per_step = scalar(calls) / (surface->evaluations_per_ray() * 200);
+  CHECK(per_step < N / 8);
+}
+
+// Dual numbers give the gradients central differences approximate.
+TEST(dual_gradients)
+{
+  auto f = [](const auto& v) {
+    using P = std::decay_t<decltype(v)>;
+    auto r = sqrt(v.x * v.x + v.z * v.z);
+    return pow(r + 1.0, 1.5) * sin(v.y) + max(v.abs().max(), scalar(0.5)) -
+      clamp(v.dot(P(Vec3{1.0, -2.0, 0.5})), -1, 1) + atan2(v.y, v.x + 3.0) / exp(v.z);
+  };
+  const auto grad = gradient_from_dual(f);
+
+  UniformSampler samp;
+  samp.seed(7);
+  for (int i = 0; i < 100; ++i)
+  {
+    const Vec3 p = Vec3{samp.sample_1d(), samp.sample_1d(), samp.sample_1d()} * 2.0 - Vec3{1.0};
+    const scalar h = 1e-4;
+    const Vec3 fd(f(p + Vec3::x_axis * h) - f(p - Vec3::x_axis * h),
+                  f(p + Vec3::y_axis * h) - f(p - Vec3::y_axis * h),
+                  f(p + Vec3::z_axis * h) - f(p - Vec3::z_axis * h));
+
+    CHECK_CLOSE(f(p), f(DualVec3::variable(p)).v, EPS);
+    CHECK_CLOSE(0.0, (grad(p) - fd / (2 * h)).norm(), 0.01);
+  }
+}
+
+TEST(dual_normals)
+{
+  auto capsule = make_capsule(Vec3::y_axis, 2.0, 0.5);
+  CHECK_VEC(Vec3::x_axis, capsule->normal(0, Vec3{0.5, 0.3, 0.0}));
+  CHECK_VEC(Vec3(0.0, 1.0, 1.0).normal(), capsule->normal(0, Vec3{0.0, 1.0, 0.0} + Vec3(0.0, 1.0, 1.0).normal() * 0.5));
+
+  auto box = make_rounded_box(Vec3{2.0, 1.0, 1.0}, 0.25);
+  CHECK_VEC(Vec3::x_axis, box->normal(0, Vec3{1.25, 0.1, -0.2}));
+  CHECK_VEC(Vec3(1.0, 1.0, 0.0).normal(), box->normal(0, Vec3{1.0, 0.5, 0.0} + Vec3(1.0, 1.0, 0.0).normal() * 0.25));
+}
@@ -0,0 +1,166 @@
+#include "tests/test_util.h"
+#include "geometry/sphere.h"
+#include "scheduler.h"
+#include "film.h"
+#include "kdtree.h"
+
+namespace
+{
+  vector<shared_ptr<Sphere>> random_spheres(int n)
+  {
+    vector<shared_ptr<Sphere>> shapes;
+    for (int i = 0; i < n; ++i)
+      shapes.push_back(make_shared<Sphere>(Vec3{rus(), rus(), rus()} * 4.0, rf() * 0.3 + 0.01));
+    return shapes;
+  }
+
+  // The tree must report the same closest hit as testing every element.
+  void check_closest_hits(const kd::Tree<Geometry>& tree, const vector<const Geometry*>& elements)
+  {
+    for (int i = 0; i < 1000; ++i)
+    {
+      Ray ray(random_normal() * 8.0, random_normal());
+
+      scalar_fp best_t = sfp_none;
+      for (auto s : elements)
+      {
+        SubGeo geo;
+        auto t = s->intersect(ray, best_t, geo);
+        if (t < best_t)
+          best_t = t;
+      }
+
+      const Geometry* hit = nullptr;
+      SubGeo geo;
+      auto t = tree.intersect(ray, sfp_none, hit, geo);
+      CHECK_EQUAL(best_t.is(), t.is());
+      if (best_t.is() && t.is())
+        CHECK_CLOSE(best_t.get(), t.get(), EPS);
+    }
+  }
+
+  SUITE(kdtree)
+  {
+    TEST(parallel_build)
+    {
+      auto shapes = random_spheres(2000);
+      vector<const Geometry*> elements;
+      for (auto& s : shapes)
+        elements.push_back(s.get());
+
+      Film f(1, 1);
+      register_thread_state_manager(f);
+      auto scheduler = make_scheduler(3);
+
+      kd::TreeOptions opt;
+      opt.parallel_build_limit = 100;
+
+      set_build_scheduler(scheduler.get());
+      kd::Tree<Geometry> tree(elements, opt);
+      set_build_scheduler(nullptr);
+
+      CHECK(tree.count_objects() >= int(elements.size()));
+      check_closest_hits(tree, elements);
+
+      // The thread count mustn't change the tree.
+      kd::Tree<Geometry> serial_tree(elements, opt);
+      CHECK_EQUAL(serial_tree.count_objects(), tree.count_objects());
+      CHECK_EQUAL(serial_tree.height(), tree.height());
+
+      // A build within a task of the build scheduler waits only on its own
+      // tasks, rather than the pool it runs in.
+      set_build_scheduler(scheduler.get());
+      unique_ptr<kd::Tree<Geometry>> nested_tree;
+      scheduler->add_task(make_shared<FunctionTask>(
+                            [&]() { nested_tree.reset(new kd::Tree<Geometry>(elements, opt)); }));
+      scheduler->complete_pending();
+      set_build_scheduler(nullptr);
+
+      CHECK_EQUAL(tree.count_objects(), nested_tree->count_objects());
+      check_closest_hits(*nested_tree, elements);
+    }
+
+    TEST(sweep_build)
+    {
+      auto shapes = random_spheres(1000);
+      vector<const Geometry*> elements;
+      for (auto& s : shapes)
+        elements.push_back(s.get());
+
+      kd::TreeOptions opt;
+      opt.build_mode = kd::BuildMode::SWEEP;
+      kd::Tree<Geometry> tree(elements, opt);
+
+      CHECK(tree.count_objects() >= int(elements.size()));
+      check_closest_hits(tree, elements);
+
+      // The sweep build must also split correctly into parallel subtrees.
+      Film f(1, 1);
+      register_thread_state_manager(f);
+      auto scheduler = make_scheduler(3);
+      opt.parallel_build_limit = 100;
+
+      set_build_scheduler(scheduler.get());
+      kd::Tree<Geometry> parallel_tree(elements, opt);
+      set_build_scheduler(nullptr);
+
+      CHECK_EQUAL(tree.count_objects(), parallel_tree.count_objects());
+      check_closest_hits(parallel_tree, elements);
+    }
+
+    // Any-hit queries must agree with testing every element, for finite and
+    // infinite ray lengths.
+    TEST(occluded)
+    {
+      auto shapes = random_spheres(1000);
+      vector<const Geometry*> elements;
+      for (auto& s : shapes)
+        elements.push_back(s.get());
+
+      kd::Tree<Geometry> tree(elements, kd::TreeOptions());
+
+      for (int i = 0; i < 1000; ++i)
+      {
+        Ray ray(random_normal() * 8.0, random_normal());
+        const scalar_fp max_t = (i % 2) ? sfp_none : scalar_fp{rf() * 8};
+
+        bool expected = false;
+        for (auto s : elements)
+          expected = expected || s->occluded(ray, max_t);
+
+        CHECK_EQUAL(expected, tree.occluded(ray, max_t));
+      }
+    }
+
+    // Clustering the nodes must not change the tree itself.
+    TEST(cache_layout)
+    {
+      auto shapes = random_spheres(1000);
+      vector<const Geometry*> elements;
+      for (auto& s : shapes)
+        elements.push_back(s.get());
+
+      kd::TreeOptions opt;
+      opt.cache_layout = false;
+      kd::Tree<Geometry> dfs_tree(elements, opt);
+      opt.cache_layout = true;
+      kd::Tree<Geometry> clustered_tree(elements, opt);
+
+      CHECK_EQUAL(dfs_tree.height(), clustered_tree.height());
+      CHECK_EQUAL(dfs_tree.count_leaves(), clustered_tree.count_leaves());
+      CHECK_EQUAL(dfs_tree.count_objects(), clustered_tree.count_objects());
+
+      for (int i = 0; i < 1000; ++i)
+      {
+        Ray ray(random_normal() * 8.0, random_normal());
+        const Geometry *dfs_hit = nullptr, *clustered_hit = nullptr;
+        SubGeo geo;
+        auto dfs_t = dfs_tree.intersect(ray, sfp_none, dfs_hit, geo);
+        auto clustered_t = clustered_tree.intersect(ray, sfp_none, clustered_hit, geo);
+
+        CHECK_EQUAL(dfs_t.is(), clustered_t.is());
+        CHECK_EQUAL(dfs_hit, clustered_hit);
+      }
+    }
+  }
+}
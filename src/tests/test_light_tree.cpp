@@ -0,0 +1,168 @@
+#include <map>
+#include "tests/test_util.h"
+#include "light_tree.h"
+
+namespace
+{
+  // A one-sided emitter with falloff, to exercise the orientation bounds.
+  class BoundedLight : public Light
+  {
+  public:
+    BoundedLight(const LightBounds& b) : b(b) { }
+
+    optional<LightBounds> bounds() const override { return b; }
+
+    LightSample sample_emission(const Intersection&, Sampler&) const override { return LightSample(); }
+    EmissionSample sample_emission(const Scene&, Sampler&) const override { return EmissionSample(); }
+    spectrum emission(const Scene&, const IntersectionView&, const EmissionSample&) const override
+    {
+      return spectrum::zero;
+    }
+
+  private:
+    LightBounds b;
+  };
+
+  struct LightSet
+  {
+    LightSet(int count, int infinite, bool oriented = true)
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        const Vec3 pos = Vec3{rus(), rus(), rus()} * 10.0;
+        if (!oriented || i % 2)
+          lights.push_back(make_shared<PointLight>(pos, spectrum{rf() * 5}));
+        else
+        {
+          const Vec3 corner = pos + Vec3{rf(), rf(), rf()};
+          lights.push_back(make_shared<BoundedLight>(
+                             LightBounds{bounds::AABB{pos, corner}, rf() * 5 + scalar(0.1),
+                                         random_normal(), 1.0, 0.0, true}));
+        }
+      }
+      for (int i = 0; i < infinite; ++i)
+        lights.push_back(make_shared<DirectionalLight>(random_normal(), spectrum{1.0}));
+
+      for (auto& l : lights)
+        pointers.push_back(l.get());
+    }
+
+    vector<shared_ptr<Light>> lights;
+    vector<const Light*> pointers;
+  };
+
+  SUITE(light_tree)
+  {
+    // The probabilities of the lights sum to one when every light can reach
+    // the point.
+    TEST(pmf_sums_to_one)
+    {
+      LightSet set(200, 2, false);
+      LightTree tree(set.pointers);
+
+      for (int i = 0; i < 100; ++i)
+      {
+        const Vec3 p = Vec3{rus(), rus(), rus()} * 12.0;
+        const Vec3 n = i % 4 ? random_normal() : Vec3::zero;
+
+        scalar total = 0;
+        for (auto l : set.pointers)
+          total += tree.pmf(p, n, l);
+        CHECK_CLOSE(1.0, total, PRECISE_EPS);
+      }
+    }
+
+    // Oriented lights may all face away from a point, so then no light is
+    // chosen; otherwise the choices still sum to one, and no light whose own
+    // bounds reach the point is ruled out.
+    TEST(pmf_oriented)
+    {
+      LightSet set(200, 0);
+      LightTree tree(set.pointers);
+
+      for (int i = 0; i < 100; ++i)
+      {
+        const Vec3 p = Vec3{rus(), rus(), rus()} * 12.0;
+        const Vec3 n = i % 4 ? random_normal() : Vec3::zero;
+
+        scalar total = 0;
+        bool any_reach = false;
+        for (auto l : set.pointers)
+        {
+          const scalar pmf = tree.pmf(p, n, l);
+          const bool reaches = l->bounds().get().importance(p, n) > 0;
+          if (reaches)
+            CHECK(pmf > 0);
+          any_reach = any_reach || reaches;
+          total += pmf;
+        }
+        if (any_reach)
+          CHECK_CLOSE(1.0, total, PRECISE_EPS);
+        else
+          CHECK(total == 0 || fabs(total - 1) < PRECISE_EPS);
+      }
+    }
+
+    // sample reports exactly the probability of the light it returns, and
+    // chooses lights at that rate.
+    TEST(sample_matches_pmf)
+    {
+      LightSet set(20, 1);
+      LightTree tree(set.pointers);
+
+      const Vec3 p{0.5, -0.3, 0.2};
+      const Vec3 n = Vec3{0.2, 1.0, 0.1}.normal();
+
+      std::map<const Light*, int> counts;
+      const int samples = 200000;
+      for (int i = 0; i < samples; ++i)
+      {
+        scalar light_prob;
+        auto light = tree.sample(p, n, (i + 0.5) / samples, light_prob);
+        CHECK(light != nullptr);
+        if (!light)
+          break;
+        CHECK_CLOSE(tree.pmf(p, n, light), light_prob, PRECISE_EPS);
+        ++counts[light];
+      }
+
+      for (auto l : set.pointers)
+        CHECK_CLOSE(tree.pmf(p, n, l), scalar(counts[l]) / samples, 1e-3);
+    }
+
+    // Lights behind a one-sided emitter are never chosen.
+    TEST(skips_lights_facing_away)
+    {
+      BoundedLight facing(LightBounds{bounds::AABB{Vec3{0, 0, 1}, Vec3{1, 1, 1}}, 1.0,
+                                      Vec3::z_axis, 1.0, 0.0, true});
+      BoundedLight away(LightBounds{bounds::AABB{Vec3{0, 0, 1}, Vec3{1, 1, 1}}, 1.0,
+                                    -Vec3::z_axis, 1.0, 0.0, true});
+      LightTree tree({&facing, &away});
+
+      const Vec3 p{0.5, 0.5, 4.0};
+      CHECK_EQUAL(1.0, tree.pmf(p, Vec3::zero, &facing));
+      CHECK_EQUAL(0.0, tree.pmf(p, Vec3::zero, &away));
+    }
+
+    // Two emitters facing away from a point between them, whose merged
+    // bounds face every way: the walk must still end at a light.
+    TEST(samples_below_unlit_children)
+    {
+      BoundedLight right(LightBounds{bounds::AABB{Vec3{1, 0, 0}, Vec3{1.5, 0.5, 0.5}}, 1.0,
+                                     Vec3::x_axis, 1.0, 0.0, true});
+      BoundedLight left(LightBounds{bounds::AABB{Vec3{-1.5, 0, 0}, Vec3{-1, 0.5, 0.5}}, 3.0,
+                                    -Vec3::x_axis, 1.0, 0.0, true});
+      LightTree tree({&right, &left});
+
+      const Vec3 p{0.0, 0.25, 0.25};
+      for (scalar r : {0.1, 0.5, 0.9})
+      {
+        scalar light_prob;
+        auto light = tree.sample(p, Vec3::zero, r, light_prob);
+        CHECK(light != nullptr);
+        CHECK_CLOSE(tree.pmf(p, Vec3::zero, light), light_prob, PRECISE_EPS);
+      }
+      CHECK_CLOSE(1.0, tree.pmf(p, Vec3::zero, &right) + tree.pmf(p, Vec3::zero, &left), EPS);
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#include "tests/test_util.h"
+#include "geometry/plane.h"
+#include "geometry/sphere.h"
+#include "textures.h"
+#include "env_light.h"
+#include "kdscene.h"
+#include "path_tracer.h"
+#include "materials/rough_mirror.h"
+
+namespace
+{
+  // The mean radiance along r over many paths.
+  scalar mean_radiance(const Scene& scene, const Ray& r, int samples)
+  {
+    PathTracerIntegrator integrator(PathTracerIntegrator::Options{});
+    UniformSampler sampler;
+    sampler.seed(3);
+
+    scalar total = 0;
+    for (int i = 0; i < samples; ++i)
+      total += integrator.trace_ray(scene, r, sampler).luminance();
+    return total / samples;
+  }
+
+  class RoughMirrorFixture
+  {
+  public:
+    RoughMirrorFixture() : floor(Vec3::z_axis, 0), mirror(0.3), floor_shape(&floor, &mirror)
+    {
+    }
+
+    Plane floor;
+    RoughMirror mirror;
+    Shape floor_shape;
+  };
+
+  SUITE(path_tracer)
+  {
+    // The rough mirror can't be evaluated, so direct lighting finds nothing
+    // through it, and its bounces must see the environment in full.
+    TEST_FIXTURE(RoughMirrorFixture, rough_mirror_environment)
+    {
+      SolidColor sky(spectrum{1.0});
+      EnvironmentLight env(&sky, 16, 8);
+
+      KDScene scene;
+      scene.add(&floor_shape);
+      scene.add(&env);
+      scene.prepare();
+
+      const Ray r(Vec3{0.0, 0.0, 1.0}, Vec3{0.3, 0.0, -1.0}.normal());
+      CHECK(mean_radiance(scene, r, 2000) > 0.5);
+    }
+
+    // Nor can direct lighting find an emissive shape through it, so its
+    // bounces must keep the emission they hit.
+    TEST_FIXTURE(RoughMirrorFixture, rough_mirror_area_light)
+    {
+      SolidColor color(spectrum{2.0});
+      EmissiveMaterial emissive(&color);
+      Sphere sphere(Vec3{0.0, 0.0, 3.0}, 1.0);
+      Shape shape(&sphere, &emissive);
+
+      KDScene scene;
+      scene.add(&floor_shape);
+      scene.add(&shape);
+      scene.prepare();
+
+      // reflected by the mirror's mean normal towards the sphere's center
+      const Ray r(Vec3{2.0, 0.0, 3.0}, Vec3{-1.0, 0.0, -3.0}.normal());
+      CHECK(mean_radiance(scene, r, 2000) > 0.2);
+    }
+  }
+}
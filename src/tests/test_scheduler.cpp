@@ -0,0 +1,51 @@
+#include <atomic>
+#include "tests/test_util.h"
+#include "scheduler.h"
+#include "film.h"
+
+namespace
+{
+  class CountTask : public LocalTask
+  {
+  public:
+    CountTask(std::atomic<int>& count_) : count(count_) { }
+
+    void run(uint worker_id) override
+    {
+      ++count;
+    }
+
+  private:
+    std::atomic<int>& count;
+  };
+
+  void check_scheduler(const std::string& type)
+  {
+    Film f(1, 1);
+    register_thread_state_manager(f);
+
+    auto scheduler = make_scheduler(3, type);
+    std::atomic<int> count(0);
+
+    for (int round = 1; round <= 3; ++round)
+    {
+      for (int i = 0; i < 1000; ++i)
+        scheduler->add_task(make_shared<CountTask>(count));
+      scheduler->complete_pending();
+      CHECK_EQUAL(1000 * round, count.load());
+    }
+  }
+
+  SUITE(Scheduler)
+  {
+    TEST(spin_scheduler_completes)
+    {
+      check_scheduler("spin");
+    }
+
+    TEST(steal_scheduler_completes)
+    {
+      check_scheduler("steal");
+    }
+  }
+}
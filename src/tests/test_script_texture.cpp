@@ -0,0 +1,72 @@
+#include "tests/test_util.h"
+#include "film.h"
+#include "kdscene.h"
+#include "env_light.h"
+#include "thread_state.h"
+#include "scenes/basic_scenes.h"
+#include "script/runner.h"
+#include <cstdio>
+#include <fstream>
+
+#if FEATURE_LUA_SCRIPTING
+
+namespace
+{
+  const char* SCRIPT_FILE = "test_script_texture.lua";
+
+  const char* SCRIPT = R"(
+function sky(u, v) return 1.0, 0.5, 0.25 end
+function glow(u, v) return 2.0, 2.0, 2.0 end
+
+function scene()
+   local shapes = {
+      shape(geom.sphere({0.0, 0.0, 3.0}, 1.0), material.emissive(texture.script("glow")))
+   }
+   local lights = { light.environment(texture.script("sky")) }
+   local cam = camera.perspective({0.0, 4.0, 0.0}, {0.0}, {0.0, 0.0, 1.0}, math.pi*0.5)
+
+   return { shapes = shapes, lights = lights, camera = cam }
+end
+)";
+
+  SUITE(script_texture)
+  {
+    // Script textures are evaluated while loading the scene, for the
+    // environment's distribution, and while preparing it, for the power of
+    // emissive shapes, both before any render thread exists.
+    TEST(environment_and_emitter)
+    {
+      std::ofstream(SCRIPT_FILE) << SCRIPT;
+
+      Film f(1, 1);
+      register_thread_state_manager(f);
+
+      KDScene scene;
+      {
+        LuaRunner runner(SCRIPT_FILE);
+        lua_scene(scene, runner);
+        set_thread_lua_snapshot(runner.snapshot());
+      }
+      std::remove(SCRIPT_FILE);
+
+      scene.prepare();
+      CHECK_EQUAL(2u, scene.lights().size());
+
+      const auto env = scene.environment_light();
+      CHECK(env != nullptr);
+      if (env)
+        CHECK_CLOSE(spectrum(1.0, 0.5, 0.25).luminance(), env->emission(Vec3::z_axis).luminance(), EPS);
+
+      for (auto light : scene.lights())
+      {
+        if (light == env)
+          continue;
+
+        const auto lb = light->bounds();
+        CHECK(lb.is() && lb.get().power > 0);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "tests/test_util.h"
+#include "geometry/sdf.h"
+#include "geometry/sphere.h"
+#include "math_util.h"
+#include <random>
+
+namespace
+{
+  using namespace sdf;
+
+  // The graph built in composite(), by hand
+  scalar composite_reference(const Vec3& p)
+  {
+    // scaled by 2 and repeated every 3 along x
+    const scalar s = 2;
+    Vec3 q = p / s;
+    q.x -= 3 * std::floor(q.x / 3 + 0.5);
+
+    const Vec3 b = q.abs() - Vec3{0.5, 0.4, 0.3};
+    const scalar box_d = max(b, Vec3::zero).norm() + std::min<scalar>(b.max(), 0);
+    const scalar sphere_d = (q - Vec3{0.6, 0.0, 0.0}).norm() - 0.3;
+
+    const scalar k = 0.2;
+    const scalar h = clamp(0.5 + 0.5 * (sphere_d - box_d) / k, 0, 1);
+    const scalar blend = sphere_d + (box_d - sphere_d) * h - k * h * (1 - h);
+
+    // a cylinder along the x axis, rotated from the y axis
+    const Vec3 c{q.y, q.x, q.z};
+    const scalar dr = sqrt(c.x * c.x + c.z * c.z) - 0.15, dy = fabs(c.y) - 1.0;
+    const scalar cyl_d = sqrt(square(std::max<scalar>(dr, 0)) + square(std::max<scalar>(dy, 0))) +
+      std::min<scalar>(std::max(dr, dy), 0);
+
+    return s * std::max(blend, -cyl_d);
+  }
+
+  NodePtr composite()
+  {
+    auto body = smooth_union(box(Vec3{0.5, 0.4, 0.3}), translate(sphere(0.3), Vec3{0.6, 0.0, 0.0}), 0.2);
+    auto hole = rotate(cylinder(0.15, 1.0), Vec3::z_axis, -PI / 2);
+    return scale(repeat(difference(body, hole), Vec3{3.0, 0.0, 0.0}), 2.0);
+  }
+
+  SUITE(sdf)
+  {
+    // Distances match the closures they replace, and gradients the finite
+    // differences.
+    TEST(composite_values)
+    {
+      const Program program(*composite());
+
+      std::mt19937 eng;
+      std::uniform_real_distribution<scalar> dist(-4, 4);
+      for (int i = 0; i < 200; ++i)
+      {
+        const scalar x = dist(eng), y = dist(eng) / 4, z = dist(eng) / 4;
+        const Vec3 p{x, y, z};
+        CHECK_CLOSE(composite_reference(p), program.eval(p), 1e-4);
+
+        const scalar h = 1e-3;
+        const Vec3 fd{composite_reference(p + Vec3::x_axis * h) - composite_reference(p - Vec3::x_axis * h),
+            composite_reference(p + Vec3::y_axis * h) - composite_reference(p - Vec3::y_axis * h),
+            composite_reference(p + Vec3::z_axis * h) - composite_reference(p - Vec3::z_axis * h)};
+        CHECK_CLOSE(0.0, (program.gradient(p) - fd / (2 * h)).norm(), 0.02);
+      }
+    }
+
+    // A batch gives what the points give one at a time.
+    TEST(batch)
+    {
+      const Program program(*composite());
+
+      vector<Vec3> points;
+      for (int i = 0; i < 37; ++i)
+        points.push_back(Vec3(0.2 * i - 3.0, 0.1 * (i % 5), -0.05 * (i % 7)));
+
+      vector<scalar> values(points.size());
+      vector<Vec3> grads(points.size());
+      program.eval(points.data(), values.data(), grads.data(), points.size());
+
+      for (auto i = 0u; i < points.size(); ++i)
+      {
+        CHECK_EQUAL(program.eval(points[i]), values[i]);
+        CHECK_CLOSE(0.0, (program.gradient(points[i]) - grads[i]).norm(), PRECISE_EPS);
+      }
+    }
+
+    TEST(bounds)
+    {
+      auto moved = translate(rotate(box(Vec3{1.0, 2.0, 3.0}), Vec3::z_axis, PI / 2), Vec3{1.0, 0.0, 0.0});
+      const auto b = node_bounds(*moved);
+      CHECK(b.is());
+      CHECK_CLOSE(0.0, (b.get().min() - Vec3{-1.0, -1.0, -3.0}).norm(), 1e-4);
+      CHECK_CLOSE(0.0, (b.get().max() - Vec3{3.0, 1.0, 3.0}).norm(), 1e-4);
+
+      CHECK(!node_bounds(*repeat(sphere(1), Vec3{2.0, 0.0, 0.0})).is());
+      CHECK(node_bounds(*intersection({plane(Vec3::y_axis, 0), sphere(1)})).is());
+    }
+
+    // Tracing a compiled sphere finds the sphere, with its normals.
+    TEST(surface)
+    {
+      const Vec3 center{0.5, -0.2, 0.3};
+      auto node = translate(scale(sphere(1.0), 0.8), center);
+      const auto surface = make_surface(*node, node_bounds(*node).get());
+      Sphere exact(center, 0.8);
+
+      UniformSampler sampler;
+      sampler.seed(3);
+      for (int i = 0; i < 100; ++i)
+      {
+        const Ray ray(Vec3{0.0, 0.0, -3.0}, uniform_sphere_sample(sampler.sample_2d()));
+        SubGeo geo;
+        const auto t = surface->intersect(ray, sfp_none, geo);
+        const auto t_exact = exact.intersect(ray);
+
+        CHECK_EQUAL(t_exact.is(), t.is());
+        if (t.is() && t_exact.is())
+        {
+          CHECK_CLOSE(t_exact.get(), t.get(), 1e-3);
+          const Vec3 p = ray.evaluate(t.get());
+          CHECK_CLOSE(0.0, (surface->normal(geo, p) - (p - center).normal()).norm(), 1e-3);
+        }
+      }
+    }
+  }
+}
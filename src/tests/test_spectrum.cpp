@@ -20,4 +20,14 @@ namespace
       CHECK_CLOSE(3.0, rs[1]/rs[2], EPS);
     }
   }
+
+  TEST(spectrum_scaled_product)
+  {
+    spectrum e{0.5, 2.0, 1.5}, r{0.8, 0.1, 0.4};
+    CHECK_VEC(e * r * spectrum{0.25}, scaled_product(e, r, 0.25));
+
+    spectrum total{1.0, 0.0, 2.0};
+    add_scaled_product(total, e, r, 2.0);
+    CHECK_VEC(spectrum(1.8, 0.4, 3.2), total);
+  }
 }
@@ -2,6 +2,8 @@
 #include "geometry/sphere.h"
 #include "textures.h"
 #include "kdscene.h"
+#include "math_util.h"
+#include "sampler.h"
 
 namespace
 {
@@ -43,4 +45,40 @@ namespace
       CHECK_CLOSE(sphere->intersect(ray).get(), 2.0, EPS);
     }
   }
+
+  class CountingTexture : public Texture
+  {
+  public:
+    spectrum at_point(const IntersectionView&) const override
+    {
+      ++count;
+      return spectrum{0.5};
+    }
+
+    mutable int count = 0;
+  };
+
+  TEST(texture_value_once_per_intersection)
+  {
+    Sphere sphere{Vec3::zero, 1.0};
+    CountingTexture tex;
+    RoughMaterial mat{0, &tex};
+    Shape shape{&sphere, &mat};
+
+    KDScene scene;
+    scene.add(&shape);
+    scene.prepare();
+
+    auto isect = scene.intersect(Ray{Vec3{5.0, 0.0, 0.0}, Vec3{-1.0, 0.0, 0.0}});
+    CHECK(isect.is());
+    if (!isect.is())
+      return;
+
+    UniformSampler sampler;
+    const auto& hit = isect.get();
+    for (int i = 0; i < 4; ++i)
+      CHECK_VEC(spectrum{0.5 * INV_PI}, hit.reflectance(Vec3::x_axis, Vec3::x_axis));
+    CHECK_VEC(spectrum{0.5 * INV_PI}, hit.sample_bsdf(Vec3::x_axis, sampler).reflectance);
+    CHECK_EQUAL(1, tex.count);
+  }
 }
@@ -0,0 +1,60 @@
+#include "tests/test_util.h"
+#include "geometry/triangle_block.h"
+#include <vector>
+
+using std::vector;
+
+namespace
+{
+  SUITE(triangle_block)
+  {
+    // A block must find the same closest hit as testing its triangles one at
+    // a time, and never hit an empty lane.
+    TEST(closest_hit)
+    {
+      for (int trial = 0; trial < 100; ++trial)
+      {
+        TriangleBlock block;
+        vector<vector<Vec3>> tris;
+        for (int lane = 0; lane < TriangleBlock::WIDTH; ++lane)
+        {
+          if (lane == 2)
+            continue;
+
+          const Vec3 center = random_normal();
+          tris.push_back({center + random_normal(), center + random_normal(), center + random_normal()});
+          block.set(lane, lane, tris.back()[0], tris.back()[1], tris.back()[2]);
+        }
+        CHECK_EQUAL(TriangleBlock::EMPTY, block.id[2]);
+
+        for (int i = 0; i < 100; ++i)
+        {
+          Ray ray(random_normal() * 4.0, (random_normal() * 0.5 - random_normal() * 4.0).normal());
+          const scalar_fp max_t = (i % 2) ? sfp_none : scalar_fp{rf() * 6};
+
+          scalar_fp best_t = max_t;
+          bool hit = false;
+          for (const auto& tri : tris)
+          {
+            auto t = ray_triangle_intersection(ray, tri[0], tri[1], tri[2], best_t);
+            if (t.is() && t < best_t)
+            {
+              best_t = t;
+              hit = true;
+            }
+          }
+
+          int lane = -1;
+          auto t = block.intersect(ray, max_t, lane);
+          CHECK_EQUAL(hit, t.is());
+          CHECK_EQUAL(hit, block.occluded(ray, max_t));
+          if (hit && t.is())
+          {
+            CHECK_CLOSE(best_t.get(), t.get(), EPS);
+            CHECK(lane != 2);
+          }
+        }
+      }
+    }
+  }
+}
@@ -1,6 +1,7 @@
 #include "test_util.h"
 #include "math_util.h"
 #include "vec2.h"
+#include "frame.h"
 
 namespace
 {
@@ -38,6 +39,39 @@ namespace
       CHECK_ARRAY_CLOSE( (x / 2.0).v, Vec3(0.0, 0.5, 1.0).v, 3, PRECISE_EPS);
     }
 
+    TEST(Vec3_packed_ops)
+    {
+      for (int i = 0; i < 20; ++i)
+      {
+        Vec3 a = random_normal() * (rf() + 0.5), b = random_normal() * rus();
+        CHECK_VEC(a.cross(b), Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+                                   a.x * b.y - a.y * b.x));
+        CHECK_CLOSE(a.x * b.x + a.y * b.y + a.z * b.z, a.dot(b), PRECISE_EPS);
+        CHECK_VEC(min(a, b), Vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)));
+        CHECK_VEC(max(a, b), Vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)));
+        CHECK_VEC((-b).abs(), Vec3(fabs(b.x), fabs(b.y), fabs(b.z)));
+        CHECK_CLOSE(1.0, a.normal().norm(), PRECISE_EPS);
+      }
+    }
+
+    TEST(Vec3_frame)
+    {
+      for (int i = 0; i < 20; ++i)
+      {
+        const Vec3 n = i == 0 ? Vec3(0.0, 0.0, -1.0) : random_normal();
+        const Frame f{n};
+        CHECK_CLOSE(1.0, f.s.norm(), PRECISE_EPS);
+        CHECK_CLOSE(1.0, f.t.norm(), PRECISE_EPS);
+        CHECK_CLOSE(0.0, f.s.dot(f.t), PRECISE_EPS);
+        CHECK_CLOSE(0.0, f.s.dot(n), PRECISE_EPS);
+        CHECK_VEC(n, f.s.cross(f.t));
+        CHECK_VEC(Vec3::z_axis, f.to_local(n));
+
+        const Vec3 d = random_normal() * (rf() + 0.5);
+        CHECK_VEC(d, f.to_world(f.to_local(d)));
+      }
+    }
+
     TEST(Vec3_rotate_aa_none)
     {
       for (int i = 0; i < 10; ++i)
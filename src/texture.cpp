@@ -5,3 +5,9 @@ spectrum Texture2D::at_point(const IntersectionView& isect) const
 {
   return at_coord(isect.tc);
 }
+
+void Texture2D::at_coords(const Vec2* uvs, spectrum* values, uint n) const
+{
+  for (auto i = 0u; i < n; ++i)
+    values[i] = at_coord(uvs[i]);
+}
@@ -21,4 +21,11 @@ public:
   virtual spectrum at_point(const IntersectionView& isect) const override;
 
   virtual spectrum at_coord(const Vec2& uv) const = 0;
+
+  /*
+   * The texture at n coordinates at once. Textures that are costly to call,
+   * rather than to evaluate, such as script functions, override this to pay
+   * that cost once per batch.
+   */
+  virtual void at_coords(const Vec2* uvs, spectrum* values, uint n) const;
 };
@@ -1,13 +1,16 @@
 #include "textures/image_texture.h"
+#include "math_util.h"
 #include <cassert>
+#include <cmath>
+#include <random>
 
-ImageTexture2D::ImageTexture2D(const Texture2D& tex, size_t width, size_t height)
-  : _image(width, height)
+ImageTexture2D::ImageTexture2D(const Texture2D& tex, size_t width, size_t height, Filter filter)
+  : _image(width, height), _filter(filter)
 {
   _resample_texture(tex);
 }
 
-ImageTexture2D::ImageTexture2D(const string& filename)
+ImageTexture2D::ImageTexture2D(const string& filename) : _filter(Filter::NEAREST)
 {
   _image = load_image(filename);
   assert(_image.width() > 0);
@@ -24,14 +27,18 @@ const spectrum& ImageTexture2D::at(size_t x, size_t y) const
 
 void ImageTexture2D::_resample_texture(const Texture2D& tex)
 {
+  // a row at a time
+  vector<Vec2> uvs(_image.width());
+  vector<spectrum> values(_image.width());
   for (auto y = 0u; y < _image.height(); ++y)
   {
     scalar fy = (y + 0.5) / _image.height();
     for (auto x = 0u; x < _image.width(); ++x)
-    {
-      Vec2 uv((x + 0.5) / _image.width(), fy);
-      at(x, y) = tex.at_coord(uv);
-    }
+      uvs[x] = Vec2((x + 0.5) / _image.width(), fy);
+
+    tex.at_coords(uvs.data(), values.data(), uvs.size());
+    for (auto x = 0u; x < _image.width(); ++x)
+      at(x, y) = values[x];
   }
 }
 
@@ -44,9 +51,79 @@ spectrum ImageTexture2D::at_coord(const Vec2& uv) const
   if (v < 0)
     v += 1.0;
 
-  // nearest neighbor
-  int x = u * _image.width();
-  int y = v * _image.height();
+  const int w = _image.width(), h = _image.height();
+  if (_filter == Filter::NEAREST)
+  {
+    int x = u * w;
+    int y = v * h;
+
+    return at(x, y);
+  }
+
+  // texel centers lie at (x + 0.5) / w
+  const scalar fx = u * w - 0.5;
+  const scalar fy = std::min<scalar>(std::max<scalar>(v * h - 0.5, 0), h - 1);
+
+  const int x0 = std::floor(fx), y0 = fy;
+  const scalar tx = fx - x0, ty = fy - y0;
+  const int xa = (x0 + w) % w, xb = (x0 + 1) % w, yb = std::min(y0 + 1, h - 1);
+
+  return (at(xa, y0) * (1 - tx) + at(xb, y0) * tx) * (1 - ty) +
+    (at(xa, yb) * (1 - tx) + at(xb, yb) * tx) * ty;
+}
+
+uint ImageTexture2D::width() const
+{
+  return _image.width();
+}
+
+uint ImageTexture2D::height() const
+{
+  return _image.height();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+scalar texture_error(const Texture2D& exact, const Texture2D& approx, uint samples)
+{
+  std::mt19937 eng;
+  std::uniform_real_distribution<scalar> dist(0, 1);
+
+  vector<Vec2> uvs(samples);
+  for (auto& uv : uvs)
+  {
+    // in order, so the points don't depend on the compiler
+    const scalar u = dist(eng);
+    uv = Vec2(u, dist(eng));
+  }
+
+  vector<spectrum> exact_values(samples), approx_values(samples);
+  exact.at_coords(uvs.data(), exact_values.data(), samples);
+  approx.at_coords(uvs.data(), approx_values.data(), samples);
+
+  scalar sum = 0, sum_sq_error = 0;
+  for (auto i = 0u; i < samples; ++i)
+  {
+    const scalar e = exact_values[i].luminance();
+    sum += std::abs(e);
+    sum_sq_error += square(e - approx_values[i].luminance());
+  }
+
+  const scalar rms = sqrt(sum_sq_error / samples);
+  return sum > 0 ? rms / (sum / samples) : rms;
+}
+
+shared_ptr<ImageTexture2D> bake_texture(const Texture2D& tex, uint width, uint height,
+                                        scalar tolerance, uint max_doublings)
+{
+  for (auto i = 0u; i <= max_doublings; ++i, width *= 2, height *= 2)
+  {
+    auto baked = std::make_shared<ImageTexture2D>(tex, width, height,
+                                                  ImageTexture2D::Filter::BILINEAR);
+    const scalar error = texture_error(tex, *baked);
+    if (error <= tolerance)
+      return baked;
+  }
 
-  return at(x, y);
+  return nullptr;
 }
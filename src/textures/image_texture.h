@@ -2,15 +2,27 @@
 
 #include "texture.h"
 #include "util/images.h"
+#include <memory>
 #include <vector>
 
 using std::vector;
+using std::shared_ptr;
 
 class ImageTexture2D : public Texture2D
 {
 public:
+  enum class Filter
+  {
+    NEAREST,
+
+    // Interpolates between texel centers, wrapping around in u (the azimuth
+    // of to_euler_uv) and clamped in v.
+    BILINEAR
+  };
+
   ImageTexture2D(const std::string& filename);
-  ImageTexture2D(const Texture2D& tex, size_t width, size_t height);
+  ImageTexture2D(const Texture2D& tex, size_t width, size_t height,
+                 Filter filter = Filter::NEAREST);
 
   uint width() const;
   uint height() const;
@@ -26,4 +38,23 @@ private:
   void _resample_texture(const Texture2D& tex);
 
   sp_image _image;
+  Filter _filter;
 };
+
+/*
+ * Bake a texture that is slow to evaluate, such as a sky model or a script
+ * function, into a bilinear-filtered image, so lookups only read memory.
+ *
+ * The bake is checked against the texture at random points: if the RMS
+ * luminance error, relative to the mean luminance, exceeds tolerance, the
+ * resolution is doubled up to max_doublings times. Returns null if no
+ * resolution is accurate enough, in which case the texture should be kept.
+ */
+shared_ptr<ImageTexture2D> bake_texture(const Texture2D& tex, uint width, uint height,
+                                        scalar tolerance = 0.01, uint max_doublings = 2);
+
+/*
+ * The RMS error of approx from exact at random points, relative to the mean
+ * luminance of exact.
+ */
+scalar texture_error(const Texture2D& exact, const Texture2D& approx, uint samples = 4096);
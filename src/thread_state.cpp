@@ -1,6 +1,7 @@
 #include "thread_state.h"
 #include "film.h"
 #include "util/small_map.h"
+#include "script/snapshot.h"
 #include <iostream>
 using std::cerr;
 using std::endl;
@@ -9,24 +10,42 @@ using std::make_unique;
 class ThreadState
 {
 public:
-  ThreadState() : f(0, 0) {}
+  ThreadState() : f(0, 0), film_width(0), film_height(0) {}
 
-  ThreadState(int width, int height, const std::string& lua_fn) :
-    f(width, height)
-#if FEATURE_LUA_SCRIPTING
-    ,_runner(lua_fn)
-#endif
+  ThreadState(int width, int height) :
+    f(0, 0), film_width(width), film_height(height)
 { }
 
-  Film& film() { return f; }
+  /*
+   * The full-frame film is allocated on first use. Grid renders accumulate
+   * into per-tile buffers instead, so most threads never need one.
+   */
+  Film& film()
+  {
+    if (!has_film())
+      f = Film(film_width, film_height);
+    return f;
+  }
   const Film& film() const { return f; }
 
+  bool has_film() const { return f.width != 0; }
+
 #if FEATURE_LUA_SCRIPTING
-  LuaRunner& runner() { return _runner; }
+  /*
+   * The lua state is created on first use, from the script snapshot current
+   * at that time.
+   */
+  LuaRunner& runner(const shared_ptr<const LuaSnapshot>& lua_snapshot)
+  {
+    if (!_runner.state() && lua_snapshot)
+      _runner = LuaRunner(*lua_snapshot);
+    return _runner;
+  }
 #endif
 
 private:
   Film f;
+  int film_width, film_height;
 #if FEATURE_LUA_SCRIPTING
   LuaRunner _runner;
 #endif
@@ -35,18 +54,21 @@ private:
 class ThreadStateManager
 {
 public:
-  ThreadStateManager(const Film& f, const string& s) : _film(f), boostrap_filename(s) { }
+  ThreadStateManager(const Film& f, shared_ptr<const LuaSnapshot> s)
+    : _film(f), lua_snapshot(s) { }
 
   void register_thread();
 
+  void set_lua_snapshot(shared_ptr<const LuaSnapshot> s) { lua_snapshot = s; }
+
   Film& get_film();
   LuaRunner& get_lua_runner();
 
-  void merge_films(Film & f) const;
+  void merge_films(Film & f);
 
 private:
   const Film& _film;
-  std::string boostrap_filename;
+  shared_ptr<const LuaSnapshot> lua_snapshot;
   std::mutex _state_map_mutex;
   unordered_map<std::thread::id, unique_ptr<ThreadState>> _state_map;
 };
@@ -55,7 +77,7 @@ void ThreadStateManager::register_thread()
 {
   std::lock_guard<std::mutex> lg(_state_map_mutex);
   _state_map.emplace(std::this_thread::get_id(),
-                     make_unique<ThreadState>(_film.width, _film.height, boostrap_filename));
+                     make_unique<ThreadState>(_film.width, _film.height));
 }
 
 Film& ThreadStateManager::get_film()
@@ -66,23 +88,36 @@ Film& ThreadStateManager::get_film()
 #if FEATURE_LUA_SCRIPTING
 LuaRunner& ThreadStateManager::get_lua_runner()
 {
-  return _state_map[std::this_thread::get_id()]->runner();
+  return _state_map[std::this_thread::get_id()]->runner(lua_snapshot);
 }
 #endif
 
-void ThreadStateManager::merge_films(Film& f) const
+void ThreadStateManager::merge_films(Film& f)
 {
-  for (const auto& e: _state_map)
+  for (auto& e: _state_map)
   {
+    if (!e.second->has_film())
+      continue;
+
     f.merge(e.second->film());
+    e.second->film().clear();
   }
 }
 
 static shared_ptr<ThreadStateManager> _manager;
 
-void register_thread_state_manager(const Film& f, const std::string& lua_file)
+void register_thread_state_manager(const Film& f, shared_ptr<const LuaSnapshot> lua_snapshot)
+{
+  _manager = make_shared<ThreadStateManager>(f, lua_snapshot);
+
+  // The calling thread prepares the scene, which evaluates the textures of
+  // emissive shapes.
+  _manager->register_thread();
+}
+
+void set_thread_lua_snapshot(shared_ptr<const LuaSnapshot> lua_snapshot)
 {
-  _manager = make_shared<ThreadStateManager>(f, lua_file);
+  _manager->set_lua_snapshot(lua_snapshot);
 }
 
 void register_thread()
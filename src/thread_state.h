@@ -15,10 +15,26 @@ class Film;
 class ThreadState;
 class ThreadStateManager;
 
-void register_thread_state_manager(const Film& f, const string& lua_f);
+/*
+ * Per-thread state for rendering into f. When lua_snapshot is given, each
+ * thread gets its own lua state holding the captured script functions. The
+ * calling thread is registered too.
+ */
+void register_thread_state_manager(const Film& f,
+                                   shared_ptr<const LuaSnapshot> lua_snapshot = nullptr);
+
+/*
+ * Set the script snapshot that threads create their lua state from, for
+ * threads registered before the scene was loaded.
+ */
+void set_thread_lua_snapshot(shared_ptr<const LuaSnapshot> lua_snapshot);
 void register_thread();
 Film& get_thread_film();
 #if FEATURE_LUA_SCRIPTING
 LuaRunner& get_thread_lua_runner();
 #endif
+
+/*
+ * Add every thread's film into f, and clear the thread films.
+ */
 void merge_thread_films(Film& f);
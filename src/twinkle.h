@@ -1,20 +1,29 @@
 #pragma once
 
 #include <limits>
+
+/*
+ * Precision of scalar, and so of every vector, spectrum, bound, film pixel
+ * and acceleration structure. Build with PRECISION=float for single precision.
+ */
+#ifndef FEATURE_DOUBLE_PRECISION
+#define FEATURE_DOUBLE_PRECISION 1
+#endif
+
+#if FEATURE_DOUBLE_PRECISION
 #define USE_DOUBLES
+#endif
 
 #ifdef USE_DOUBLES
 
 using scalar = double;
 const scalar EPSILON         = 0.00001;
-const scalar SHADOW_EPSILON  = 0.0001;
 const scalar BSDF_PDF_EPSILON = 0.001;
 
 #else
 
 using scalar = float;
 const scalar EPSILON         = 0.0001;
-const scalar SHADOW_EPSILON  = 0.001;
 const scalar BSDF_PDF_EPSILON = 0.001;
 
 #endif
@@ -35,6 +44,14 @@ const scalar SCALAR_MIN = std::numeric_limits<scalar>::min();
 #define FEATURE_IMAGE_LOADING 1
 #endif
 
+#ifndef FEATURE_SIMD_LEAVES
+#define FEATURE_SIMD_LEAVES 1
+#endif
+
+#ifndef FEATURE_SIMD_VECTORS
+#define FEATURE_SIMD_VECTORS 1
+#endif
+
 #define FEATURE_DEBUG_TRACER 1
 #define FEATURE_DIRECT_LIGHTING 1
 #define FEATURE_PATH_TRACER 1
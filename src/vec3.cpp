@@ -15,21 +15,6 @@ Vec3 Vec3::zero{0.0, 0.0, 0.0};
 Mat33 Mat33::z_to_y = Mat33::rotate_match(Vec3::z_axis, Vec3::y_axis);
 Mat33 Mat33::y_to_z = Mat33::rotate_match(Vec3::y_axis, Vec3::z_axis);
 
-Vec3::Vec3(const Vec3& rhs) : VectorT3<Vec3>{rhs}
-{
-  // x = rhs.x;
-  // y = rhs.y;
-  // z = rhs.z;
-}
-
-Vec3& Vec3::operator=(const Vec3& rhs)
-{
-  x = rhs.x;
-  y = rhs.y;
-  z = rhs.z;
-  return *this;
-}
-
 int Vec3::min_element() const
 {
   if (x <= y)
@@ -118,11 +103,11 @@ Mat33 Vec3::tensor_product(const Vec3& a) const
 
 Vec3 min(const Vec3& a, const Vec3& b)
 {
-  return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+  return Vec3::unpack(simd::min(a.pack(), b.pack()));
 }
 Vec3 max(const Vec3& a, const Vec3& b)
 {
-  return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+  return Vec3::unpack(simd::max(a.pack(), b.pack()));
 }
 ostream& operator <<(ostream& out, const Vec3& v)
 {
@@ -16,14 +16,13 @@ public:
   Vec3(scalar x, scalar y, scalar z) : VectorT3<Vec3>(x, y, z) { }
   Vec3(VectorT3<Vec3>& s) : VectorT3<Vec3>(s) { }
 
-  Vec3& operator=(const Vec3& x);
-  Vec3(const Vec3&);
+  Vec3& operator=(const Vec3& x) = default;
+  Vec3(const Vec3&) = default;
   Vec3(Vec3&&) = default;
   
   Vec3 normal() const
   {
-    scalar len = norm();
-    return Vec3(x / len, y / len, z / len);
+    return *this / norm();
   }
 
   using VectorT3<Vec3>::operator+;
@@ -47,20 +46,20 @@ public:
 
   Vec3 elem_div(const Vec3& rhs) const
   {
-    return Vec3{x / rhs.x, y / rhs.y, z / rhs.z};
+    return unpack(pack() / rhs.pack());
   }
   Vec3 elem_mult(const Vec3& rhs) const
   {
-    return Vec3{x * rhs.x, y * rhs.y, z * rhs.z};
+    return unpack(pack() * rhs.pack());
   }
   Vec3 abs() const
   {
-    return Vec3(fabs(x), fabs(y), fabs(z));
+    return unpack(simd::abs(pack()));
   }
 
   Vec3 cross(const Vec3& other) const
   {
-    return Vec3(y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x);
+    return unpack(simd::cross(pack(), other.pack()));
   }
 
   /*
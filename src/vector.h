@@ -1,6 +1,7 @@
 #pragma once
 
 #include "twinkle.h"
+#include "simd.h"
 #include <cmath>
 #include <iostream>
 
@@ -11,11 +12,11 @@ template <typename vec_type>
 class VectorT3
 {
 public:
-  VectorT3(scalar x_, scalar y_, scalar z_) : x(x_), y(y_), z(z_)
+  VectorT3(scalar x_, scalar y_, scalar z_) : lanes{x_, y_, z_}
   {
   }
 
-  explicit VectorT3(scalar f) : x(f), y(f), z(f)
+  explicit VectorT3(scalar f) : lanes{f, f, f}
   {
   }
   
@@ -25,13 +26,11 @@ public:
   VectorT3(const VectorT3<vec_type>& a) = default;
   vec_type& operator=(const vec_type& rhs)
   {
-    x = rhs.x;
-    y = rhs.y;
-    z = rhs.z;
-    return *this;
+    simd::store(lanes, rhs.pack());
+    return static_cast<vec_type&>(*this);
   };
 
-  VectorT3(VectorT3<vec_type>& a) : x(a.x), y(a.y), z(a.z)
+  VectorT3(VectorT3<vec_type>& a) : lanes{a.x, a.y, a.z}
   {
   }
   
@@ -45,7 +44,21 @@ public:
     {
       scalar v[3];
     };
+    // x, y and z, padded to the SIMD width
+    scalar lanes[simd::WIDTH];
   };
+
+  simd::packed pack() const
+  {
+    return simd::load(lanes);
+  }
+
+  static vec_type unpack(simd::packed p)
+  {
+    vec_type r;
+    simd::store(r.lanes, p);
+    return r;
+  }
   
   scalar operator[](int idx) const
   {
@@ -58,63 +71,51 @@ public:
 
   vec_type& operator+= (const vec_type& r)
   {
-    this->x += r.x;
-    this->y += r.y;
-    this->z += r.z;
+    simd::store(lanes, pack() + r.pack());
     return static_cast<vec_type&>(*this);
   }
   
   vec_type operator+(const vec_type& r) const
   {
-    auto a = *this;
-    return static_cast<vec_type>(a += r); 
+    return unpack(pack() + r.pack());
   }
 
   vec_type& operator-= (const vec_type& r)
   {
-    this->x -= r.x;
-    this->y -= r.y;
-    this->z -= r.z;
+    simd::store(lanes, pack() - r.pack());
     return static_cast<vec_type&>(*this);
   }
   
   vec_type operator-(const vec_type& r) const
   {
-    auto a = *this;
-    return static_cast<vec_type>(a -= r); 
+    return unpack(pack() - r.pack());
   }
 
   vec_type operator-() const
   {
-    return vec_type(-x, -y, -z);
+    return unpack(-pack());
   }
   
   vec_type& operator*=(scalar a)
   {
-    this->x *= a;
-    this->y *= a;
-    this->z *= a;
+    simd::store(lanes, pack() * simd::broadcast(a));
     return static_cast<vec_type&>(*this);
   }
   
   vec_type operator*(scalar a) const
   {
-    auto x = *this;
-    return static_cast<vec_type>(x *= a); 
+    return unpack(pack() * simd::broadcast(a));
   }
 
   vec_type& operator/= (scalar a)
   {
-    this->x /= a;
-    this->y /= a;
-    this->z /= a;
+    simd::store(lanes, pack() / simd::broadcast(a));
     return static_cast<vec_type&>(*this);
   }
   
   vec_type operator/(scalar a) const
   {
-    auto x = *this;
-    return static_cast<vec_type>(x /= a); 
+    return unpack(pack() / simd::broadcast(a));
   }
 
   bool operator>=(scalar a) const
@@ -155,7 +156,7 @@ public:
 
   scalar dot(const vec_type& other) const
   {
-    return x * other.x + y*other.y + z * other.z;
+    return simd::dot(pack(), other.pack());
   }
   
   scalar norm2() const